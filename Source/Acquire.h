@@ -0,0 +1,167 @@
+/*!
+ * \file	Source\Acquire.h.
+ *
+ * \brief	Declares acquire functions, that wait until tokens are available instead of failing (blocking, or as C++20 coroutines).
+ */
+#pragma once
+#include "TimerScheduler.h"
+#include <chrono>
+#include <limits>
+#include <thread>
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define BUCKET_ALERTS_COROUTINES
+#endif
+#endif
+
+
+namespace BucketAlerts
+{
+	/*! \brief	Deadline that never passes (wait as long as needed). */
+	const TimerScheduler::Clock::time_point NoDeadline = TimerScheduler::Clock::time_point::max();
+
+	// max seconds to wait from now until a deadline
+	inline double SecondsUntil(TimerScheduler::Clock::time_point now, TimerScheduler::Clock::time_point deadline)
+	{
+		if (deadline == NoDeadline)
+			return std::numeric_limits<double>::infinity();
+		return std::chrono::duration<double>(deadline - now).count();
+	}
+
+	// time point that is some seconds after now
+	inline TimerScheduler::Clock::time_point TimeAfter(TimerScheduler::Clock::time_point now, double seconds)
+	{
+		return now + std::chrono::duration_cast<TimerScheduler::Clock::duration>(std::chrono::duration<double>(seconds));
+	}
+
+	/*!
+	 * \fn	template <class BucketT> bool Acquire(BucketT& bucket, double amount = 1.0, TimerScheduler::Clock::time_point deadline = NoDeadline)
+	 *
+	 * \brief	Consume tokens, blocking the calling thread until they're available.
+	 * 			Tokens are reserved right away (see TokenBucket::Reserve()), and then the thread sleeps exactly
+	 * 			until replenishing pays for them, so waiters get their tokens in the order they called, and
+	 * 			don't poll. Waiting is in real time, so the bucket should use a real clock.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 *
+	 * \param	bucket  	The bucket to consume from (TokenBucket or GcraBucket).
+	 * \param	amount  	(Optional) The amount to consume.
+	 * \param	deadline	(Optional) Latest time to get the tokens at. If they can't be available by then, returns false right away.
+	 *
+	 * \return	True if tokens were consumed, false if not (deadline is too soon, or bucket doesn't replenish).
+	 */
+	template <class BucketT>
+	bool Acquire(BucketT& bucket, double amount = 1.0, TimerScheduler::Clock::time_point deadline = NoDeadline)
+	{
+		TimerScheduler::Clock::time_point now = TimerScheduler::Clock::now();
+		double wait = bucket.Reserve(amount, SecondsUntil(now, deadline));
+		if (wait < 0)
+			return false;
+		if (wait > 0)
+			std::this_thread::sleep_until(TimeAfter(now, wait));
+		return true;
+	}
+
+#ifdef BUCKET_ALERTS_COROUTINES
+
+	/*!
+	 * \class	AcquireAwaitable
+	 *
+	 * \brief	Awaitable that consumes tokens, suspending the awaiting coroutine until they're available.
+	 * 			Created by AcquireAsync().
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class BucketT>
+	class AcquireAwaitable
+	{
+	private:
+		// scheduler to resume on, bucket and request
+		TimerScheduler& _scheduler;
+		BucketT& _bucket;
+		double _amount;
+		TimerScheduler::Clock::time_point _deadline;
+
+		// when reservation was made, and seconds to wait from it (-1 if failed)
+		TimerScheduler::Clock::time_point _now;
+		double _wait = -1;
+
+		// the suspended coroutine
+		std::coroutine_handle<> _handle;
+
+		// timer callback that resumes the coroutine (if cancelled, give the reserved tokens back and fail)
+		static void Resume(void* context, bool cancelled)
+		{
+			AcquireAwaitable* self = (AcquireAwaitable*)context;
+			if (cancelled)
+			{
+				self->_bucket.Return(self->_amount);
+				self->_wait = -1;
+			}
+			self->_handle.resume();
+		}
+
+	public:
+
+		// constructor
+		AcquireAwaitable(TimerScheduler& scheduler, BucketT& bucket, double amount, TimerScheduler::Clock::time_point deadline) :
+			_scheduler(scheduler), _bucket(bucket), _amount(amount), _deadline(deadline)
+		{
+		}
+
+		// reserve tokens, and don't suspend if they're available now (or can't be)
+		bool await_ready()
+		{
+			_now = TimerScheduler::Clock::now();
+			_wait = _bucket.Reserve(_amount, SecondsUntil(_now, _deadline));
+			return _wait <= 0;
+		}
+
+		// resume when tokens are paid for
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			_handle = handle;
+			_scheduler.Schedule(TimeAfter(_now, _wait), &Resume, this);
+		}
+
+		// return if tokens were consumed
+		bool await_resume() const
+		{
+			return _wait >= 0;
+		}
+	};
+
+	/*!
+	 * \fn	template <class BucketT> AcquireAwaitable<BucketT> AcquireAsync(TimerScheduler& scheduler, BucketT& bucket, double amount = 1.0, TimerScheduler::Clock::time_point deadline = NoDeadline)
+	 *
+	 * \brief	Consume tokens from a coroutine: co_await the result to suspend until tokens are available.
+	 * 			Like Acquire(), but instead of blocking a thread, the coroutine is resumed by the scheduler
+	 * 			thread, so thousands of waiting coroutines cost no threads and no CPU.
+	 *
+	 * 			Example:
+	 * 				bool ok = co_await AcquireAsync(scheduler, bucket, 1.0);
+	 *
+	 * 			Only available when compiling as C++20 (or newer) with coroutines support.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 *
+	 * \param	scheduler	Scheduler to resume coroutine on (must outlive the wait).
+	 * \param	bucket   	The bucket to consume from (TokenBucket or GcraBucket).
+	 * \param	amount   	(Optional) The amount to consume.
+	 * \param	deadline 	(Optional) Latest time to get the tokens at. If they can't be available by then, doesn't suspend.
+	 *
+	 * \return	Awaitable, that results in true if tokens were consumed, false if not (including when the scheduler
+	 * 			is destroyed while waiting, in which case the reserved tokens are returned to the bucket).
+	 */
+	template <class BucketT>
+	AcquireAwaitable<BucketT> AcquireAsync(TimerScheduler& scheduler, BucketT& bucket, double amount = 1.0, TimerScheduler::Clock::time_point deadline = NoDeadline)
+	{
+		return AcquireAwaitable<BucketT>(scheduler, bucket, amount, deadline);
+	}
+
+#endif
+}
@@ -0,0 +1,96 @@
+#include "AlertCoalescer.h"
+
+namespace BucketAlerts
+{
+	AlertCoalescer::AlertCoalescer()
+	{
+		_window_start.store(NeverTime, std::memory_order_relaxed);
+		_suppressed.store(0, std::memory_order_relaxed);
+		_first.store(INT64_MAX, std::memory_order_relaxed);
+		_last.store(INT64_MIN, std::memory_order_relaxed);
+	}
+
+	AlertCoalescer::AlertCoalescer(const AlertCoalescer& other)
+	{
+		*this = other;
+	}
+
+	AlertCoalescer& AlertCoalescer::operator=(const AlertCoalescer& other)
+	{
+		_window_start.store(other._window_start.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		_suppressed.store(other._suppressed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		_first.store(other._first.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		_last.store(other._last.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return *this;
+	}
+
+	void AlertCoalescer::Take(AlertInfo& info)
+	{
+		// take count first, so alerts suppressed from now on go to the next notification
+		uint64_t count = _suppressed.exchange(0, std::memory_order_acq_rel);
+		if (count == 0)
+			return;
+
+		double first = (double)_first.exchange(INT64_MAX, std::memory_order_relaxed) / 1000000000.0;
+		double last = (double)_last.exchange(INT64_MIN, std::memory_order_relaxed) / 1000000000.0;
+
+		// merge with what info already has
+		if (info.Suppressed == 0 || first < info.FirstSuppressed)
+			info.FirstSuppressed = first;
+		if (info.Suppressed == 0 || last > info.LastSuppressed)
+			info.LastSuppressed = last;
+		info.Suppressed += count;
+	}
+
+	void AlertCoalescer::Suppress(int64_t now, const AlertInfo& info)
+	{
+		// get times range (this alert + the suppressed alerts info already carries)
+		int64_t first = now;
+		int64_t last = now;
+		if (info.Suppressed > 0)
+		{
+			int64_t info_first = (int64_t)(info.FirstSuppressed * 1000000000.0);
+			int64_t info_last = (int64_t)(info.LastSuppressed * 1000000000.0);
+			if (info_first < first) first = info_first;
+			if (info_last > last) last = info_last;
+		}
+
+		// update first (min) and last (max)
+		int64_t current = _first.load(std::memory_order_relaxed);
+		while (first < current && !_first.compare_exchange_weak(current, first, std::memory_order_relaxed)) {}
+		current = _last.load(std::memory_order_relaxed);
+		while (last > current && !_last.compare_exchange_weak(current, last, std::memory_order_relaxed)) {}
+
+		// count them
+		_suppressed.fetch_add(info.Suppressed + 1, std::memory_order_acq_rel);
+	}
+
+	bool AlertCoalescer::Check(int64_t now, int64_t window, AlertInfo& info)
+	{
+		int64_t start = _window_start.load(std::memory_order_relaxed);
+		while (true)
+		{
+			// inside current window? suppress
+			if (start != NeverTime && now - start < window)
+			{
+				Suppress(now, info);
+				return false;
+			}
+
+			// open a new window (only one thread wins, the others will see the new window)
+			if (_window_start.compare_exchange_weak(start, now, std::memory_order_relaxed))
+				break;
+		}
+
+		// deliver, with the alerts we suppressed during previous window
+		Take(info);
+		return true;
+	}
+
+	bool AlertCoalescer::Flush(AlertInfo& info)
+	{
+		uint64_t before = info.Suppressed;
+		Take(info);
+		return info.Suppressed != before;
+	}
+}
@@ -0,0 +1,181 @@
+/*!
+ * \file	Source\AlertCoalescer.h.
+ *
+ * \brief	Declares the alert info and the state we use to coalesce repeating alerts.
+ */
+#pragma once
+#include "Defs.h"
+#include <atomic>
+#include <cstdint>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \enum	AlertLevel
+	 *
+	 * \brief	Which bucket in the hierarchy was exhausted.
+	 */
+	enum class AlertLevel
+	{
+		/*! \brief	The bucket itself. */
+		Bucket,
+
+		/*! \brief	The category limit bucket, shared by all buckets of the category. */
+		Category,
+
+		/*! \brief	The global limit bucket, shared by all buckets. */
+		Global,
+	};
+
+	/*!
+	 * \struct	AlertInfo
+	 *
+	 * \brief	Info about an alert, passed to the manager OnAlert callback.
+	 * 			Times are in seconds since the manager was created.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	struct AlertInfo
+	{
+		/*! \brief	Category of the exhausted bucket. */
+		CategoryId Category;
+
+		/*! \brief	Id of the exhausted bucket, or of the bucket that exhausted a category / global limit (meaningless if this is a summary). */
+		BucketId Bucket;
+
+		/*! \brief	Which level was exhausted. */
+		AlertLevel Level;
+
+		/*! \brief	True if this is a summary of a whole category (from Flush()), and not of a single bucket. */
+		bool CategoryLevel;
+
+		/*! \brief	How many alerts were suppressed since the previous notification. */
+		uint64_t Suppressed;
+
+		/*! \brief	Time of first suppressed alert (0 if none). */
+		double FirstSuppressed;
+
+		/*! \brief	Time of last suppressed alert (0 if none). */
+		double LastSuppressed;
+
+		/*! \brief	Time of this notification. */
+		double Time;
+	};
+
+	/*!
+	 * \class	AlertCoalescer
+	 *
+	 * \brief	Coalescing state of a bucket or a category.
+	 * 			The first alert opens a window and is delivered. Alerts during the window are only counted,
+	 * 			and the next delivered alert carries their count and first / last times.
+	 * 			Lock-free, so it can be checked while consuming. Counts are exact, but under contention
+	 * 			first / last times may be off by a few concurrent alerts.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class AlertCoalescer
+	{
+	private:
+		// when the current window started (nanoseconds), or NeverTime if no window was opened yet
+		std::atomic<int64_t> _window_start;
+
+		// suppressed alerts count and times since last delivered alert (nanoseconds)
+		std::atomic<uint64_t> _suppressed;
+		std::atomic<int64_t> _first;
+		std::atomic<int64_t> _last;
+
+		// take pending suppressed alerts into info
+		void Take(AlertInfo& info);
+
+		// count suppressed alerts (this one + the ones already in info)
+		void Suppress(int64_t now, const AlertInfo& info);
+
+	public:
+
+		/*! \brief	Time value for 'never'. */
+		static const int64_t NeverTime = INT64_MIN;
+
+		/*!
+		 * \fn	AlertCoalescer::AlertCoalescer();
+		 *
+		 * \brief	Default constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		AlertCoalescer();
+
+		/*!
+		 * \fn	AlertCoalescer::AlertCoalescer(const AlertCoalescer& other);
+		 *
+		 * \brief	Copy constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	other	The other object.
+		 */
+		AlertCoalescer(const AlertCoalescer& other);
+
+		/*!
+		 * \fn	AlertCoalescer& AlertCoalescer::operator=(const AlertCoalescer& other);
+		 *
+		 * \brief	Assignment operator.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	other	The other object.
+		 *
+		 * \return	A reference to this object.
+		 */
+		AlertCoalescer& operator=(const AlertCoalescer& other);
+
+		/*!
+		 * \fn	bool AlertCoalescer::Check(int64_t now, int64_t window, AlertInfo& info);
+		 *
+		 * \brief	Check if an alert should be delivered.
+		 * 			If it should, adds the pending suppressed alerts to info and opens a new window.
+		 * 			If not, counts it (together with the suppressed alerts already in info) as suppressed.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	now			Current time, in nanoseconds.
+		 * \param	window		Window length, in nanoseconds.
+		 * \param	info		Alert info to add pending suppressed alerts to.
+		 *
+		 * \return	True if alert should be delivered, false if suppressed.
+		 */
+		bool Check(int64_t now, int64_t window, AlertInfo& info);
+
+		/*!
+		 * \fn	bool AlertCoalescer::Flush(AlertInfo& info);
+		 *
+		 * \brief	Take pending suppressed alerts, without waiting for the next alert.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	info	Alert info to add pending suppressed alerts to.
+		 *
+		 * \return	True if there were pending suppressed alerts.
+		 */
+		bool Flush(AlertInfo& info);
+
+		/*!
+		 * \fn	inline bool AlertCoalescer::Pending() const
+		 *
+		 * \brief	Check if there are suppressed alerts that were not delivered yet.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	True if there are pending suppressed alerts.
+		 */
+		inline bool Pending() const { return _suppressed.load(std::memory_order_relaxed) != 0; }
+	};
+}
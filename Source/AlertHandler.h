@@ -0,0 +1,183 @@
+/*!
+ * \file	Source\AlertHandler.h.
+ *
+ * \brief	Declares a callback type that carries its own context (captures), stored inline without heap allocations.
+ */
+#pragma once
+#include "Defs.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	AlertHandler
+	 *
+	 * \brief	A callback to invoke when a bucket is exhausted, that gets the category and bucket ids and the
+	 * 			amount that failed to consume, and can carry context: any callable (lambda with captures,
+	 * 			functor or function pointer) that fits in InlineSize bytes.
+	 * 			The callable is stored inside the handler itself, so creating, copying and invoking handlers
+	 * 			never allocates, and a handler is copied along with the bucket that holds it. Callables that
+	 * 			don't fit fail to compile (capture a pointer to bigger context instead).
+	 *
+	 * 			Handlers may be invoked from several consuming threads at once, so callables with mutable
+	 * 			state must sync it themselves.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class AlertHandler
+	{
+	public:
+
+		/*! \brief	Max size of a callable the handler can hold. */
+		static const size_t InlineSize = 48;
+
+	private:
+
+		// operations on the stored callable, per callable type
+		struct Operations
+		{
+			void(*Invoke)(void* callable, CategoryId cat_id, BucketId bucket_id, double amount);
+			void(*Copy)(void* dest, const void* source);
+			void(*Destroy)(void* callable);
+		};
+
+		template <class FuncT>
+		struct OperationsOf
+		{
+			static void Invoke(void* callable, CategoryId cat_id, BucketId bucket_id, double amount) { (*(FuncT*)callable)(cat_id, bucket_id, amount); }
+			static void Copy(void* dest, const void* source) { new (dest) FuncT(*(const FuncT*)source); }
+			static void Destroy(void* callable) { ((FuncT*)callable)->~FuncT(); }
+			static constexpr Operations Table = { &Invoke, &Copy, &Destroy };
+		};
+
+		// the callable and its operations (null if empty)
+		alignas(std::max_align_t) unsigned char _storage[InlineSize];
+		const Operations* _operations = nullptr;
+
+	public:
+
+		/*!
+		 * \fn	AlertHandler::AlertHandler()
+		 *
+		 * \brief	Constructor. Creates an empty handler.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		AlertHandler() {}
+
+		/*!
+		 * \fn	AlertHandler::AlertHandler(std::nullptr_t)
+		 *
+		 * \brief	Constructor. Creates an empty handler.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		AlertHandler(std::nullptr_t) {}
+
+		/*!
+		 * \fn	template <class FuncT> AlertHandler::AlertHandler(FuncT func)
+		 *
+		 * \brief	Constructor. Stores a callable that accepts (CategoryId cat_id, BucketId bucket_id, double amount).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	func	The callable (must fit in InlineSize bytes and be copyable).
+		 */
+		template <class FuncT, class Stored = typename std::decay<FuncT>::type,
+			class = typename std::enable_if<!std::is_same<Stored, AlertHandler>::value>::type,
+			class = decltype(std::declval<Stored&>()(CategoryId(), BucketId(), 0.0))>
+		AlertHandler(FuncT func)
+		{
+			static_assert(sizeof(Stored) <= InlineSize, "callable is too big for alert handler, capture a pointer to its context instead");
+			static_assert(alignof(Stored) <= alignof(std::max_align_t), "callable alignment is too big for alert handler");
+			if constexpr (std::is_pointer<Stored>::value)
+			{
+				if (!func) return;
+			}
+			new (_storage) Stored(std::move(func));
+			_operations = &OperationsOf<Stored>::Table;
+		}
+
+		// copy the callable
+		AlertHandler(const AlertHandler& other)
+		{
+			if (other._operations)
+			{
+				other._operations->Copy(_storage, other._storage);
+				_operations = other._operations;
+			}
+		}
+
+		// replace the callable with a copy of another
+		AlertHandler& operator=(const AlertHandler& other)
+		{
+			if (this != &other)
+			{
+				Reset();
+				if (other._operations)
+				{
+					other._operations->Copy(_storage, other._storage);
+					_operations = other._operations;
+				}
+			}
+			return *this;
+		}
+
+		// destroy the callable
+		~AlertHandler() { Reset(); }
+
+		/*!
+		 * \fn	void AlertHandler::Reset()
+		 *
+		 * \brief	Destroy the callable, leaving the handler empty.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Reset()
+		{
+			if (_operations)
+			{
+				_operations->Destroy(_storage);
+				_operations = nullptr;
+			}
+		}
+
+		/*!
+		 * \fn	inline explicit AlertHandler::operator bool() const
+		 *
+		 * \brief	Check if handler holds a callable.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	True if not empty.
+		 */
+		inline explicit operator bool() const { return _operations != nullptr; }
+
+		/*!
+		 * \fn	inline void AlertHandler::operator()(CategoryId cat_id, BucketId bucket_id, double amount) const
+		 *
+		 * \brief	Invoke the callable (handler must not be empty).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Category of the exhausted bucket.
+		 * \param	bucket_id	Identifier of the exhausted bucket.
+		 * \param	amount   	The amount that failed to consume.
+		 */
+		inline void operator()(CategoryId cat_id, BucketId bucket_id, double amount) const
+		{
+			_operations->Invoke((void*)_storage, cat_id, bucket_id, amount);
+		}
+	};
+}
@@ -0,0 +1,155 @@
+#include "AlertsDispatcher.h"
+#include "Metrics.h"
+#include <chrono>
+
+namespace BucketAlerts
+{
+	AlertsDispatcher::AlertsDispatcher(size_t capacity, OverflowPolicy policy) :
+		_policy(policy), _pop_pos(0)
+	{
+		// round capacity up to power of 2
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		_mask = size - 1;
+
+		// init cells, each cell sequence starts at its index (eg ready to push)
+		_cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; ++i)
+			_cells[i].Sequence.store(i, std::memory_order_relaxed);
+
+		_push_pos.store(0, std::memory_order_relaxed);
+		_dropped.store(0, std::memory_order_relaxed);
+		_sleeping.store(false, std::memory_order_relaxed);
+		_running.store(true, std::memory_order_release);
+		_thread = std::thread(&AlertsDispatcher::Run, this);
+	}
+
+	AlertsDispatcher::~AlertsDispatcher()
+	{
+		// stop thread (it will drain the queue before it exits)
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			_running.store(false, std::memory_order_seq_cst);
+		}
+		_wakeup.notify_one();
+		_thread.join();
+	}
+
+	bool AlertsDispatcher::Post(const AlertHandler& handler, CategoryId cat_id, BucketId bucket_id, double amount)
+	{
+		// no handler? nothing to do
+		if (!handler)
+			return true;
+
+		HandlerEvent event = { handler, MakeBucketKey(cat_id, bucket_id), amount };
+		return PushOrOverflow(event);
+	}
+
+	bool AlertsDispatcher::PushOrOverflow(const Operations* operations, const void* event)
+	{
+		if (Push(operations, event))
+			return true;
+
+		// queue is full
+		if (_policy == OverflowPolicy::InvokeInline)
+		{
+			operations->Invoke(event);
+			return true;
+		}
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	bool AlertsDispatcher::Push(const Operations* operations, const void* event)
+	{
+		Cell* cell;
+		size_t pos = _push_pos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			// cell sequence equals position if its free for this round
+			cell = &_cells[pos & _mask];
+			size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			// cell still holds an event from previous round: queue is full
+			else if (diff < 0)
+			{
+				return false;
+			}
+			// another producer took this position, try again
+			else
+			{
+				pos = _push_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		// write event and publish it
+		operations->Copy(cell->Event, event);
+		cell->EventOperations = operations;
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+
+		// wake up dispatcher if its sleeping (rare, so producers almost never touch the mutex).
+		// the fence makes sure we don't read the flag before the event is visible to the dispatcher.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_sleeping.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			_wakeup.notify_one();
+		}
+		return true;
+	}
+
+	bool AlertsDispatcher::InvokeNext()
+	{
+		// cell is ready when its sequence is position + 1
+		Cell& cell = _cells[_pop_pos & _mask];
+		if (cell.Sequence.load(std::memory_order_acquire) != _pop_pos + 1)
+			return false;
+
+		// invoke event in place, then destroy it and free the cell for the next round
+		{
+			MetricsTimer timer(MetricTimer::Callback);
+			cell.EventOperations->Invoke(cell.Event);
+		}
+		cell.EventOperations->Destroy(cell.Event);
+		cell.Sequence.store(_pop_pos + _mask + 1, std::memory_order_release);
+		_pop_pos++;
+		return true;
+	}
+
+	void AlertsDispatcher::Run()
+	{
+		while (true)
+		{
+			// invoke all pending events
+			bool got_any = false;
+			while (InvokeNext())
+			{
+				got_any = true;
+			}
+			if (got_any)
+				continue;
+
+			// stopped and queue is empty? we're done
+			if (!_running.load(std::memory_order_acquire))
+				break;
+
+			// nothing to do, go to sleep until a producer wakes us up.
+			// we mark ourselves sleeping before checking the queue again, so producers won't miss us.
+			_sleeping.store(true, std::memory_order_seq_cst);
+			{
+				std::unique_lock<std::mutex> lock(_mtx);
+				Cell& next = _cells[_pop_pos & _mask];
+				_wakeup.wait_for(lock, std::chrono::milliseconds(100), [&] {
+					return next.Sequence.load(std::memory_order_acquire) == _pop_pos + 1 || !_running.load(std::memory_order_acquire);
+				});
+			}
+			_sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+}
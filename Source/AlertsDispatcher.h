@@ -0,0 +1,225 @@
+/*!
+ * \file	Source\AlertsDispatcher.h.
+ *
+ * \brief	Declares a dispatcher that invokes bucket callbacks on a dedicated thread.
+ */
+#pragma once
+#include "AlertHandler.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <condition_variable>
+#include <thread>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	AlertsDispatcher
+	 *
+	 * \brief	Invokes exhausted buckets callbacks on a dedicated thread, instead of the consuming thread.
+	 * 			Exhaustion events are pushed into a bounded lock-free queue (multiple producers, single
+	 * 			consumer) and the dispatcher thread drains it, so a slow callback never stalls consumers.
+	 * 			When the queue is full, events are either dropped (and counted) or invoked inline,
+	 * 			depending on the overflow policy.
+	 * 			Events hold a copy of the exhausted bucket (or of the alert handler), stored inline in the queue,
+	 * 			so callbacks see the bucket as it was when exhausted, and buckets may be removed or destroyed
+	 * 			while their events are pending.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class AlertsDispatcher
+	{
+	public:
+
+		/*! \brief	Max size of a queued event (a bucket callback with a copy of its bucket, or an alert handler with its params). */
+		static const size_t EventSize = 256;
+
+		/*!
+		 * \enum	OverflowPolicy
+		 *
+		 * \brief	What to do with an event when the queue is full.
+		 */
+		enum class OverflowPolicy
+		{
+			/*! \brief	Drop the event and count it (see Dropped()). */
+			Drop,
+
+			/*! \brief	Invoke the callback on the consuming thread. */
+			InvokeInline,
+		};
+
+	private:
+
+		// operations on a queued event, per event type
+		struct Operations
+		{
+			void(*Invoke)(const void* event);
+			void(*Copy)(void* dest, const void* source);
+			void(*Destroy)(void* event);
+		};
+
+		template <class EventT>
+		struct OperationsOf
+		{
+			static void Invoke(const void* event) { (*(const EventT*)event)(); }
+			static void Copy(void* dest, const void* source) { new (dest) EventT(*(const EventT*)source); }
+			static void Destroy(void* event) { ((EventT*)event)->~EventT(); }
+			static constexpr Operations Table = { &Invoke, &Copy, &Destroy };
+		};
+
+		// bucket callback event, with a copy of the bucket (bucket copies don't keep the callback, so its kept apart)
+		template <class BucketT>
+		struct BucketEvent
+		{
+			typename BucketT::Callback Callback;
+			BucketT Bucket;
+			void operator()() const { Callback(Bucket); }
+		};
+
+		// alert handler event, with a copy of the handler
+		struct HandlerEvent
+		{
+			AlertHandler Handler;
+			BucketKey Key;
+			double Amount;
+			void operator()() const { Handler((CategoryId)(Key >> 32), (BucketId)Key, Amount); }
+		};
+
+		// a queue cell, holding an event inline, with sequence number to sync producers and consumer
+		struct Cell
+		{
+			alignas(64) unsigned char Event[EventSize];
+			const Operations* EventOperations;
+			std::atomic<size_t> Sequence;
+		};
+
+		// queue cells and index mask
+		std::unique_ptr<Cell[]> _cells;
+		size_t _mask;
+
+		// what to do when queue is full
+		OverflowPolicy _policy;
+
+		// next position to push (shared by producers) and to pop (only used by dispatcher thread)
+		alignas(64) std::atomic<size_t> _push_pos;
+		alignas(64) size_t _pop_pos;
+
+		// how many events were dropped
+		alignas(64) std::atomic<uint64_t> _dropped;
+
+		// dispatcher thread and its state
+		std::atomic<bool> _running;
+		std::atomic<bool> _sleeping;
+		std::mutex _mtx;
+		std::condition_variable _wakeup;
+		std::thread _thread;
+
+		// push event, or handle overflow if queue is full
+		template <class EventT>
+		bool PushOrOverflow(const EventT& event)
+		{
+			static_assert(sizeof(EventT) <= EventSize, "event is too big for alerts dispatcher queue");
+			static_assert(alignof(EventT) <= 64, "event alignment is too big for alerts dispatcher queue");
+			return PushOrOverflow(&OperationsOf<EventT>::Table, &event);
+		}
+		bool PushOrOverflow(const Operations* operations, const void* event);
+
+		// push event into queue (copy it into the cell). return false if full.
+		bool Push(const Operations* operations, const void* event);
+
+		// invoke the next event in queue and free its cell. return false if empty.
+		bool InvokeNext();
+
+		// dispatcher thread main loop
+		void Run();
+
+	public:
+
+		/*!
+		 * \fn	AlertsDispatcher::AlertsDispatcher(size_t capacity = 4096, OverflowPolicy policy = OverflowPolicy::Drop);
+		 *
+		 * \brief	Constructor. Starts the dispatcher thread.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	capacity	Max events in queue (rounded up to power of 2).
+		 * \param	policy  	What to do with events when queue is full.
+		 */
+		AlertsDispatcher(size_t capacity = 4096, OverflowPolicy policy = OverflowPolicy::Drop);
+
+		/*!
+		 * \fn	AlertsDispatcher::~AlertsDispatcher();
+		 *
+		 * \brief	Destructor. Invokes pending events and stops the dispatcher thread.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		~AlertsDispatcher();
+
+		// dispatcher owns a thread, so it can't be copied
+		AlertsDispatcher(const AlertsDispatcher&) = delete;
+		AlertsDispatcher& operator=(const AlertsDispatcher&) = delete;
+
+		/*!
+		 * \fn	template <class BucketT> bool AlertsDispatcher::Post(const BucketT& bucket);
+		 *
+		 * \brief	Queue the exhaustion callback of a bucket, to be invoked by the dispatcher thread with a copy of the bucket.
+		 * 			Safe to call from multiple threads at once, and never blocks (besides copying the bucket).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket	The exhausted bucket.
+		 *
+		 * \return	False if queue was full and event was dropped, true otherwise.
+		 */
+		template <class BucketT>
+		bool Post(const BucketT& bucket)
+		{
+			// no callback? nothing to do
+			if (!bucket.OnBucketExhausted)
+				return true;
+
+			BucketEvent<BucketT> event = { bucket.OnBucketExhausted, bucket };
+			return PushOrOverflow(event);
+		}
+
+		/*!
+		 * \fn	bool AlertsDispatcher::Post(const AlertHandler& handler, CategoryId cat_id, BucketId bucket_id, double amount);
+		 *
+		 * \brief	Queue an alert handler invocation, to be invoked by the dispatcher thread.
+		 * 			Safe to call from multiple threads at once, and never blocks.
+		 * 			The handler is copied into the event (it holds its callable inline, so this never allocates).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	handler  	The handler to invoke.
+		 * \param	cat_id   	Category of the exhausted bucket.
+		 * \param	bucket_id	Identifier of the exhausted bucket.
+		 * \param	amount   	The amount that failed to consume.
+		 *
+		 * \return	False if queue was full and event was dropped, true otherwise.
+		 */
+		bool Post(const AlertHandler& handler, CategoryId cat_id, BucketId bucket_id, double amount);
+
+		/*!
+		 * \fn	inline uint64_t AlertsDispatcher::Dropped() const
+		 *
+		 * \brief	Get how many events were dropped because queue was full.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Dropped events count.
+		 */
+		inline uint64_t Dropped() const { return _dropped.load(std::memory_order_relaxed); }
+	};
+}
@@ -6,37 +6,472 @@
 #pragma once
 #include "TokenBucket.h"
 #include "Defs.h"
-#include <unordered_map>
-#include <mutex>
+#include "Policies.h"
+#include "BucketsTable.h"
+#include "AlertHandler.h"
+#include "AlertsDispatcher.h"
+#include "AlertCoalescer.h"
+#include "Metrics.h"
+#include "BucketsConfig.h"
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
 
 
 namespace BucketAlerts
 {
+	// predef
+	template <class BucketT = TokenBucket, class ThreadingT = RuntimeThreading, class ExhaustT = RuntimeExhaust>
+	class BasicAlertsManager;
+
+	// the bucket type a manager holds: buckets that follow Defs for threading get the manager's threading policy instead
+	template <class BucketT, class ThreadingT>
+	struct ManagedBucket
+	{
+		typedef BucketT Type;
+	};
+	template <class ClockT, class ThreadingT, class UpdateT>
+	struct ManagedBucket<BasicTokenBucket<ClockT, RuntimeThreading, UpdateT>, ThreadingT>
+	{
+		typedef BasicTokenBucket<ClockT, ThreadingT, UpdateT> Type;
+	};
+	template <class ManagerT>
+	class BasicBucketHandle;
+
+	/*!
+	 * \typedef	BasicAlertsManager<TokenBucket> AlertsManager
+	 *
+	 * \brief	The default alerts manager, using the default token bucket.
+	 */
+	typedef BasicAlertsManager<TokenBucket> AlertsManager;
+
+	/*!
+	 * \typedef	BasicBucketHandle<AlertsManager> BucketHandle
+	 *
+	 * \brief	Handle to a bucket in the default alerts manager.
+	 */
+	typedef BasicBucketHandle<AlertsManager> BucketHandle;
+
+	/*!
+	 * \struct	ConsumeRecord
+	 *
+	 * \brief	A single consume request, for consuming many buckets at once.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	struct ConsumeRecord
+	{
+		/*! \brief	Identifier for the category. */
+		CategoryId Category;
+
+		/*! \brief	Identifier for the bucket. */
+		BucketId Bucket;
+
+		/*! \brief	The amount to consume. */
+		double Amount;
+	};
+
+	/*!
+	 * \struct	BucketSnapshot
+	 *
+	 * \brief	State of a single bucket, as exported by AlertsManager::Snapshot().
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	struct BucketSnapshot
+	{
+		/*! \brief	Identifier for the category. */
+		CategoryId Category;
+
+		/*! \brief	Identifier for the bucket. */
+		BucketId Bucket;
+
+		/*! \brief	Tokens in bucket (including replenishment up to the time it was read). */
+		double Tokens;
+
+		/*! \brief	Max tokens bucket can hold. */
+		double MaxTokens;
+
+		/*! \brief	Tokens replenished per second. */
+		double ReplenishRate;
+
+		/*! \brief	Total amount consumed from bucket. */
+		double TotalConsumed;
+	};
+
 	/*!
-	 * \class	AlertsManager
+	 * \class	BasicBucketHandle
+	 *
+	 * \brief	A cheap to copy handle to a bucket inside an alerts manager.
+	 * 			Consuming via handle skips the registry lookup entirely, so its useful for hot code
+	 * 			that consumes the same bucket over and over.
+	 * 			Handles stay valid when more buckets are added to the manager, but become invalid when
+	 * 			the manager is cleared or their bucket is evicted. Using an invalid handle is safe (it does
+	 * 			nothing), and you can check Valid() and Resolve() again when needed.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class ManagerT>
+	class BasicBucketHandle
+	{
+	private:
+		// the manager that owns the bucket
+		ManagerT* _manager = nullptr;
+
+		// the bucket slot itself
+		typename ManagerT::Slot* _slot = nullptr;
+
+		// bucket generation counter and the generation we expect it to be
+		const typename ManagerT::GenerationCounter* _generation = nullptr;
+		uint32_t _expected_generation = 0;
+
+		// only the manager can create valid handles
+		friend ManagerT;
+		BasicBucketHandle(ManagerT* manager, typename ManagerT::Slot* slot, const typename ManagerT::GenerationCounter* generation);
+
+	public:
+
+		/*!
+		 * \fn	BucketHandle::BucketHandle()
+		 *
+		 * \brief	Create an empty (invalid) handle.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		BasicBucketHandle() {}
+
+		/*!
+		 * \fn	inline bool BucketHandle::Valid() const
+		 *
+		 * \brief	Check if this handle still points to the bucket it was created for.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	True if valid, false if empty or the manager was cleared (or bucket evicted) since.
+		 */
+		inline bool Valid() const
+		{
+			return _slot && _generation->load(std::memory_order_acquire) == _expected_generation;
+		}
+
+		/*!
+		 * \fn	bool BucketHandle::Consume(double amount = 1.0);
+		 *
+		 * \brief	Consumes from bucket, and return false if was exhausted.
+		 * 			Works just like AlertsManager::Consume(), but without looking the bucket up.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount to consume.
+		 *
+		 * \return	True if bucket is not empty (or handle is invalid), false if consumed.
+		 */
+		bool Consume(double amount = 1.0);
+
+		/*!
+		 * \fn	void BucketHandle::Restore(double amount = 1.0);
+		 *
+		 * \brief	Restore tokens to bucket (does nothing if handle is invalid).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount to restore.
+		 */
+		void Restore(double amount = 1.0);
+
+		/*!
+		 * \fn	double BucketHandle::Count();
+		 *
+		 * \brief	Get current tokens count.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current tokens count (or 0 if handle is invalid).
+		 */
+		double Count();
+	};
+
+	/*!
+	 * \class	BasicAlertsManager
 	 *
 	 * \brief	The main class that manage counters and alerts.
 	 * 			You can create your own instance or just use the global static object
 	 * 			by calling 'get_main()'.
+	 * 			Buckets type is a template param, so you can use buckets with a different clock (see Clock.h).
+	 * 			Threading and reset-on-exhaust are policies (see Policies.h), by default they follow Defs.
+	 * 			Buckets that follow Defs for threading get the manager's threading policy (see Bucket), so
+	 * 			a single threaded manager holds no mutexes and no atomics at all.
+	 * 			Buckets that are not created explicitly are created from their category template, and can be
+	 * 			evicted once they are full and idle, so memory follows the active buckets (see IdleTimeout).
+	 * 			Categories can have a limit bucket, and the manager a global limit bucket, that are charged
+	 * 			together with every bucket under them.
 	 *
 	 * \author	Ronen Ness
 	 * \date	3/31/2018
 	 */
-	class AlertsManager
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	class BasicAlertsManager
 	{
+	public:
+
+		/*! \brief	The threading policy of this manager. */
+		typedef ThreadingT Threading;
+
+		/*! \brief	The type of buckets this manager holds (BucketT, with the manager's threading policy if it follows Defs). */
+		typedef typename ManagedBucket<BucketT, ThreadingT>::Type Bucket;
+
+		/*! \brief	Callback type of the buckets this manager holds. */
+		typedef typename Bucket::Callback Callback;
+
+		/*! \brief	Handle type to buckets of this manager. */
+		typedef BasicBucketHandle<BasicAlertsManager> Handle;
+
+		/*! \brief	Callback to get alerts with their coalescing info. */
+		typedef void(*AlertCallback)(const AlertInfo& info);
+
+		/*! \brief	Log2 of how many shards the buckets registry is split into. */
+		static const unsigned int ShardsBits = 6;
+
+		/*! \brief	How many shards the buckets registry is split into. */
+		static const unsigned int ShardsCount = 1u << ShardsBits;
+
 	private:
 
-		// all the buckets
-		std::unordered_map<CategoryId, std::unordered_map<BucketId, TokenBucket> > _buckets;
+		// category state: alerts coalescing and optional limit bucket
+		struct CategoryState
+		{
+			// coalescing state of all alerts in category
+			AlertCoalescer Alert;
+
+			// category limit bucket, its handler and coalescing state, and if its set
+			Bucket Limit;
+			AlertHandler LimitHandler;
+			AlertCoalescer LimitAlert;
+			typename ThreadingT::template Atomic<bool> HasLimit { false };
+
+			CategoryState() {}
+			CategoryState(const CategoryState& other) { *this = other; }
+			CategoryState& operator=(const CategoryState& other)
+			{
+				Alert = other.Alert;
+				Limit = other.Limit;
+				LimitHandler = other.LimitHandler;
+				LimitAlert = other.LimitAlert;
+				HasLimit.store(other.HasLimit.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				return *this;
+			}
+		};
+
+		// bucket generation counters (see BucketsTable)
+		typedef typename ThreadingT::template Atomic<uint32_t> GenerationCounter;
+
+		// a bucket in the registry, with its key, category, alert handler, alerts coalescing state and eviction state
+		struct Slot
+		{
+			typename BasicAlertsManager::Bucket Bucket;
+			AlertHandler Handler;
+			BucketKey Key = 0;
+			CategoryState* Category = nullptr;
+			AlertCoalescer Alert;
+
+			// when bucket was last used (nanoseconds since epoch), and if it was created implicitly and may be evicted
+			typename ThreadingT::template Atomic<int64_t> LastUsed { 0 };
+			bool Evictable = false;
+
+			// odd while slot is being set, and increased again when done, so snapshots can detect they read a partly set slot.
+			// belongs to the slot memory and not to the bucket, so its not copied.
+			typename ThreadingT::template Atomic<uint32_t> Version { 0 };
+
+			Slot() {}
+			Slot(const Slot& other) { *this = other; }
+			Slot& operator=(const Slot& other)
+			{
+				Bucket = other.Bucket;
+				Handler = other.Handler;
+				Key = other.Key;
+				Category = other.Category;
+				Alert = other.Alert;
+				LastUsed.store(other.LastUsed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				Evictable = other.Evictable;
+				return *this;
+			}
+		};
+
+		// params to create buckets of a category with
+		struct BucketTemplate
+		{
+			double StartingTokens = 0;
+			double MaxTokens = 0;
+			double ReplenishRate = 0;
+			Callback OnBucketExhausted = nullptr;
+			AlertHandler Handler;
+		};
+
+		// a single shard of the registry.
+		// consumers only lock their bucket's shard for reading, writers lock it for writing.
+		struct alignas(64) Shard
+		{
+			// all the buckets in this shard, by combined key
+			BucketsTable<Slot, ThreadingT> Buckets;
+
+			// mutex for thread safe mode (does nothing if single threaded)
+			typename ThreadingT::SharedMutex Mutex;
+
+			// next bucket index to check for eviction
+			uint32_t EvictCursor = 0;
+		};
+
+		// all the buckets, split into shards by key
+		Shard _shards[ShardsCount];
+
+		// epochs of threads that use buckets without locking their shard (consumers after lookup, and snapshots),
+		// so removed buckets are not reused while they're used
+		EpochDomain _epochs;
+
+		// get the shard a key belongs to
+		inline unsigned int ShardIndex(BucketKey key) const { return (unsigned int)(HashBucketKey(key) >> (64 - ShardsBits)); }
+		inline Shard& GetShard(BucketKey key) { return _shards[ShardIndex(key)]; }
+
+		// categories states, and mutex to protect them.
+		// states are never removed (Clear() only resets them), so buckets can point to their category.
+		BucketsTable<CategoryState, ThreadingT> _categories;
+		typename ThreadingT::SharedMutex _categories_mutex;
+
+		// global limit bucket, its handler and coalescing state, and if its set
+		Bucket _global_limit;
+		AlertHandler _global_limit_handler;
+		AlertCoalescer _global_limit_alert;
+		typename ThreadingT::template Atomic<bool> _has_global_limit { false };
+
+		// set once any limit was set, so managers without limits don't check buckets categories at all
+		typename ThreadingT::template Atomic<bool> _has_limits { false };
+
+		// categories buckets templates, and mutex to protect them
+		BucketsTable<BucketTemplate, ThreadingT> _templates;
+		typename ThreadingT::SharedMutex _templates_mutex;
+
+		// time point that alert times are counted from
+		typename Bucket::Clock::TimePoint _epoch;
+
+		// get nanoseconds since epoch, at a time point we already read or now
+		inline int64_t TimeAt(const typename Bucket::Clock::TimePoint& now) const { return (int64_t)(Bucket::Clock::DiffSeconds(_epoch, now) * 1000000000.0); }
+		inline int64_t NowTime() const { return TimeAt(Bucket::Clock::Now()); }
+
+		// find bucket or create it from its category template, and optionally get a handle to it.
+		Slot& FindOrCreate(BucketKey key, Handle* handle);
+
+		// init a bucket we just created implicitly, from its category template (or default params).
+		void InitBucket(Slot& slot, BucketKey key, int64_t now);
+
+		// mark bucket as used now, or at a time we already read (if eviction is enabled).
+		// stamped with the real time, so buckets that are used all the time are never seen as idle.
+		inline void Touch(Slot& slot)
+		{
+			if (IdleTimeout > 0)
+				slot.LastUsed.store(NowTime(), std::memory_order_relaxed);
+		}
+		inline void Touch(Slot& slot, int64_t now)
+		{
+			if (IdleTimeout > 0)
+				slot.LastUsed.store(now, std::memory_order_relaxed);
+		}
+
+		// mark slot as being set / done being set, around setting a slot that snapshots may be reading.
+		inline void BeginSet(Slot& slot)
+		{
+			slot.Version.store(slot.Version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+		inline void EndSet(Slot& slot)
+		{
+			slot.Version.store(slot.Version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		// get a new slot for a bucket we're about to set. shard must be locked for writing.
+		// if bucket already exists its slot is retired rather than overwritten, as consumers that already found it may still use it.
+		inline Slot& NewSlot(Shard& shard, BucketKey key, uint32_t* index = nullptr)
+		{
+			bool created;
+			bool replaced = shard.Buckets.Retire(key, _epochs);
+			Slot& ret = shard.Buckets.GetOrCreate(key, created, index);
+			if (!replaced) Metrics::Count(MetricCounter::BucketsCreated);
+			return ret;
+		}
+
+		// check up to 'budget' buckets of a shard, and evict the idle ones. shard must be locked for writing.
+		size_t EvictFromShard(Shard& shard, int64_t now, uint32_t budget);
+
+		// get nanoseconds since epoch if eviction is enabled (otherwise returns 0, without reading the clock).
+		int64_t EvictionNow();
 
-		// mutex for thread safe mode
-		std::mutex _mtx;
+		// an exhausted bucket to notify about (and reset) after a batch
+		struct Exhausted
+		{
+			Slot* Bucket;
+			AlertLevel Level;
+			double Amount;
+		};
+
+		// consume from a bucket we already found.
+		bool ConsumeBucket(Slot& slot, double amount);
+
+		// consume from a bucket and its category and global limits (if set), and get which level was exhausted.
+		// levels that were charged before another level got exhausted get their tokens back.
+		bool ConsumeLevels(Slot& slot, double amount, const typename Bucket::Clock::TimePoint& now, AlertLevel& level);
+
+		// reset exhausted level bucket, if needed.
+		void ResetExhausted(Slot& slot, AlertLevel level);
+
+		// consume from a bucket as part of a batch, and remember it if exhausted so we can notify and reset it later.
+		bool ConsumeBatched(Slot& slot, double amount, const typename Bucket::Clock::TimePoint& now, int64_t eviction_now, std::vector<Exhausted>& exhausted);
+
+		// notify about exhausted bucket or limit (coalesce, then invoke or dispatch callbacks).
+		void Notify(Slot& slot, AlertLevel level, double amount);
+
+		// get category state (create if needed).
+		CategoryState& GetCategory(CategoryId cat_id);
+
+		// update or reset all category limits and the global limit.
+		void UpdateLimits(bool reset);
+
+		// handles use the internal consume
+		friend class BasicBucketHandle<BasicAlertsManager>;
 
 	public:
 
 		/*! \brief	Enable / disable the alerts manager and consumption counting. */
 		bool Enabled = true;
 
+		/*! \brief	Optional dispatcher to invoke callbacks on its own thread, instead of the consuming thread (must outlive the manager). */
+		AlertsDispatcher* Dispatcher = nullptr;
+
+		/*! \brief	Seconds to coalesce repeating alerts of the same bucket into one notification (0 = don't coalesce). */
+		double CoalesceWindow = 0;
+
+		/*! \brief	Seconds to coalesce repeating alerts of the same category into one notification (0 = don't coalesce). */
+		double CategoryCoalesceWindow = 0;
+
+		/*! \brief	Optional function to call on every delivered alert, with its coalescing info (invoked on the consuming thread). */
+		AlertCallback OnAlert = nullptr;
+
+		/*! \brief	Seconds an implicitly created bucket must be full and unused before its evicted (0 = never evict).
+		 * 			When enabled, every lookup reads the clock to mark its bucket as used. References from GetBucket()
+		 * 			to implicitly created buckets become invalid once they are evicted. */
+		double IdleTimeout = 0;
+
+		/*! \brief	How many buckets of a shard to check for eviction whenever we create new buckets in it. */
+		unsigned int EvictionBudget = 8;
+
 		/*!
 		 * \fn	AlertsManager::AlertsManager();
 		 *
@@ -45,7 +480,7 @@ namespace BucketAlerts
 		 * \author	Ronen Ness
 		 * \date	3/31/2018
 		 */
-		AlertsManager();
+		BasicAlertsManager();
 
 		/*!
 		 * \fn	virtual AlertsManager::~AlertsManager();
@@ -55,12 +490,14 @@ namespace BucketAlerts
 		 * \author	Ronen Ness
 		 * \date	3/31/2018
 		 */
-		virtual ~AlertsManager();
+		virtual ~BasicAlertsManager();
 
 		/*!
-		 * \fn	void AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id);
+		 * \fn	BucketHandle AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id);
 		 *
 		 * \brief	Creates a new bucket.
+		 * 			If the bucket already exists it is replaced: handles to the old bucket become invalid,
+		 * 			and consumers that already looked it up finish with the old bucket.
 		 *
 		 * \author	Ronen Ness
 		 * \date	3/31/2018
@@ -68,11 +505,14 @@ namespace BucketAlerts
 		 * \param	cat_id   	Identifier for the category.
 		 * \param	bucket_id	Identifier for the bucket.
 		 * \param	bucket		Bucket to create from.
+		 * \param	handler		(Optional) Alert handler to invoke when bucket exhausted (see AlertHandler).
+		 *
+		 * \return	Handle to the new bucket.
 		 */
-		void CreateBucket(CategoryId cat_id, BucketId bucket_id, const TokenBucket& bucket);
+		Handle CreateBucket(CategoryId cat_id, BucketId bucket_id, const Bucket& bucket, const AlertHandler& handler = AlertHandler());
 
 		/*!
-		 * \fn	void AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate);
+		 * \fn	BucketHandle AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate);
 		 *
 		 * \brief	Creates a new bucket.
 		 *
@@ -85,11 +525,33 @@ namespace BucketAlerts
 		 * \param	max_tokens	   	Bucket max tokens.
 		 * \param	replenish_rate 	Bucket replenish rate.
 		 * \param	callback		Callback to trigger when bucket exhausted.
+		 *
+		 * \return	Handle to the new bucket.
 		 */
-		void CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, BucketCallback callback);
+		Handle CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback);
 
 		/*!
-		* \fn	void AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id);
+		 * \fn	BucketHandle AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+		 *
+		 * \brief	Creates a new bucket, with an alert handler that gets the bucket ids, the failed amount and
+		 * 			its own context, instead of a bucket callback.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id		   	Identifier for the category.
+		 * \param	bucket_id	   	Identifier for the bucket.
+		 * \param	starting_tokens	Bucket starting tokens count.
+		 * \param	max_tokens	   	Bucket max tokens.
+		 * \param	replenish_rate 	Bucket replenish rate.
+		 * \param	handler			Alert handler to invoke when bucket exhausted (see AlertHandler).
+		 *
+		 * \return	Handle to the new bucket.
+		 */
+		Handle CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+
+		/*!
+		* \fn	BucketHandle AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id);
 		*
 		* \brief	Creates a new bucket.
 		*
@@ -98,11 +560,14 @@ namespace BucketAlerts
 		*
 		* \param	bucket_id	Identifier for the bucket.
 		* \param	bucket		Bucket to create from.
+		* \param	handler		(Optional) Alert handler to invoke when bucket exhausted (see AlertHandler).
+		*
+		* \return	Handle to the new bucket.
 		*/
-		inline void CreateBucket(BucketId bucket_id, const TokenBucket& bucket);
+		Handle CreateBucket(BucketId bucket_id, const Bucket& bucket, const AlertHandler& handler = AlertHandler());
 
 		/*!
-		* \fn	void AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate);
+		* \fn	BucketHandle AlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate);
 		*
 		* \brief	Creates a new bucket.
 		*
@@ -114,13 +579,90 @@ namespace BucketAlerts
 		* \param	max_tokens	   	Bucket max tokens.
 		* \param	replenish_rate 	Bucket replenish rate.
 		* \param	callback		Callback to trigger when bucket exhausted.
+		*
+		* \return	Handle to the new bucket.
 		*/
-		void CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, BucketCallback callback);
+		Handle CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback);
+
+		/*!
+		 * \fn	BucketHandle AlertsManager::CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+		 *
+		 * \brief	Creates a new bucket in the default category, with an alert handler.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket_id	   	Identifier for the bucket.
+		 * \param	starting_tokens	Bucket starting tokens count.
+		 * \param	max_tokens	   	Bucket max tokens.
+		 * \param	replenish_rate 	Bucket replenish rate.
+		 * \param	handler			Alert handler to invoke when bucket exhausted (see AlertHandler).
+		 *
+		 * \return	Handle to the new bucket.
+		 */
+		Handle CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+
+		/*!
+		 * \fn	bool AlertsManager::CreateBuckets(const BucketsConfig& config, const CallbacksRegistry<Callback>& callbacks, std::string* missing = nullptr);
+		 *
+		 * \brief	Creates all the buckets of a config at once.
+		 * 			Definitions are grouped by shard and every shard is pre-sized and locked once, so loading
+		 * 			large configs doesn't pay a lock and a table growth per bucket. Existing buckets are replaced,
+		 * 			like CreateBucket() does.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	config   	Buckets definitions (see BucketsConfig).
+		 * \param 		  	callbacks	Callbacks to resolve config callback names with.
+		 * \param [out]	missing  	(Optional) If not null and a callback name is not registered, will be set to that name.
+		 *
+		 * \return	True on success, false if a callback name is not registered (and then no bucket is created).
+		 */
+		bool CreateBuckets(const BucketsConfig& config, const CallbacksRegistry<Callback>& callbacks, std::string* missing = nullptr);
+
+		/*!
+		 * \fn	bool AlertsManager::RemoveBucket(CategoryId cat_id, BucketId bucket_id);
+		 *
+		 * \brief	Remove a bucket. Its handles become invalid, and consuming it again creates it anew from its
+		 * 			category template (or default params).
+		 * 			Safe to call while other threads consume and take snapshots: bucket memory is not reused
+		 * 			while a consume, handle or snapshot may still be using it, and a thread that consumes exactly
+		 * 			as the bucket is removed may lose that consume. References from GetBucket() are not tracked,
+		 * 			so they become invalid once their bucket is removed.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Category identifier.
+		 * \param	bucket_id	Bucket identifier.
+		 *
+		 * \return	True if bucket was found and removed.
+		 */
+		bool RemoveBucket(CategoryId cat_id, BucketId bucket_id);
+
+		/*!
+		 * \fn	bool AlertsManager::RemoveBucket(BucketId bucket_id);
+		 *
+		 * \brief	Remove a bucket from the default category.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket_id	Bucket identifier.
+		 *
+		 * \return	True if bucket was found and removed.
+		 */
+		bool RemoveBucket(BucketId bucket_id);
 
 		/*!
 		 * \fn	TokenBucket& AlertsManager::GetBucket(CategoryId cat_id, BucketId bucket_id);
 		 *
 		 * \brief	Gets a bucket reference.
+		 * 			If bucket doesn't exist, will create it from its category template (or default params).
+		 * 			The reference stays valid until the bucket is removed, evicted (if created implicitly, see
+		 * 			IdleTimeout) or the manager is cleared. Use Consume() or a handle if that may happen while
+		 * 			you use it.
 		 *
 		 * \author	Ronen Ness
 		 * \date	3/31/2018
@@ -130,7 +672,7 @@ namespace BucketAlerts
 		 *
 		 * \return	The bucket.
 		 */
-		TokenBucket& GetBucket(CategoryId cat_id, BucketId bucket_id);
+		Bucket& GetBucket(CategoryId cat_id, BucketId bucket_id);
 
 		/*!
 		 * \fn	TokenBucket& AlertsManager::GetBucket(BucketId bucket_id);
@@ -144,7 +686,253 @@ namespace BucketAlerts
 		 *
 		 * \return	The bucket.
 		 */
-		TokenBucket& GetBucket(BucketId bucket_id);
+		Bucket& GetBucket(BucketId bucket_id);
+
+		/*!
+		 * \fn	void AlertsManager::SetCategoryTemplate(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback);
+		 *
+		 * \brief	Set the params to create buckets of a category with, when they are used without being created
+		 * 			first (via GetBucket(), Consume(), Resolve() etc). Buckets that already exist are not changed.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id		   	Identifier for the category.
+		 * \param	starting_tokens	Buckets starting tokens count.
+		 * \param	max_tokens	   	Buckets max tokens.
+		 * \param	replenish_rate 	Buckets replenish rate.
+		 * \param	callback		Callback to trigger when a bucket is exhausted.
+		 */
+		void SetCategoryTemplate(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback);
+
+		/*!
+		 * \fn	void AlertsManager::SetCategoryTemplate(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+		 *
+		 * \brief	Set the params to create buckets of a category with, with an alert handler that every new bucket gets a copy of.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id		   	Identifier for the category.
+		 * \param	starting_tokens	Buckets starting tokens count.
+		 * \param	max_tokens	   	Buckets max tokens.
+		 * \param	replenish_rate 	Buckets replenish rate.
+		 * \param	handler			Alert handler to invoke when a bucket is exhausted (see AlertHandler).
+		 */
+		void SetCategoryTemplate(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+
+		/*!
+		 * \fn	void AlertsManager::RemoveCategoryTemplate(CategoryId cat_id);
+		 *
+		 * \brief	Remove a category template, so new buckets of this category are created with default params.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id	Identifier for the category.
+		 */
+		void RemoveCategoryTemplate(CategoryId cat_id);
+
+		/*!
+		 * \fn	void AlertsManager::SetCategoryLimit(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback);
+		 *
+		 * \brief	Set a limit bucket for a whole category, that is charged together with every bucket in it.
+		 * 			A consume succeeds only if both the bucket and the category limit (and global limit, if set)
+		 * 			have enough tokens, and alerts tell which level was exhausted (see AlertInfo::Level).
+		 * 			Note: set limits before consuming from the category, as the limit bucket is replaced.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id		   	Identifier for the category.
+		 * \param	starting_tokens	Limit starting tokens count.
+		 * \param	max_tokens	   	Limit max tokens.
+		 * \param	replenish_rate 	Limit replenish rate.
+		 * \param	callback		Callback to trigger when limit is exhausted.
+		 */
+		void SetCategoryLimit(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback);
+
+		/*!
+		 * \fn	void AlertsManager::SetCategoryLimit(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+		 *
+		 * \brief	Set a limit bucket for a whole category, with an alert handler (gets the ids of the bucket that hit the limit).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id		   	Identifier for the category.
+		 * \param	starting_tokens	Limit starting tokens count.
+		 * \param	max_tokens	   	Limit max tokens.
+		 * \param	replenish_rate 	Limit replenish rate.
+		 * \param	handler			Alert handler to invoke when limit is exhausted (see AlertHandler).
+		 */
+		void SetCategoryLimit(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+
+		/*!
+		 * \fn	void AlertsManager::RemoveCategoryLimit(CategoryId cat_id);
+		 *
+		 * \brief	Stop charging a category limit.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id	Identifier for the category.
+		 */
+		void RemoveCategoryLimit(CategoryId cat_id);
+
+		/*!
+		 * \fn	void AlertsManager::SetGlobalLimit(double starting_tokens, double max_tokens, double replenish_rate, Callback callback);
+		 *
+		 * \brief	Set a limit bucket that is charged together with every bucket in the manager.
+		 * 			Note: set it before consuming, as the limit bucket is replaced.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	starting_tokens	Limit starting tokens count.
+		 * \param	max_tokens	   	Limit max tokens.
+		 * \param	replenish_rate 	Limit replenish rate.
+		 * \param	callback		Callback to trigger when limit is exhausted.
+		 */
+		void SetGlobalLimit(double starting_tokens, double max_tokens, double replenish_rate, Callback callback);
+
+		/*!
+		 * \fn	void AlertsManager::SetGlobalLimit(double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+		 *
+		 * \brief	Set a limit bucket that is charged together with every bucket in the manager, with an alert handler
+		 * 			(gets the ids of the bucket that hit the limit).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	starting_tokens	Limit starting tokens count.
+		 * \param	max_tokens	   	Limit max tokens.
+		 * \param	replenish_rate 	Limit replenish rate.
+		 * \param	handler			Alert handler to invoke when limit is exhausted (see AlertHandler).
+		 */
+		void SetGlobalLimit(double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler);
+
+		/*!
+		 * \fn	void AlertsManager::RemoveGlobalLimit();
+		 *
+		 * \brief	Stop charging the global limit.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void RemoveGlobalLimit();
+
+		/*!
+		 * \fn	size_t AlertsManager::EvictIdle();
+		 *
+		 * \brief	Check all buckets and evict those that were created implicitly (from category template or
+		 * 			default params), are full and were not used for IdleTimeout seconds.
+		 * 			Eviction also happens gradually whenever new buckets are created (see EvictionBudget), so
+		 * 			calling this is only needed to release memory when no new buckets are coming.
+		 * 			Buckets usage time is only as accurate as the intervals between creating buckets and
+		 * 			calling this, so call it a few times per IdleTimeout.
+		 * 			Evicted buckets handles become invalid, and a thread that consumes via handle exactly as the
+		 * 			bucket is evicted may lose that consume.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	How many buckets were evicted.
+		 */
+		size_t EvictIdle();
+
+		/*!
+		 * \fn	template <class Func> void AlertsManager::ForEachBucket(Func func);
+		 *
+		 * \brief	Invoke a function on every bucket, with its key: func(BucketKey key, BucketT& bucket).
+		 * 			Locks one shard at a time for reading, so the function must not create buckets or call
+		 * 			other manager methods that lock shards for writing.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	func	The function to invoke.
+		 */
+		template <class Func>
+		void ForEachBucket(Func func);
+
+		/*!
+		 * \fn	size_t AlertsManager::Snapshot(BucketSnapshot* out, size_t capacity);
+		 *
+		 * \brief	Export the state of all buckets into a buffer, without locking the manager: consuming, creating
+		 * 			and removing buckets go on while the snapshot is taken, and are never blocked by it.
+		 * 			Shards are never locked, and buckets are read with Peek(), which is lock-free for AtomicTokenBucket,
+		 * 			LazyTokenBucket and GcraBucket. TokenBucket::Peek() takes the bucket's own mutex for a moment, like
+		 * 			a single Consume() does.
+		 * 			Every exported bucket is read whole (never mixed with a bucket that is set or removed at the
+		 * 			same time), but different buckets may be read at slightly different times. Buckets created or removed
+		 * 			while the snapshot is taken may or may not be included.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param [out]	out			Buffer to fill.
+		 * \param 		capacity	Max buckets to write to buffer.
+		 *
+		 * \return	How many buckets there are. If more than capacity, only the first 'capacity' buckets were written.
+		 */
+		size_t Snapshot(BucketSnapshot* out, size_t capacity);
+
+		/*!
+		 * \fn	size_t AlertsManager::BucketsCount();
+		 *
+		 * \brief	Get how many buckets the manager currently holds.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Buckets count.
+		 */
+		size_t BucketsCount();
+
+		/*!
+		 * \fn	void AlertsManager::GetMetrics(MetricsSnapshot& out);
+		 *
+		 * \brief	Get a snapshot of the process-wide metrics (see Metrics.h), with this manager's buckets count.
+		 * 			Note: metrics are not per manager. Counters and latencies include all managers in the process
+		 * 			(same as Metrics::Snapshot()), and are only collected if BUCKET_ALERTS_METRICS is defined.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param [out]	out	Snapshot to fill.
+		 */
+		void GetMetrics(MetricsSnapshot& out);
+
+		/*!
+		 * \fn	BucketHandle AlertsManager::Resolve(CategoryId cat_id, BucketId bucket_id);
+		 *
+		 * \brief	Gets a handle to a bucket, that can consume from it without looking it up again.
+		 * 			If bucket doesn't exist, will create it from its category template (or default params).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 *
+		 * \return	The bucket handle.
+		 */
+		Handle Resolve(CategoryId cat_id, BucketId bucket_id);
+
+		/*!
+		 * \fn	BucketHandle AlertsManager::Resolve(BucketId bucket_id);
+		 *
+		 * \brief	Gets a handle to a bucket from the default category.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket_id	Identifier for the bucket.
+		 *
+		 * \return	The bucket handle.
+		 */
+		Handle Resolve(BucketId bucket_id);
 
 		/*!
 		 * \fn	bool AlertsManager::Consume(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
@@ -204,6 +992,55 @@ namespace BucketAlerts
 		*/
 		void Restore(BucketId bucket_id, double amount = 1.0);
 
+		/*!
+		 * \fn	double AlertsManager::Take(CategoryId cat_id, BucketId bucket_id, double max_amount);
+		 *
+		 * \brief	Take up to the given amount of tokens from a bucket, without failing or invoking the callback.
+		 * 			Safe to call while buckets are removed or evicted (unlike taking via GetBucket()).
+		 * 			Bucket type must provide Take().
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id	  	Identifier for the category.
+		 * \param	bucket_id 	Identifier for the bucket.
+		 * \param	max_amount	Max amount of tokens to take.
+		 *
+		 * \return	How many tokens were taken (0 if bucket is empty).
+		 */
+		double Take(CategoryId cat_id, BucketId bucket_id, double max_amount);
+
+		/*!
+		 * \fn	void AlertsManager::ConsumeMany(const ConsumeRecord* records, size_t count, bool* results);
+		 *
+		 * \brief	Consumes from many buckets at once.
+		 * 			Reads the clock once for the whole batch and groups records by shard, so every shard
+		 * 			is locked once instead of once per record. Records of the same bucket are consumed in order.
+		 * 			Callbacks of exhausted buckets are invoked after the whole batch is consumed, and exhausted
+		 * 			buckets are reset (if reset policy is set) right after their callbacks, like in Consume().
+		 * 			Missing buckets are created from their category template (or default params).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	records	Records to consume.
+		 * \param	count  	How many records we have.
+		 * \param	results	Output array (same size as records): true if bucket was not empty, false if consumed.
+		 */
+		void ConsumeMany(const ConsumeRecord* records, size_t count, bool* results);
+
+		/*!
+		 * \fn	void AlertsManager::Flush();
+		 *
+		 * \brief	Deliver summaries of suppressed alerts to OnAlert, without waiting for the next alert.
+		 * 			Useful to call periodically when coalescing alerts, so suppressed alerts are reported
+		 * 			even if bucket stops being exhausted.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Flush();
+
 		/*!
 		 * \fn	void AlertsManager::ResetAll();
 		 *
@@ -229,11 +1066,13 @@ namespace BucketAlerts
 		 * \fn	void AlertsManager::Clear();
 		 *
 		 * \brief	Clears this object to its blank/initial state.
+		 * 			All bucket handles become invalid. Category templates and limits are kept (limits are reset).
+		 * 			Note: don't call this while other threads are consuming, as it invalidates buckets.
 		 *
 		 * \author	Ronen Ness
 		 * \date	3/31/2018
 		 */
-		inline void Clear();
+		void Clear();
 	};
 
 	/*!
@@ -247,4 +1086,994 @@ namespace BucketAlerts
 	 * \return	A reference to the default static AlertsManager.
 	 */
 	AlertsManager& get_main();
-}
\ No newline at end of file
+
+	template <class ManagerT>
+	BasicBucketHandle<ManagerT>::BasicBucketHandle(ManagerT* manager, typename ManagerT::Slot* slot, const typename ManagerT::GenerationCounter* generation) :
+		_manager(manager), _slot(slot), _generation(generation), _expected_generation(generation->load(std::memory_order_relaxed))
+	{
+	}
+
+	template <class ManagerT>
+	bool BasicBucketHandle<ManagerT>::Consume(double amount)
+	{
+		// bucket was cleared? do nothing.
+		// we enter the epoch before checking, so if bucket is still valid its not reused until we're done.
+		if (!_manager)
+			return true;
+		EpochDomain::ReadGuard guard(_manager->_epochs, ManagerT::Threading::Concurrent());
+		if (!Valid())
+			return true;
+
+		MetricsTimer timer(MetricTimer::Consume);
+		_manager->Touch(*_slot);
+		return _manager->ConsumeBucket(*_slot, amount);
+	}
+
+	template <class ManagerT>
+	void BasicBucketHandle<ManagerT>::Restore(double amount)
+	{
+		if (!_manager)
+			return;
+		EpochDomain::ReadGuard guard(_manager->_epochs, ManagerT::Threading::Concurrent());
+		if (Valid())
+			_slot->Bucket.Restore(amount);
+	}
+
+	template <class ManagerT>
+	double BasicBucketHandle<ManagerT>::Count()
+	{
+		if (!_manager)
+			return 0;
+		EpochDomain::ReadGuard guard(_manager->_epochs, ManagerT::Threading::Concurrent());
+		return Valid() ? _slot->Bucket.Count() : 0;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::BasicAlertsManager()
+	{
+		_epoch = Bucket::Clock::Now();
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::~BasicAlertsManager()
+	{
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Handle BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::CreateBucket(CategoryId cat_id, BucketId bucket_id, const Bucket& bucket, const AlertHandler& handler)
+	{
+		MetricsTimer timer(MetricTimer::CreateBucket);
+
+		// get shard
+		BucketKey key = MakeBucketKey(cat_id, bucket_id);
+		Shard& shard = GetShard(key);
+
+		// lock shard mutex
+		LockMeasured(shard.Mutex);
+
+		// create bucket in shard and get its handle
+		uint32_t index;
+		shard.Buckets.Reclaim(_epochs);
+		Slot& slot = NewSlot(shard, key, &index);
+		BeginSet(slot);
+		slot.Bucket = bucket;
+		slot.Handler = handler;
+		slot.Key = key;
+		slot.Category = &GetCategory(cat_id);
+		slot.Alert = AlertCoalescer();
+		slot.Evictable = false;
+		EndSet(slot);
+		Handle ret(this, &slot, &shard.Buckets.GenerationAt(index));
+
+		// unlock shard mutex
+		shard.Mutex.unlock();
+
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Handle BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback)
+	{
+		Bucket bucket(starting_tokens, max_tokens, replenish_rate);
+		bucket.OnBucketExhausted = callback;
+		return CreateBucket(cat_id, bucket_id, bucket);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Handle BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler)
+	{
+		return CreateBucket(cat_id, bucket_id, Bucket(starting_tokens, max_tokens, replenish_rate), handler);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Handle BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::CreateBucket(BucketId bucket_id, const Bucket& bucket, const AlertHandler& handler)
+	{
+		return CreateBucket(Defs::DefaultCategoryId, bucket_id, bucket, handler);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Handle BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback)
+	{
+		return CreateBucket(Defs::DefaultCategoryId, bucket_id, starting_tokens, max_tokens, replenish_rate, callback);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Handle BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler)
+	{
+		return CreateBucket(Defs::DefaultCategoryId, bucket_id, starting_tokens, max_tokens, replenish_rate, handler);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	bool BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::CreateBuckets(const BucketsConfig& config, const CallbacksRegistry<Callback>& callbacks, std::string* missing)
+	{
+		MetricsTimer timer(MetricTimer::CreateBucket);
+
+		// resolve callbacks before creating anything
+		std::vector<Callback> resolved;
+		if (!callbacks.Resolve(config.CallbackNames, resolved, missing))
+			return false;
+
+		// sort definitions by shard (counting sort, keeps definitions order inside each shard)
+		const std::vector<BucketDefinition>& definitions = config.Buckets;
+		size_t count = definitions.size();
+		size_t starts[ShardsCount + 1] = {};
+		std::vector<uint32_t> shards(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			shards[i] = ShardIndex(MakeBucketKey(definitions[i].Category, definitions[i].Bucket));
+			starts[shards[i] + 1]++;
+		}
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+			starts[i + 1] += starts[i];
+		std::vector<uint32_t> order(count);
+		size_t positions[ShardsCount];
+		std::copy(starts, starts + ShardsCount, positions);
+		for (size_t i = 0; i < count; ++i)
+			order[positions[shards[i]]++] = (uint32_t)i;
+
+		// fill shard by shard, locking and growing each shard once.
+		// definitions are usually grouped by category, so we only look up category when it changes.
+		CategoryState* category = nullptr;
+		CategoryId category_id = 0;
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			if (starts[i] == starts[i + 1])
+				continue;
+
+			Shard& shard = _shards[i];
+			LockMeasured(shard.Mutex);
+			shard.Buckets.Reclaim(_epochs);
+			shard.Buckets.Reserve((size_t)shard.Buckets.Size() + (starts[i + 1] - starts[i]));
+			for (size_t j = starts[i]; j < starts[i + 1]; ++j)
+			{
+				const BucketDefinition& definition = definitions[order[j]];
+				if (!category || definition.Category != category_id)
+				{
+					category = &GetCategory(definition.Category);
+					category_id = definition.Category;
+				}
+
+				BucketKey key = MakeBucketKey(definition.Category, definition.Bucket);
+				Slot& slot = NewSlot(shard, key);
+				BeginSet(slot);
+				slot.Bucket = Bucket(definition.StartingTokens, definition.MaxTokens, definition.ReplenishRate);
+				slot.Bucket.OnBucketExhausted = definition.Callback != BucketsConfig::NoCallback ? resolved[definition.Callback] : nullptr;
+				slot.Handler.Reset();
+				slot.Key = key;
+				slot.Category = category;
+				slot.Alert = AlertCoalescer();
+				slot.Evictable = false;
+				EndSet(slot);
+			}
+			shard.Mutex.unlock();
+		}
+		return true;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	bool BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::RemoveBucket(CategoryId cat_id, BucketId bucket_id)
+	{
+		// retire instead of removing, so snapshots that may be reading the bucket don't see its memory reused
+		BucketKey key = MakeBucketKey(cat_id, bucket_id);
+		Shard& shard = GetShard(key);
+		LockMeasured(shard.Mutex);
+		bool ret = shard.Buckets.Retire(key, _epochs);
+		shard.Mutex.unlock();
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	bool BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::RemoveBucket(BucketId bucket_id)
+	{
+		return RemoveBucket(Defs::DefaultCategoryId, bucket_id);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Clear()
+	{
+		// clear all shards (retire buckets, as consumers and snapshots may still use them)
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			Shard& shard = _shards[i];
+			shard.Mutex.lock();
+			shard.Buckets.RetireAll(_epochs);
+			shard.Mutex.unlock();
+		}
+
+		// reset categories alerts state and limits (but keep them, buckets may still point to them)
+		_categories_mutex.lock();
+		for (uint32_t j = 0; j < _categories.Count(); ++j)
+		{
+			CategoryState& category = _categories.At(j);
+			category.Alert = AlertCoalescer();
+			category.LimitAlert = AlertCoalescer();
+			category.Limit.Reset();
+		}
+		_categories_mutex.unlock();
+
+		// reset global limit
+		_global_limit_alert = AlertCoalescer();
+		_global_limit.Reset();
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Slot& BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::FindOrCreate(BucketKey key, Handle* handle)
+	{
+		// get shard
+		Shard& shard = GetShard(key);
+
+		// find existing bucket while only locking the shard for reading.
+		// buckets are never moved when the table grows, so its safe to return them after unlocking.
+		// we mark it used before unlocking, so it can't be evicted before we use it.
+		uint32_t index;
+		LockSharedMeasured(shard.Mutex);
+		Slot* ret = shard.Buckets.Find(key, &index);
+		if (ret)
+		{
+			Touch(*ret);
+			if (handle) *handle = Handle(this, ret, &shard.Buckets.GenerationAt(index));
+		}
+		shard.Mutex.unlock_shared();
+
+		// didn't find? create it from category template (and evict a few idle buckets while at it)
+		if (!ret)
+		{
+			bool created;
+			int64_t now = EvictionNow();
+			LockMeasured(shard.Mutex);
+			if (IdleTimeout > 0)
+				EvictFromShard(shard, now, EvictionBudget);
+			shard.Buckets.Reclaim(_epochs);
+			ret = &shard.Buckets.GetOrCreate(key, created, &index);
+			if (created) InitBucket(*ret, key, now);
+			else Touch(*ret, now);
+			if (handle) *handle = Handle(this, ret, &shard.Buckets.GenerationAt(index));
+			shard.Mutex.unlock();
+		}
+
+		return *ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::InitBucket(Slot& slot, BucketKey key, int64_t now)
+	{
+		// get category template (if set)
+		BucketTemplate bucket_template;
+		_templates_mutex.lock_shared();
+		BucketTemplate* found = _templates.Find((BucketKey)(key >> 32));
+		if (found) bucket_template = *found;
+		_templates_mutex.unlock_shared();
+
+		// create bucket (a fresh bucket, so its replenish time starts now)
+		CategoryState* category = &GetCategory((CategoryId)(key >> 32));
+		BeginSet(slot);
+		if (found)
+		{
+			slot.Bucket = Bucket(bucket_template.StartingTokens, bucket_template.MaxTokens, bucket_template.ReplenishRate);
+			slot.Bucket.OnBucketExhausted = bucket_template.OnBucketExhausted;
+			slot.Handler = bucket_template.Handler;
+		}
+		slot.Key = key;
+		slot.Category = category;
+		slot.Evictable = true;
+		slot.LastUsed.store(now, std::memory_order_relaxed);
+		EndSet(slot);
+		Metrics::Count(MetricCounter::LookupMisses);
+		Metrics::Count(MetricCounter::BucketsCreated);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::SetCategoryTemplate(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback)
+	{
+		bool created;
+		_templates_mutex.lock();
+		BucketTemplate& bucket_template = _templates.GetOrCreate(cat_id, created);
+		bucket_template.StartingTokens = starting_tokens;
+		bucket_template.MaxTokens = max_tokens;
+		bucket_template.ReplenishRate = replenish_rate;
+		bucket_template.OnBucketExhausted = callback;
+		bucket_template.Handler.Reset();
+		_templates_mutex.unlock();
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::SetCategoryTemplate(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler)
+	{
+		bool created;
+		_templates_mutex.lock();
+		BucketTemplate& bucket_template = _templates.GetOrCreate(cat_id, created);
+		bucket_template.StartingTokens = starting_tokens;
+		bucket_template.MaxTokens = max_tokens;
+		bucket_template.ReplenishRate = replenish_rate;
+		bucket_template.OnBucketExhausted = nullptr;
+		bucket_template.Handler = handler;
+		_templates_mutex.unlock();
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::RemoveCategoryTemplate(CategoryId cat_id)
+	{
+		_templates_mutex.lock();
+		_templates.Remove(cat_id);
+		_templates_mutex.unlock();
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	int64_t BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::EvictionNow()
+	{
+		return IdleTimeout > 0 ? NowTime() : 0;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	size_t BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::EvictFromShard(Shard& shard, int64_t now, uint32_t budget)
+	{
+		// like a clock hand, every call continues from where the previous one stopped
+		int64_t idle_time = (int64_t)(IdleTimeout * 1000000000.0);
+		uint32_t count = shard.Buckets.Count();
+		size_t ret = 0;
+		for (uint32_t i = 0; i < budget && i < count; ++i)
+		{
+			if (shard.EvictCursor >= count)
+				shard.EvictCursor = 0;
+			uint32_t index = shard.EvictCursor++;
+			if (!shard.Buckets.Used(index))
+				continue;
+
+			// evict if implicit, idle, has no pending alerts and full (so recreating it later changes nothing)
+			Slot& slot = shard.Buckets.At(index);
+			if (slot.Evictable &&
+				now - slot.LastUsed.load(std::memory_order_relaxed) >= idle_time &&
+				!slot.Alert.Pending() &&
+				slot.Bucket.Count() >= slot.Bucket.MaxTokens())
+			{
+				shard.Buckets.Retire(slot.Key, _epochs);
+				ret++;
+			}
+		}
+		if (ret) Metrics::Count(MetricCounter::BucketsEvicted, ret);
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	size_t BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::EvictIdle()
+	{
+		if (IdleTimeout <= 0)
+			return 0;
+
+		// sweep all shards, one at a time
+		int64_t now = EvictionNow();
+		size_t ret = 0;
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			Shard& shard = _shards[i];
+			shard.Mutex.lock();
+			ret += EvictFromShard(shard, now, shard.Buckets.Count());
+			shard.Mutex.unlock();
+		}
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	size_t BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::BucketsCount()
+	{
+		size_t ret = 0;
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			Shard& shard = _shards[i];
+			shard.Mutex.lock_shared();
+			ret += shard.Buckets.Size();
+			shard.Mutex.unlock_shared();
+		}
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::GetMetrics(MetricsSnapshot& out)
+	{
+		Metrics::Snapshot(out);
+		out.Buckets = BucketsCount();
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Bucket& BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::GetBucket(CategoryId cat_id, BucketId bucket_id)
+	{
+		return FindOrCreate(MakeBucketKey(cat_id, bucket_id), nullptr).Bucket;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Bucket& BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::GetBucket(BucketId bucket_id)
+	{
+		return GetBucket(Defs::DefaultCategoryId, bucket_id);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Handle BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Resolve(CategoryId cat_id, BucketId bucket_id)
+	{
+		Handle ret;
+		FindOrCreate(MakeBucketKey(cat_id, bucket_id), &ret);
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Handle BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Resolve(BucketId bucket_id)
+	{
+		return Resolve(Defs::DefaultCategoryId, bucket_id);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	bool BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Consume(CategoryId cat_id, BucketId bucket_id, double amount)
+	{
+		// skip if disabled
+		if (!Enabled)
+			return true;
+
+		// get bucket and consume from it (in the epoch, so the bucket can't be removed and reused while we use it)
+		MetricsTimer timer(MetricTimer::Consume);
+		EpochDomain::ReadGuard guard(_epochs, ThreadingT::Concurrent());
+		return ConsumeBucket(FindOrCreate(MakeBucketKey(cat_id, bucket_id), nullptr), amount);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	bool BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::ConsumeBucket(Slot& slot, double amount)
+	{
+		// skip if disabled
+		if (!Enabled)
+			return true;
+
+		// no limits above this bucket? just consume it and get if exhausted (we invoke the callback ourselves)
+		bool ret;
+		AlertLevel level = AlertLevel::Bucket;
+		if (!_has_limits.load(std::memory_order_acquire) ||
+			(!_has_global_limit.load(std::memory_order_acquire) && !slot.Category->HasLimit.load(std::memory_order_acquire)))
+			ret = slot.Bucket.Consume(amount, false);
+		// has limits? charge all levels with a single clock read (or none, if buckets are updated manually)
+		else
+			ret = ConsumeLevels(slot, amount, Bucket::UpdatePolicy::Auto() ? Bucket::Clock::Now() : typename Bucket::Clock::TimePoint(), level);
+
+		// if exhausted, notify and reset bucket if needed
+		if (!ret)
+		{
+			Notify(slot, level, amount);
+			ResetExhausted(slot, level);
+		}
+
+		// return result
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	bool BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::ConsumeLevels(Slot& slot, double amount, const typename Bucket::Clock::TimePoint& now, AlertLevel& level)
+	{
+		// bucket itself
+		if (!slot.Bucket.Consume(amount, now, false))
+		{
+			level = AlertLevel::Bucket;
+			return false;
+		}
+
+		// category limit
+		CategoryState& category = *slot.Category;
+		bool has_limit = category.HasLimit.load(std::memory_order_acquire);
+		// (levels already charged are rolled back with Return(), so a rejected consume is not counted as consumed)
+		if (has_limit && !category.Limit.Consume(amount, now, false))
+		{
+			slot.Bucket.Return(amount);
+			level = AlertLevel::Category;
+			return false;
+		}
+
+		// global limit
+		if (_has_global_limit.load(std::memory_order_acquire) && !_global_limit.Consume(amount, now, false))
+		{
+			if (has_limit) category.Limit.Return(amount);
+			slot.Bucket.Return(amount);
+			level = AlertLevel::Global;
+			return false;
+		}
+
+		return true;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::ResetExhausted(Slot& slot, AlertLevel level)
+	{
+		if (!ExhaustT::Reset())
+			return;
+		switch (level)
+		{
+		case AlertLevel::Bucket: slot.Bucket.Reset(); break;
+		case AlertLevel::Category: slot.Category->Limit.Reset(); break;
+		case AlertLevel::Global: _global_limit.Reset(); break;
+		}
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::UpdateLimits(bool reset)
+	{
+		_categories_mutex.lock_shared();
+		for (uint32_t j = 0; j < _categories.Count(); ++j)
+		{
+			CategoryState& category = _categories.At(j);
+			if (!category.HasLimit.load(std::memory_order_acquire))
+				continue;
+			if (reset) category.Limit.Reset();
+			else category.Limit.Update();
+		}
+		_categories_mutex.unlock_shared();
+
+		if (_has_global_limit.load(std::memory_order_acquire))
+		{
+			if (reset) _global_limit.Reset();
+			else _global_limit.Update();
+		}
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::SetCategoryLimit(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, Callback callback)
+	{
+		CategoryState& category = GetCategory(cat_id);
+		category.Limit = Bucket(starting_tokens, max_tokens, replenish_rate);
+		category.Limit.OnBucketExhausted = callback;
+		category.LimitHandler.Reset();
+		category.LimitAlert = AlertCoalescer();
+		category.HasLimit.store(true, std::memory_order_release);
+		_has_limits.store(true, std::memory_order_release);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::SetCategoryLimit(CategoryId cat_id, double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler)
+	{
+		SetCategoryLimit(cat_id, starting_tokens, max_tokens, replenish_rate, (Callback)nullptr);
+		GetCategory(cat_id).LimitHandler = handler;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::RemoveCategoryLimit(CategoryId cat_id)
+	{
+		GetCategory(cat_id).HasLimit.store(false, std::memory_order_release);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::SetGlobalLimit(double starting_tokens, double max_tokens, double replenish_rate, Callback callback)
+	{
+		_global_limit = Bucket(starting_tokens, max_tokens, replenish_rate);
+		_global_limit.OnBucketExhausted = callback;
+		_global_limit_handler.Reset();
+		_global_limit_alert = AlertCoalescer();
+		_has_global_limit.store(true, std::memory_order_release);
+		_has_limits.store(true, std::memory_order_release);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::SetGlobalLimit(double starting_tokens, double max_tokens, double replenish_rate, const AlertHandler& handler)
+	{
+		SetGlobalLimit(starting_tokens, max_tokens, replenish_rate, (Callback)nullptr);
+		_global_limit_handler = handler;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::RemoveGlobalLimit()
+	{
+		_has_global_limit.store(false, std::memory_order_release);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	bool BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Consume(BucketId bucket_id, double amount)
+	{
+		return Consume(Defs::DefaultCategoryId, bucket_id, amount);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	bool BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::ConsumeBatched(Slot& slot, double amount, const typename Bucket::Clock::TimePoint& now, int64_t eviction_now, std::vector<Exhausted>& exhausted)
+	{
+		// consume without invoking the callback
+		Touch(slot, eviction_now);
+		AlertLevel level;
+		bool ret = ConsumeLevels(slot, amount, now, level);
+
+		// if exhausted remember bucket to notify (and reset if needed) later
+		if (!ret)
+			exhausted.push_back(Exhausted { &slot, level, amount });
+
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::ConsumeMany(const ConsumeRecord* records, size_t count, bool* results)
+	{
+		// skip if disabled
+		if (!Enabled)
+		{
+			for (size_t i = 0; i < count; ++i)
+				results[i] = true;
+			return;
+		}
+
+		// measure the whole batch
+		MetricsTimer timer(MetricTimer::ConsumeMany);
+
+		// single clock read for the whole batch (also used to mark buckets as used). if buckets are updated
+		// manually and there's no eviction, nothing needs the time and we don't read the clock.
+		typename Bucket::Clock::TimePoint now = (Bucket::UpdatePolicy::Auto() || IdleTimeout > 0) ? Bucket::Clock::Now() : typename Bucket::Clock::TimePoint();
+		int64_t eviction_now = IdleTimeout > 0 ? TimeAt(now) : 0;
+
+		// sort records by shard (counting sort, keeps records order inside each shard)
+		size_t starts[ShardsCount + 1] = {};
+		std::vector<uint32_t> shards(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			shards[i] = ShardIndex(MakeBucketKey(records[i].Category, records[i].Bucket));
+			starts[shards[i] + 1]++;
+		}
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+			starts[i + 1] += starts[i];
+		std::vector<uint32_t> order(count);
+		size_t positions[ShardsCount];
+		std::copy(starts, starts + ShardsCount, positions);
+		for (size_t i = 0; i < count; ++i)
+			order[positions[shards[i]]++] = (uint32_t)i;
+
+		// consume shard by shard (in the epoch, so buckets we notify after the batch can't be reused before)
+		EpochDomain::ReadGuard guard(_epochs, ThreadingT::Concurrent());
+		std::vector<Exhausted> exhausted;
+		std::vector<uint32_t> missing;
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			if (starts[i] == starts[i + 1])
+				continue;
+
+			// consume existing buckets while locking the shard once for reading
+			Shard& shard = _shards[i];
+			LockSharedMeasured(shard.Mutex);
+			for (size_t j = starts[i]; j < starts[i + 1]; ++j)
+			{
+				const ConsumeRecord& record = records[order[j]];
+				Slot* slot = shard.Buckets.Find(MakeBucketKey(record.Category, record.Bucket));
+				if (slot)
+					results[order[j]] = ConsumeBatched(*slot, record.Amount, now, eviction_now, exhausted);
+				else
+					missing.push_back(order[j]);
+			}
+			shard.Mutex.unlock_shared();
+
+			// create missing buckets from their templates and consume them, while locking the shard once for writing
+			if (!missing.empty())
+			{
+				LockMeasured(shard.Mutex);
+				if (IdleTimeout > 0)
+					EvictFromShard(shard, eviction_now, EvictionBudget);
+				shard.Buckets.Reclaim(_epochs);
+				for (uint32_t index : missing)
+				{
+					bool created;
+					BucketKey key = MakeBucketKey(records[index].Category, records[index].Bucket);
+					Slot& slot = shard.Buckets.GetOrCreate(key, created);
+					if (created) InitBucket(slot, key, eviction_now);
+					results[index] = ConsumeBatched(slot, records[index].Amount, now, eviction_now, exhausted);
+				}
+				shard.Mutex.unlock();
+				missing.clear();
+			}
+		}
+
+		// notify after the batch, then reset if needed (callbacks see buckets as they were exhausted)
+		for (const Exhausted& item : exhausted)
+		{
+			Notify(*item.Bucket, item.Level, item.Amount);
+			ResetExhausted(*item.Bucket, item.Level);
+		}
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	typename BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::CategoryState& BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::GetCategory(CategoryId cat_id)
+	{
+		// try to find existing state while locking for reading
+		_categories_mutex.lock_shared();
+		CategoryState* ret = _categories.Find(cat_id);
+		_categories_mutex.unlock_shared();
+
+		// not found? create it (states are never moved, so its safe to use them after unlocking)
+		if (!ret)
+		{
+			bool created;
+			_categories_mutex.lock();
+			ret = &_categories.GetOrCreate(cat_id, created);
+			_categories_mutex.unlock();
+		}
+		return *ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Notify(Slot& slot, AlertLevel level, double amount)
+	{
+		Metrics::Count(MetricCounter::Exhaustions);
+
+		// get alert info
+		AlertInfo info = {};
+		info.Category = (CategoryId)(slot.Key >> 32);
+		info.Bucket = (BucketId)slot.Key;
+		info.Level = level;
+
+		// get the exhausted bucket, its handler and coalescing state
+		Bucket* bucket = &slot.Bucket;
+		const AlertHandler* handler = &slot.Handler;
+		AlertCoalescer* alert = &slot.Alert;
+		if (level == AlertLevel::Category)
+		{
+			bucket = &slot.Category->Limit;
+			handler = &slot.Category->LimitHandler;
+			alert = &slot.Category->LimitAlert;
+		}
+		else if (level == AlertLevel::Global)
+		{
+			bucket = &_global_limit;
+			handler = &_global_limit_handler;
+			alert = &_global_limit_alert;
+		}
+
+		// coalesce alerts, if enabled
+		if (CoalesceWindow > 0 || CategoryCoalesceWindow > 0)
+		{
+			int64_t now = NowTime();
+			info.Time = (double)now / 1000000000.0;
+
+			// check bucket (or limit) window
+			if (CoalesceWindow > 0 && !alert->Check(now, (int64_t)(CoalesceWindow * 1000000000.0), info))
+			{
+				Metrics::Count(MetricCounter::AlertsCoalesced);
+				return;
+			}
+
+			// check category window (if suppressed, category takes the bucket's suppressed alerts too).
+			// global limit alerts are not per category, so they only have their own window.
+			if (CategoryCoalesceWindow > 0 && level != AlertLevel::Global && !slot.Category->Alert.Check(now, (int64_t)(CategoryCoalesceWindow * 1000000000.0), info))
+			{
+				Metrics::Count(MetricCounter::AlertsCoalesced);
+				return;
+			}
+		}
+		else if (OnAlert)
+		{
+			info.Time = (double)NowTime() / 1000000000.0;
+		}
+
+		// invoke bucket callback and alert handler (or queue them, if we have a dispatcher)
+		AlertsDispatcher* dispatcher = Dispatcher;
+		if (dispatcher)
+		{
+			dispatcher->Post(*bucket);
+			dispatcher->Post(*handler, info.Category, info.Bucket, amount);
+		}
+		else if (bucket->OnBucketExhausted || *handler)
+		{
+			MetricsTimer timer(MetricTimer::Callback);
+			if (bucket->OnBucketExhausted)
+				bucket->OnBucketExhausted(*bucket);
+			if (*handler)
+				(*handler)(info.Category, info.Bucket, amount);
+		}
+
+		// invoke alert callback
+		AlertCallback on_alert = OnAlert;
+		if (on_alert)
+			on_alert(info);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Flush()
+	{
+		AlertCallback on_alert = OnAlert;
+		double now = (double)NowTime() / 1000000000.0;
+
+		// buckets summaries
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			Shard& shard = _shards[i];
+			shard.Mutex.lock_shared();
+			for (uint32_t j = 0; j < shard.Buckets.Count(); ++j)
+			{
+				if (!shard.Buckets.Used(j))
+					continue;
+				Slot& slot = shard.Buckets.At(j);
+				AlertInfo info = {};
+				if (slot.Alert.Flush(info) && on_alert)
+				{
+					info.Category = (CategoryId)(slot.Key >> 32);
+					info.Bucket = (BucketId)slot.Key;
+					info.Time = now;
+					on_alert(info);
+				}
+			}
+			shard.Mutex.unlock_shared();
+		}
+
+		// categories summaries (of category limits, and of all alerts in category)
+		_categories_mutex.lock_shared();
+		for (uint32_t j = 0; j < _categories.Count(); ++j)
+		{
+			AlertInfo info = {};
+			if (_categories.At(j).LimitAlert.Flush(info) && on_alert)
+			{
+				info.Category = (CategoryId)_categories.KeyAt(j);
+				info.Level = AlertLevel::Category;
+				info.Time = now;
+				on_alert(info);
+			}
+			info = {};
+			if (_categories.At(j).Alert.Flush(info) && on_alert)
+			{
+				info.Category = (CategoryId)_categories.KeyAt(j);
+				info.CategoryLevel = true;
+				info.Time = now;
+				on_alert(info);
+			}
+		}
+		_categories_mutex.unlock_shared();
+
+		// global limit summary
+		AlertInfo info = {};
+		if (_global_limit_alert.Flush(info) && on_alert)
+		{
+			info.Level = AlertLevel::Global;
+			info.Time = now;
+			on_alert(info);
+		}
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Restore(CategoryId cat_id, BucketId bucket_id, double amount)
+	{
+		EpochDomain::ReadGuard guard(_epochs, ThreadingT::Concurrent());
+		GetBucket(cat_id, bucket_id).Restore(amount);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Restore(BucketId bucket_id, double amount)
+	{
+		Restore(Defs::DefaultCategoryId, bucket_id, amount);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	double BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Take(CategoryId cat_id, BucketId bucket_id, double max_amount)
+	{
+		EpochDomain::ReadGuard guard(_epochs, ThreadingT::Concurrent());
+		return FindOrCreate(MakeBucketKey(cat_id, bucket_id), nullptr).Bucket.Take(max_amount);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::ManualUpdate()
+	{
+		MetricsTimer timer(MetricTimer::ManualUpdate);
+
+		// buckets lock themselves, so we only need to lock one shard at a time for reading
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			Shard& shard = _shards[i];
+			shard.Mutex.lock_shared();
+			for (uint32_t j = 0; j < shard.Buckets.Count(); ++j)
+			{
+				if (shard.Buckets.Used(j))
+					shard.Buckets.At(j).Bucket.Update();
+			}
+			shard.Mutex.unlock_shared();
+		}
+
+		// update limits
+		UpdateLimits(false);
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	template <class Func>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::ForEachBucket(Func func)
+	{
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			Shard& shard = _shards[i];
+			shard.Mutex.lock_shared();
+			for (uint32_t j = 0; j < shard.Buckets.Count(); ++j)
+			{
+				if (shard.Buckets.Used(j))
+				{
+					Slot& slot = shard.Buckets.At(j);
+					func(slot.Key, slot.Bucket);
+				}
+			}
+			shard.Mutex.unlock_shared();
+		}
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	size_t BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::Snapshot(BucketSnapshot* out, size_t capacity)
+	{
+		// while we read, removed buckets are retired and not reused, so every entry we see stays a valid slot.
+		// entries are only counted once set, so we never read an entry that is being added.
+		EpochDomain::ReadGuard guard(_epochs);
+		size_t ret = 0;
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			BucketsTable<Slot, ThreadingT>& buckets = _shards[i].Buckets;
+			uint32_t count = buckets.PublishedCount();
+			for (uint32_t j = 0; j < count; ++j)
+			{
+				// read slot, and read again if it was set while we read it
+				Slot& slot = buckets.At(j);
+				BucketSnapshot snapshot;
+				bool used;
+				while (true)
+				{
+					uint32_t version = slot.Version.load(std::memory_order_acquire);
+					if (version & 1)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+					used = buckets.Used(j) && slot.Category;
+					if (used)
+					{
+						snapshot.Category = (CategoryId)(slot.Key >> 32);
+						snapshot.Bucket = (BucketId)slot.Key;
+						snapshot.Tokens = slot.Bucket.Peek();
+						snapshot.MaxTokens = slot.Bucket.MaxTokens();
+						snapshot.ReplenishRate = slot.Bucket.ReplenishRate();
+						snapshot.TotalConsumed = slot.Bucket.TotalConsumed();
+					}
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (slot.Version.load(std::memory_order_relaxed) == version)
+						break;
+				}
+
+				// add to buffer, or just count if its full
+				if (!used)
+					continue;
+				if (ret < capacity)
+					out[ret] = snapshot;
+				ret++;
+			}
+		}
+		return ret;
+	}
+
+	template <class BucketT, class ThreadingT, class ExhaustT>
+	void BasicAlertsManager<BucketT, ThreadingT, ExhaustT>::ResetAll()
+	{
+		// buckets lock themselves, so we only need to lock one shard at a time for reading
+		for (unsigned int i = 0; i < ShardsCount; ++i)
+		{
+			Shard& shard = _shards[i];
+			shard.Mutex.lock_shared();
+			for (uint32_t j = 0; j < shard.Buckets.Count(); ++j)
+			{
+				if (shard.Buckets.Used(j))
+					shard.Buckets.At(j).Bucket.Reset();
+			}
+			shard.Mutex.unlock_shared();
+		}
+
+		// reset limits
+		UpdateLimits(true);
+	}
+
+	// the default manager is compiled once, in AlertsManager.cpp
+	extern template class BasicBucketHandle<AlertsManager>;
+	extern template class BasicAlertsManager<TokenBucket>;
+}
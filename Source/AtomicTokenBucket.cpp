@@ -0,0 +1,7 @@
+#include "AtomicTokenBucket.h"
+
+namespace BucketAlerts
+{
+	// compile the default bucket once
+	template class BasicAtomicTokenBucket<AccurateClock>;
+}
@@ -0,0 +1,662 @@
+/*!
+ * \file	Source\AtomicTokenBucket.h.
+ *
+ * \brief	Declares the lock-free token bucket class.
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include "Clock.h"
+#include "Policies.h"
+
+
+namespace BucketAlerts
+{
+	// predef
+	template <class ClockT = AccurateClock, class UpdateT = RuntimeUpdate>
+	class BasicAtomicTokenBucket;
+
+	/*!
+	 * \typedef	BasicAtomicTokenBucket<AccurateClock> AtomicTokenBucket
+	 *
+	 * \brief	The default lock-free token bucket, using the accurate clock.
+	 */
+	typedef BasicAtomicTokenBucket<AccurateClock> AtomicTokenBucket;
+
+	/*!
+	 * \typedef	void(*AtomicBucketCallback)(const AtomicTokenBucket& bucket)
+	 *
+	 * \brief	A callback we can attach to a lock-free bucket to call when exhausted.
+	 */
+	typedef void(*AtomicBucketCallback)(const AtomicTokenBucket& bucket);
+
+	/*!
+	 * \class	BasicAtomicTokenBucket
+	 *
+	 * \brief	A lock-free token bucket.
+	 * 			Tokens and last update time are packed into a single 64 bit word (upper 32 bits are
+	 * 			the tokens in fixed-point, lower 32 bits are microseconds since the bucket was created)
+	 * 			and are updated together with a CAS loop, so consuming never takes a lock.
+	 * 			The fixed-point precision is picked from the max tokens: the smaller the bucket,
+	 * 			the more fraction bits it gets (max tokens is limited to 2^32 - 1).
+	 * 			This bucket ignores Defs::ThreadSafe, as it is always thread safe. Auto-update is a policy (see Policies.h).
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class ClockT, class UpdateT>
+	class BasicAtomicTokenBucket
+	{
+	public:
+
+		/*! \brief	The clock this bucket measures time with. */
+		typedef ClockT Clock;
+
+		/*! \brief	The update policy of this bucket (if not auto, time passed to Consume() is ignored). */
+		typedef UpdateT UpdatePolicy;
+
+		/*! \brief	A callback we can attach to this bucket type to call when exhausted. */
+		typedef void(*Callback)(const BasicAtomicTokenBucket& bucket);
+
+	private:
+		// packed tokens (high 32 bits, fixed-point) and update time (low 32 bits, microseconds).
+		// kept on its own cache line together with total consumption, which changes with it.
+		alignas(64) std::atomic<uint64_t> _state;
+
+		// total tokens consumed since created, in fixed-point.
+		std::atomic<uint64_t> _total_consumption;
+
+		// last time we changed state, in full 64 bit microseconds (used to detect 32 bit time wrap).
+		std::atomic<uint64_t> _last_touch;
+
+		// how many new tokens we get per second.
+		alignas(64) double _replenish_rate;
+
+		// max tokens allowed in bucket.
+		double _max_tokens;
+
+		// starting value.
+		double _starting_count;
+
+		// how many fraction bits our fixed-point tokens have.
+		unsigned int _fraction_bits;
+
+		// fixed-point units per token, and fixed-point units we gain per microsecond.
+		double _units_per_token;
+		double _units_per_tick;
+
+		// max tokens in fixed-point.
+		uint32_t _max_units;
+
+		// time point that microseconds are counted from.
+		typename ClockT::TimePoint _epoch;
+
+		// pack tokens and time into a single state word
+		static inline uint64_t PackState(uint32_t tokens, uint32_t ticks)
+		{
+			return ((uint64_t)tokens << 32) | ticks;
+		}
+
+		// get tokens from state word
+		static inline uint32_t StateTokens(uint64_t state)
+		{
+			return (uint32_t)(state >> 32);
+		}
+
+		// get time from state word
+		static inline uint32_t StateTicks(uint64_t state)
+		{
+			return (uint32_t)state;
+		}
+
+		// init fixed-point params from max tokens.
+		void InitFixedPoint();
+
+		// convert amount to fixed-point (clamped to 32 bit).
+		uint32_t ToUnits(double amount) const;
+
+		// get microseconds since epoch.
+		uint64_t NowTicks() const;
+
+		// get microseconds since epoch at a given time point.
+		uint64_t TicksAt(const typename ClockT::TimePoint& now) const;
+
+		// calculate packed state after replenishing tokens up to given time.
+		uint64_t Replenish(uint64_t state, uint64_t now_ticks) const;
+
+	public:
+
+		/*! \brief	Optional function to call when bucket runs out of tokens */
+		Callback OnBucketExhausted = nullptr;
+
+		/*!
+		 * \fn	AtomicTokenBucket::AtomicTokenBucket(double starting, double max, double replenish_rate);
+		 *
+		 * \brief	Constructor
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	starting	  	Starting tokens count.
+		 * \param	max			  	Max tokens allowed in bucket.
+		 * \param	replenish_rate	Tokens replenish rate (tokens per second).
+		 */
+		BasicAtomicTokenBucket(double starting=0, double max=10, double replenish_rate=1);
+
+		/*!
+		 * \fn	AtomicTokenBucket::AtomicTokenBucket(const AtomicTokenBucket& other);
+		 *
+		 * \brief	Copy constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	other	The other object.
+		 */
+		BasicAtomicTokenBucket(const BasicAtomicTokenBucket& other);
+
+		/*!
+		 * \fn	const AtomicTokenBucket& AtomicTokenBucket::operator=(const AtomicTokenBucket& other);
+		 *
+		 * \brief	Assignment operator.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	other	The other object.
+		 *
+		 * \return	A shallow copy of this object.
+		 */
+		const BasicAtomicTokenBucket& operator=(const BasicAtomicTokenBucket& other);
+
+		/*!
+		 * \fn	bool AtomicTokenBucket::Consume(double amount = 1.0);
+		 *
+		 * \brief	Consumes the given amount of tokens.
+		 * 			If there are not enough tokens, will zero the bucket and invoke the callback from
+		 * 			the calling thread (once per failed consume, like TokenBucket does).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount to consume.
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount = 1.0);
+
+		/*!
+		 * \fn	bool AtomicTokenBucket::Consume(double amount, bool notify);
+		 *
+		 * \brief	Consumes the given amount of tokens, optionally without invoking the callback.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to consume.
+		 * \param	notify	If false, will not invoke the callback when exhausted (caller will do it).
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount, bool notify);
+
+		/*!
+		 * \fn	bool AtomicTokenBucket::Consume(double amount, const typename ClockT::TimePoint& now, bool notify);
+		 *
+		 * \brief	Consumes the given amount of tokens, using a time point we already read.
+		 * 			Useful when consuming many buckets at once, to read the clock only once.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to consume.
+		 * \param	now   	Current time (ignored if auto-update is off).
+		 * \param	notify	If false, will not invoke the callback when exhausted (caller will do it).
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount, const typename ClockT::TimePoint& now, bool notify);
+
+		/*!
+		 * \fn	void AtomicTokenBucket::Restore(double amount = 1.0);
+		 *
+		 * \brief	Restore the given amount of tokens.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount to restore.
+		 */
+		void Restore(double amount = 1.0);
+
+		/*!
+		 * \fn	double AtomicTokenBucket::Take(double max_amount);
+		 *
+		 * \brief	Take up to the given amount of tokens, without failing or invoking the callback.
+		 * 			Used by token leases to reserve a batch of tokens at once.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	max_amount	Max amount of tokens to take.
+		 *
+		 * \return	How many tokens were taken (0 if bucket is empty).
+		 */
+		double Take(double max_amount);
+
+		/*!
+		 * \fn	void AtomicTokenBucket::Return(double amount);
+		 *
+		 * \brief	Return tokens that were taken but not used.
+		 * 			Unlike Restore(), this also removes them from the total consumption (only the tokens
+		 * 			that fit in the bucket are returned, so consumption matches the tokens it holds).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to return.
+		 */
+		void Return(double amount);
+
+		/*!
+		 * \fn	bool AtomicTokenBucket::Test(double amount = 1.0) const;
+		 *
+		 * \brief	Tests if have enough tokens to consume.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount.
+		 *
+		 * \return	True if have enough tokens, false if not.
+		 */
+		bool Test(double amount = 1.0) const;
+
+		/*!
+		 * \fn	double AtomicTokenBucket::Count() const;
+		 *
+		 * \brief	Get current tokens count.
+		 * 			Unlike TokenBucket, this only reads the state and never writes it.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current tokens count.
+		 */
+		double Count() const;
+
+		/*!
+		 * \fn	double AtomicTokenBucket::TotalConsumed() const;
+		 *
+		 * \brief	Return how many tokens were consumed in total.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	The total number of consumed token since the creation of this bucket.
+		 */
+		double TotalConsumed() const;
+
+		/*!
+		 * \fn	inline double AtomicTokenBucket::MaxTokens() const
+		 *
+		 * \brief	Get the max tokens this bucket can hold.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Max tokens.
+		 */
+		inline double MaxTokens() const { return _max_tokens; }
+
+		/*!
+		 * \fn	inline double AtomicTokenBucket::ReplenishRate() const
+		 *
+		 * \brief	Get how many tokens are added per second.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Replenish rate.
+		 */
+		inline double ReplenishRate() const { return _replenish_rate; }
+
+		/*!
+		 * \fn	inline double AtomicTokenBucket::Peek() const
+		 *
+		 * \brief	Get current tokens count without writing anything (same as Count(), exists so the bucket can be used by managers).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current tokens count.
+		 */
+		inline double Peek() const { return Count(); }
+
+		/*!
+		 * \fn	void AtomicTokenBucket::Reset();
+		 *
+		 * \brief	Resets this bucket to its starting value;
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Reset();
+
+		/*!
+		 * \fn	void AtomicTokenBucket::Update();
+		 *
+		 * \brief	Updates the tokens (replenish tokens based on time).
+		 * 			Note: you do not need to call this function manually, unless you disable auto-update.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Update();
+	};
+
+	template <class ClockT, class UpdateT>
+	BasicAtomicTokenBucket<ClockT, UpdateT>::BasicAtomicTokenBucket(double starting, double max, double replenish_rate) :
+		_replenish_rate(replenish_rate), _max_tokens(max), _starting_count(starting)
+	{
+		InitFixedPoint();
+		_epoch = ClockT::Now();
+		_state.store(PackState(ToUnits(starting), 0), std::memory_order_relaxed);
+		_total_consumption.store(0, std::memory_order_relaxed);
+		_last_touch.store(0, std::memory_order_relaxed);
+	}
+
+	template <class ClockT, class UpdateT>
+	BasicAtomicTokenBucket<ClockT, UpdateT>::BasicAtomicTokenBucket(const BasicAtomicTokenBucket& other) :
+		_replenish_rate(other._replenish_rate), _max_tokens(other._max_tokens), _starting_count(other._starting_count)
+	{
+		*this = other;
+	}
+
+	template <class ClockT, class UpdateT>
+	const BasicAtomicTokenBucket<ClockT, UpdateT>& BasicAtomicTokenBucket<ClockT, UpdateT>::operator=(const BasicAtomicTokenBucket& other)
+	{
+		_replenish_rate = other._replenish_rate;
+		_max_tokens = other._max_tokens;
+		_starting_count = other._starting_count;
+		_fraction_bits = other._fraction_bits;
+		_units_per_token = other._units_per_token;
+		_units_per_tick = other._units_per_tick;
+		_max_units = other._max_units;
+		_epoch = other._epoch;
+		_state.store(other._state.load(std::memory_order_acquire), std::memory_order_release);
+		_total_consumption.store(other._total_consumption.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		_last_touch.store(other._last_touch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		OnBucketExhausted = other.OnBucketExhausted;
+		return *this;
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicAtomicTokenBucket<ClockT, UpdateT>::InitFixedPoint()
+	{
+		// find how many integer bits we need to hold max tokens, the rest are fraction bits
+		unsigned int integer_bits = 0;
+		while (integer_bits < 32 && std::ldexp(1.0, integer_bits) <= _max_tokens)
+			integer_bits++;
+		_fraction_bits = 32 - integer_bits;
+
+		// calc conversion factors
+		_units_per_token = std::ldexp(1.0, _fraction_bits);
+		_units_per_tick = _replenish_rate * _units_per_token / 1000000.0;
+		_max_units = ToUnits(_max_tokens);
+	}
+
+	template <class ClockT, class UpdateT>
+	uint32_t BasicAtomicTokenBucket<ClockT, UpdateT>::ToUnits(double amount) const
+	{
+		// negative / zero
+		if (amount <= 0)
+			return 0;
+
+		// clamp to what we can represent
+		double units = std::round(amount * _units_per_token);
+		if (units >= 4294967295.0)
+			return 0xFFFFFFFFu;
+
+		return (uint32_t)units;
+	}
+
+	template <class ClockT, class UpdateT>
+	uint64_t BasicAtomicTokenBucket<ClockT, UpdateT>::NowTicks() const
+	{
+		return TicksAt(ClockT::Now());
+	}
+
+	template <class ClockT, class UpdateT>
+	uint64_t BasicAtomicTokenBucket<ClockT, UpdateT>::TicksAt(const typename ClockT::TimePoint& now) const
+	{
+		double seconds = ClockT::DiffSeconds(_epoch, now);
+		return seconds > 0 ? (uint64_t)(seconds * 1000000.0) : 0;
+	}
+
+	template <class ClockT, class UpdateT>
+	uint64_t BasicAtomicTokenBucket<ClockT, UpdateT>::Replenish(uint64_t state, uint64_t now_ticks) const
+	{
+		uint32_t tokens = StateTokens(state);
+		uint32_t now32 = (uint32_t)now_ticks;
+
+		// get time passed since last update.
+		// if bucket was idle long enough for the 32 bit time to wrap, use the full last touch time instead.
+		// this must be checked first, as a wrapped 32 bit difference may look like time went backwards.
+		uint64_t elapsed;
+		uint64_t last_touch = _last_touch.load(std::memory_order_relaxed);
+		if (now_ticks > last_touch && now_ticks - last_touch >= 0x80000000ull)
+		{
+			elapsed = now_ticks - last_touch;
+		}
+		// otherwise, if another thread already moved time past us, nothing to do
+		else
+		{
+			int32_t diff = (int32_t)(now32 - StateTicks(state));
+			if (diff <= 0)
+				return state;
+			elapsed = (uint64_t)diff;
+		}
+
+		// already full? just move time forward
+		if (tokens >= _max_units)
+			return PackState(tokens, now32);
+
+		// calc gain and limit to max
+		double gain = (double)elapsed * _units_per_tick;
+		if (gain >= (double)(_max_units - tokens))
+			return PackState(_max_units, now32);
+
+		// not enough time passed to gain a single unit? keep time as-is so we won't lose it
+		uint32_t units = (uint32_t)gain;
+		if (units == 0)
+			return state;
+
+		// only advance time by the ticks we actually used, so fractions are carried to the next update
+		uint64_t used_ticks = (uint64_t)std::ceil((double)units / _units_per_tick);
+		if (used_ticks > elapsed)
+			used_ticks = elapsed;
+		return PackState(tokens + units, StateTicks(state) + (uint32_t)used_ticks);
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicAtomicTokenBucket<ClockT, UpdateT>::Update()
+	{
+		uint64_t now_ticks = NowTicks();
+		uint64_t state = _state.load(std::memory_order_acquire);
+		while (true)
+		{
+			uint64_t next = Replenish(state, now_ticks);
+			if (next == state || _state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_acquire))
+				break;
+		}
+		_last_touch.store(now_ticks, std::memory_order_relaxed);
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicAtomicTokenBucket<ClockT, UpdateT>::Restore(double amount)
+	{
+		uint64_t units = ToUnits(amount);
+		uint64_t state = _state.load(std::memory_order_acquire);
+		while (true)
+		{
+			// add tokens and make sure didn't pass max
+			uint64_t tokens = StateTokens(state) + units;
+			if (tokens > _max_units)
+				tokens = _max_units;
+
+			uint64_t next = PackState((uint32_t)tokens, StateTicks(state));
+			if (next == state || _state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_acquire))
+				return;
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	double BasicAtomicTokenBucket<ClockT, UpdateT>::Take(double max_amount)
+	{
+		uint32_t units = ToUnits(max_amount);
+
+		// read time only if we need to replenish
+		bool auto_update = UpdateT::Auto();
+		uint64_t now_ticks = auto_update ? NowTicks() : 0;
+
+		uint64_t state = _state.load(std::memory_order_acquire);
+		while (true)
+		{
+			// replenish tokens and take as much as we can
+			uint64_t current = auto_update ? Replenish(state, now_ticks) : state;
+			uint32_t tokens = StateTokens(current);
+			uint32_t taken = tokens < units ? tokens : units;
+
+			uint64_t next = PackState(tokens - taken, StateTicks(current));
+			if (next == state || _state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				if (auto_update) _last_touch.store(now_ticks, std::memory_order_relaxed);
+				_total_consumption.fetch_add(taken, std::memory_order_relaxed);
+				return (double)taken / _units_per_token;
+			}
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicAtomicTokenBucket<ClockT, UpdateT>::Return(double amount)
+	{
+		uint32_t units = ToUnits(amount);
+		uint64_t state = _state.load(std::memory_order_acquire);
+		while (true)
+		{
+			// add tokens (limited to max), and remove only what was actually added from consumption
+			uint32_t tokens = StateTokens(state);
+			uint32_t returned = tokens < _max_units ? _max_units - tokens : 0;
+			if (returned > units)
+				returned = units;
+			if (returned == 0)
+				return;
+
+			uint64_t next = PackState(tokens + returned, StateTicks(state));
+			if (_state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				_total_consumption.fetch_sub(returned, std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	bool BasicAtomicTokenBucket<ClockT, UpdateT>::Consume(double amount)
+	{
+		return Consume(amount, true);
+	}
+
+	template <class ClockT, class UpdateT>
+	bool BasicAtomicTokenBucket<ClockT, UpdateT>::Consume(double amount, bool notify)
+	{
+		// only read the clock if we need it
+		return Consume(amount, UpdateT::Auto() ? ClockT::Now() : typename ClockT::TimePoint(), notify);
+	}
+
+	template <class ClockT, class UpdateT>
+	bool BasicAtomicTokenBucket<ClockT, UpdateT>::Consume(double amount, const typename ClockT::TimePoint& now, bool notify)
+	{
+		uint32_t units = ToUnits(amount);
+
+		// get time only if we need to replenish
+		bool auto_update = UpdateT::Auto();
+		uint64_t now_ticks = auto_update ? TicksAt(now) : 0;
+
+		uint64_t state = _state.load(std::memory_order_acquire);
+		while (true)
+		{
+			// replenish tokens before consuming
+			uint64_t current = auto_update ? Replenish(state, now_ticks) : state;
+			uint32_t tokens = StateTokens(current);
+
+			// if got enough to consume reduce tokens and return true
+			if (tokens >= units)
+			{
+				uint64_t next = PackState(tokens - units, StateTicks(current));
+				if (_state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					if (auto_update) _last_touch.store(now_ticks, std::memory_order_relaxed);
+					_total_consumption.fetch_add(units, std::memory_order_relaxed);
+					return true;
+				}
+			}
+			// if don't have enough zero tokens and return false
+			else
+			{
+				uint64_t next = PackState(0, StateTicks(current));
+				if (_state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					if (auto_update) _last_touch.store(now_ticks, std::memory_order_relaxed);
+					_total_consumption.fetch_add(tokens, std::memory_order_relaxed);
+
+					// only the thread that won the CAS gets here, so callback is invoked once per failed consume
+					if (notify && OnBucketExhausted)
+					{
+						OnBucketExhausted(*this);
+					}
+					return false;
+				}
+			}
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	double BasicAtomicTokenBucket<ClockT, UpdateT>::Count() const
+	{
+		uint64_t state = _state.load(std::memory_order_acquire);
+
+		// calc replenished tokens without writing them
+		if (UpdateT::Auto())
+			state = Replenish(state, NowTicks());
+
+		return (double)StateTokens(state) / _units_per_token;
+	}
+
+	template <class ClockT, class UpdateT>
+	double BasicAtomicTokenBucket<ClockT, UpdateT>::TotalConsumed() const
+	{
+		return (double)_total_consumption.load(std::memory_order_relaxed) / _units_per_token;
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicAtomicTokenBucket<ClockT, UpdateT>::Reset()
+	{
+		uint32_t units = ToUnits(_starting_count);
+		uint64_t state = _state.load(std::memory_order_acquire);
+		while (!_state.compare_exchange_weak(state, PackState(units, StateTicks(state)), std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	bool BasicAtomicTokenBucket<ClockT, UpdateT>::Test(double amount) const
+	{
+		return StateTokens(_state.load(std::memory_order_acquire)) >= ToUnits(amount);
+	}
+
+	// the default bucket is compiled once, in AtomicTokenBucket.cpp
+	extern template class BasicAtomicTokenBucket<AccurateClock>;
+}
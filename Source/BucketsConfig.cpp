@@ -0,0 +1,277 @@
+#include "BucketsConfig.h"
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+
+namespace BucketAlerts
+{
+	// the record layout must be the same in every build that reads binary configs
+	static_assert(sizeof(BucketDefinition) == 40, "unexpected bucket definition layout");
+
+	// binary config header. followed by callback names (each is uint32 length + chars), then the definitions records.
+	struct BinaryHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t ByteOrder;
+		uint32_t RecordSize;
+		uint32_t NamesCount;
+		uint32_t NamesSize;
+		uint32_t BucketsCount;
+		uint64_t Checksum;
+	};
+	static_assert(sizeof(BinaryHeader) == 40, "unexpected binary header layout");
+
+	// magic bytes at the beginning of binary configs
+	static const char BinaryMagic[8] = { 'B', 'K', 'T', 'C', 'O', 'N', 'F', 'G' };
+
+	// FNV-1a over the data that follows the header
+	static uint64_t BinaryChecksum(const char* data, size_t size)
+	{
+		uint64_t ret = 0xcbf29ce484222325ULL;
+		for (size_t i = 0; i < size; ++i)
+		{
+			ret ^= (unsigned char)data[i];
+			ret *= 0x100000001b3ULL;
+		}
+		return ret;
+	}
+
+	// read a whole file in one go
+	static bool ReadFile(const char* path, std::string& out)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+		out.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read(&out[0], (std::streamsize)out.size());
+		return (bool)file;
+	}
+
+	// parse an unsigned id token
+	static bool ParseId(const std::string& token, unsigned int& out)
+	{
+		if (token.empty() || token[0] < '0' || token[0] > '9')
+			return false;
+		char* end;
+		errno = 0;
+		unsigned long long value = std::strtoull(token.c_str(), &end, 10);
+		if (*end || errno || value > 0xFFFFFFFFull)
+			return false;
+		out = (unsigned int)value;
+		return true;
+	}
+
+	// parse a non-negative number token
+	static bool ParseNumber(const std::string& token, double& out)
+	{
+		char* end;
+		out = std::strtod(token.c_str(), &end);
+		return !token.empty() && !*end && out >= 0 && out <= 1e300;
+	}
+
+	uint32_t BucketsConfig::CallbackIndex(const std::string& name)
+	{
+		std::unordered_map<std::string, uint32_t>::iterator it = _names_index.find(name);
+		if (it != _names_index.end())
+			return it->second;
+		uint32_t ret = (uint32_t)CallbackNames.size();
+		CallbackNames.push_back(name);
+		_names_index[name] = ret;
+		return ret;
+	}
+
+	void BucketsConfig::Add(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const char* callback)
+	{
+		BucketDefinition definition = {};
+		definition.Category = cat_id;
+		definition.Bucket = bucket_id;
+		definition.StartingTokens = starting_tokens;
+		definition.MaxTokens = max_tokens;
+		definition.ReplenishRate = replenish_rate;
+		definition.Callback = callback ? CallbackIndex(callback) : NoCallback;
+		Buckets.push_back(definition);
+	}
+
+	bool BucketsConfig::ParseText(const std::string& text)
+	{
+		Clear();
+		std::istringstream lines(text);
+		std::string line;
+		std::vector<std::string> tokens;
+		for (size_t line_number = 1; std::getline(lines, line); ++line_number)
+		{
+			// split to tokens (skip empty lines and comments)
+			std::istringstream words(line);
+			tokens.assign(std::istream_iterator<std::string>(words), std::istream_iterator<std::string>());
+			if (tokens.empty() || tokens[0][0] == '#')
+				continue;
+
+			// parse definition
+			CategoryId cat_id;
+			BucketId bucket_id;
+			double starting_tokens, max_tokens, replenish_rate;
+			if ((tokens.size() != 5 && tokens.size() != 6) ||
+				!ParseId(tokens[0], cat_id) || !ParseId(tokens[1], bucket_id) ||
+				!ParseNumber(tokens[2], starting_tokens) || !ParseNumber(tokens[3], max_tokens) || !ParseNumber(tokens[4], replenish_rate))
+			{
+				Clear();
+				Error = "line " + std::to_string(line_number) + ": expected 'category bucket starting max rate [callback]'";
+				return false;
+			}
+			Add(cat_id, bucket_id, starting_tokens, max_tokens, replenish_rate, tokens.size() == 6 ? tokens[5].c_str() : nullptr);
+		}
+		return true;
+	}
+
+	bool BucketsConfig::LoadText(const char* path)
+	{
+		std::string text;
+		if (!ReadFile(path, text))
+		{
+			Clear();
+			Error = std::string("can't read ") + path;
+			return false;
+		}
+		return ParseText(text);
+	}
+
+	bool BucketsConfig::ParseBinary(const void* data, size_t size)
+	{
+		Clear();
+		const char* bytes = (const char*)data;
+
+		// validate header and sections sizes
+		BinaryHeader header;
+		if (size < sizeof(header))
+		{
+			Error = "binary config is too short";
+			return false;
+		}
+		std::memcpy(&header, bytes, sizeof(header));
+		if (std::memcmp(header.Magic, BinaryMagic, sizeof(BinaryMagic)) != 0 ||
+			header.Version != BinaryVersion ||
+			header.ByteOrder != 0x01020304 ||
+			header.RecordSize != sizeof(BucketDefinition))
+		{
+			Error = "not a binary config, or compiled by an incompatible version or machine";
+			return false;
+		}
+		if ((uint64_t)sizeof(header) + header.NamesSize + (uint64_t)header.BucketsCount * sizeof(BucketDefinition) != size ||
+			header.Checksum != BinaryChecksum(bytes + sizeof(header), size - sizeof(header)))
+		{
+			Error = "binary config is corrupted";
+			return false;
+		}
+
+		// read callback names (every name takes at least its length, so check count before reserving for it)
+		if (header.NamesCount > header.NamesSize / sizeof(uint32_t))
+		{
+			Error = "binary config is corrupted";
+			return false;
+		}
+		const char* names = bytes + sizeof(header);
+		const char* names_end = names + header.NamesSize;
+		CallbackNames.reserve(header.NamesCount);
+		for (uint32_t i = 0; i < header.NamesCount; ++i)
+		{
+			uint32_t length;
+			if (names_end - names < (ptrdiff_t)sizeof(length))
+				break;
+			std::memcpy(&length, names, sizeof(length));
+			names += sizeof(length);
+			if ((size_t)(names_end - names) < length)
+				break;
+			CallbackNames.push_back(std::string(names, length));
+			_names_index[CallbackNames.back()] = i;
+			names += length;
+		}
+		if (CallbackNames.size() != header.NamesCount || names != names_end)
+		{
+			Clear();
+			Error = "binary config is corrupted";
+			return false;
+		}
+
+		// read definitions in one copy, then make sure they only refer to existing callbacks
+		Buckets.resize(header.BucketsCount);
+		if (header.BucketsCount)
+			std::memcpy(&Buckets[0], names_end, (size_t)header.BucketsCount * sizeof(BucketDefinition));
+		for (const BucketDefinition& definition : Buckets)
+		{
+			if (definition.Callback != NoCallback && definition.Callback >= header.NamesCount)
+			{
+				Clear();
+				Error = "binary config is corrupted";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool BucketsConfig::LoadBinary(const char* path)
+	{
+		std::string data;
+		if (!ReadFile(path, data))
+		{
+			Clear();
+			Error = std::string("can't read ") + path;
+			return false;
+		}
+		return ParseBinary(data.data(), data.size());
+	}
+
+	void BucketsConfig::ToBinary(std::vector<char>& out) const
+	{
+		// header (checksum is set last)
+		BinaryHeader header = {};
+		std::memcpy(header.Magic, BinaryMagic, sizeof(BinaryMagic));
+		header.Version = BinaryVersion;
+		header.ByteOrder = 0x01020304;
+		header.RecordSize = sizeof(BucketDefinition);
+		header.NamesCount = (uint32_t)CallbackNames.size();
+		header.BucketsCount = (uint32_t)Buckets.size();
+		for (const std::string& name : CallbackNames)
+			header.NamesSize += (uint32_t)(sizeof(uint32_t) + name.size());
+		out.resize(sizeof(header) + header.NamesSize + Buckets.size() * sizeof(BucketDefinition));
+
+		// callback names
+		char* pos = out.data() + sizeof(header);
+		for (const std::string& name : CallbackNames)
+		{
+			uint32_t length = (uint32_t)name.size();
+			std::memcpy(pos, &length, sizeof(length));
+			std::memcpy(pos + sizeof(length), name.data(), length);
+			pos += sizeof(length) + length;
+		}
+
+		// definitions
+		if (!Buckets.empty())
+			std::memcpy(pos, Buckets.data(), Buckets.size() * sizeof(BucketDefinition));
+
+		header.Checksum = BinaryChecksum(out.data() + sizeof(header), out.size() - sizeof(header));
+		std::memcpy(out.data(), &header, sizeof(header));
+	}
+
+	bool BucketsConfig::SaveBinary(const char* path) const
+	{
+		std::vector<char> data;
+		ToBinary(data);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), (std::streamsize)data.size());
+		return (bool)file;
+	}
+
+	void BucketsConfig::Clear()
+	{
+		Buckets.clear();
+		CallbackNames.clear();
+		_names_index.clear();
+		Error.clear();
+	}
+}
@@ -0,0 +1,285 @@
+/*!
+ * \file	Source\BucketsConfig.h.
+ *
+ * \brief	Declares buckets definitions that can be loaded from text or compact binary files, and a callbacks registry to resolve their callbacks.
+ */
+#pragma once
+#include "Defs.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \struct	BucketDefinition
+	 *
+	 * \brief	Params to create a single bucket with.
+	 * 			This is also the record layout of the binary config format, so binary configs load with a single copy.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	struct BucketDefinition
+	{
+		/*! \brief	Identifier for the category. */
+		CategoryId Category;
+
+		/*! \brief	Identifier for the bucket. */
+		BucketId Bucket;
+
+		/*! \brief	Tokens to start with. */
+		double StartingTokens;
+
+		/*! \brief	Max tokens the bucket can hold. */
+		double MaxTokens;
+
+		/*! \brief	How many tokens are added per second. */
+		double ReplenishRate;
+
+		/*! \brief	Index of the callback name in config callback names (or BucketsConfig::NoCallback). */
+		uint32_t Callback;
+
+		/*! \brief	Unused (keeps the record size fixed). */
+		uint32_t Reserved;
+	};
+
+	/*!
+	 * \class	BucketsConfig
+	 *
+	 * \brief	A list of buckets definitions, with their callbacks by name.
+	 * 			Definitions can be parsed from a text config, or loaded from a precompiled binary form
+	 * 			(see SaveBinary()), and then created in an alerts manager at once with CreateBuckets().
+	 *
+	 * 			Text format is one bucket per line:
+	 * 				category_id bucket_id starting_tokens max_tokens replenish_rate [callback_name]
+	 * 			Empty lines and lines starting with '#' are ignored.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class BucketsConfig
+	{
+	public:
+
+		/*! \brief	Callback index for buckets without callback. */
+		static const uint32_t NoCallback = 0xFFFFFFFFu;
+
+		/*! \brief	Binary config format version. */
+		static const uint32_t BinaryVersion = 1;
+
+		/*! \brief	Buckets definitions. */
+		std::vector<BucketDefinition> Buckets;
+
+		/*! \brief	Callback names, that definitions refer to by index. */
+		std::vector<std::string> CallbackNames;
+
+		/*! \brief	Description of the last load error (empty if last load succeeded). */
+		std::string Error;
+
+		/*!
+		 * \fn	void BucketsConfig::Add(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const char* callback = nullptr);
+		 *
+		 * \brief	Add a bucket definition.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id		   	Identifier for the category.
+		 * \param	bucket_id	   	Identifier for the bucket.
+		 * \param	starting_tokens	The starting tokens.
+		 * \param	max_tokens	   	The maximum tokens.
+		 * \param	replenish_rate 	The replenish rate.
+		 * \param	callback	   	(Optional) Callback name, or null for no callback.
+		 */
+		void Add(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, const char* callback = nullptr);
+
+		/*!
+		 * \fn	bool BucketsConfig::ParseText(const std::string& text);
+		 *
+		 * \brief	Replace definitions with a text config.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	text	Config text.
+		 *
+		 * \return	True on success, false on error (see Error; config is left empty).
+		 */
+		bool ParseText(const std::string& text);
+
+		/*!
+		 * \fn	bool BucketsConfig::LoadText(const char* path);
+		 *
+		 * \brief	Replace definitions with a text config file.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	path	File path.
+		 *
+		 * \return	True on success, false on error (see Error).
+		 */
+		bool LoadText(const char* path);
+
+		/*!
+		 * \fn	bool BucketsConfig::ParseBinary(const void* data, size_t size);
+		 *
+		 * \brief	Replace definitions with a binary config from memory.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	data	Binary config.
+		 * \param	size	Binary config size, in bytes.
+		 *
+		 * \return	True on success, false on error (see Error; config is left empty).
+		 */
+		bool ParseBinary(const void* data, size_t size);
+
+		/*!
+		 * \fn	bool BucketsConfig::LoadBinary(const char* path);
+		 *
+		 * \brief	Replace definitions with a binary config file.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	path	File path.
+		 *
+		 * \return	True on success, false on error (see Error).
+		 */
+		bool LoadBinary(const char* path);
+
+		/*!
+		 * \fn	void BucketsConfig::ToBinary(std::vector<char>& out) const;
+		 *
+		 * \brief	Compile definitions into the binary config form.
+		 * 			Numbers are stored in native byte order, so binary configs should be compiled on the
+		 * 			same kind of machine that loads them (loading checks it).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param [out]	out	Binary config.
+		 */
+		void ToBinary(std::vector<char>& out) const;
+
+		/*!
+		 * \fn	bool BucketsConfig::SaveBinary(const char* path) const;
+		 *
+		 * \brief	Compile definitions into a binary config file.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	path	File path.
+		 *
+		 * \return	True on success.
+		 */
+		bool SaveBinary(const char* path) const;
+
+		/*!
+		 * \fn	void BucketsConfig::Clear();
+		 *
+		 * \brief	Remove all definitions and callback names.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Clear();
+
+	private:
+
+		// callback names indices, to share names between definitions while parsing
+		std::unordered_map<std::string, uint32_t> _names_index;
+
+		// get callback index by name (add it if new)
+		uint32_t CallbackIndex(const std::string& name);
+	};
+
+	/*!
+	 * \class	CallbacksRegistry
+	 *
+	 * \brief	A table of callbacks by name, to resolve the callbacks of buckets definitions.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class CallbackT>
+	class CallbacksRegistry
+	{
+	private:
+		std::unordered_map<std::string, CallbackT> _callbacks;
+
+	public:
+
+		/*!
+		 * \fn	void CallbacksRegistry::Register(const std::string& name, CallbackT callback)
+		 *
+		 * \brief	Register a callback by name (replaces existing callback with the same name).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	name		Callback name.
+		 * \param	callback	The callback.
+		 */
+		void Register(const std::string& name, CallbackT callback)
+		{
+			_callbacks[name] = callback;
+		}
+
+		/*!
+		 * \fn	bool CallbacksRegistry::Find(const std::string& name, CallbackT& out) const
+		 *
+		 * \brief	Get a callback by name.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	name	Callback name.
+		 * \param [out]	out 	Will be set to the callback, if found.
+		 *
+		 * \return	True if found.
+		 */
+		bool Find(const std::string& name, CallbackT& out) const
+		{
+			typename std::unordered_map<std::string, CallbackT>::const_iterator it = _callbacks.find(name);
+			if (it == _callbacks.end())
+				return false;
+			out = it->second;
+			return true;
+		}
+
+		/*!
+		 * \fn	bool CallbacksRegistry::Resolve(const std::vector<std::string>& names, std::vector<CallbackT>& out, std::string* missing = nullptr) const
+		 *
+		 * \brief	Get callbacks for a list of names (like config callback names), in the same order.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	names  	Callback names.
+		 * \param [out]	out	   	Will be set to the callbacks.
+		 * \param [out]	missing	(Optional) If not null and a name is not registered, will be set to that name.
+		 *
+		 * \return	True if all names are registered.
+		 */
+		bool Resolve(const std::vector<std::string>& names, std::vector<CallbackT>& out, std::string* missing = nullptr) const
+		{
+			out.resize(names.size());
+			for (size_t i = 0; i < names.size(); ++i)
+			{
+				if (!Find(names[i], out[i]))
+				{
+					if (missing) *missing = names[i];
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+}
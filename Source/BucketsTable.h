@@ -0,0 +1,617 @@
+/*!
+ * \file	Source\BucketsTable.h.
+ *
+ * \brief	Declares a flat open-addressing table of buckets.
+ */
+#pragma once
+#include "Defs.h"
+#include "Policies.h"
+#include "EpochDomain.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	BucketsTable
+	 *
+	 * \brief	A flat hash table of buckets, keyed by combined (category id, bucket id) key.
+	 * 			The table is a single open-addressing (linear probing) array of 8 bytes slots (hash tag
+	 * 			+ bucket index), while the buckets themselves are stored inline, next to their keys,
+	 * 			in pages that double in size (16, 32, 64...).
+	 * 			This means a lookup is one probe into a compact array + one access to the bucket,
+	 * 			and there's no heap allocation per bucket.
+	 * 			Since pages are never moved or freed (until the table is destroyed), bucket references
+	 * 			stay valid when the table grows, and even after Clear() or Remove() (bucket memory is reused).
+	 * 			Every bucket also has a generation counter that changes when its bucket is cleared or removed,
+	 * 			so cached references can detect that they no longer point to the bucket they had.
+	 * 			Note: this class is not thread safe by itself. The only exception is iterating buckets with
+	 * 			PublishedCount(), Used() and At() while a single writer modifies the table: entries are published
+	 * 			only after they're set, and removed entries can be retired (see Retire()) so their memory is
+	 * 			not reused while readers may still look at them.
+	 * 			The threading policy picks the type of these counters and flags (see Policies.h), so single
+	 * 			threaded tables don't use atomics at all.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class BucketT, class ThreadingT = MultiThreaded>
+	class BucketsTable
+	{
+	public:
+
+		/*! \brief	Type of the generation counters. */
+		typedef typename ThreadingT::template Atomic<uint32_t> GenerationCounter;
+
+		/*! \brief	How many buckets we store in the first page (every page after is twice the size of the previous). */
+		static const uint32_t FirstPageSize = 16;
+
+		/*! \brief	Index value for empty slots. */
+		static const uint32_t EmptyIndex = 0xFFFFFFFFu;
+
+		/*! \brief	Max pages count (enough for all bucket indices). */
+		static const uint32_t MaxPages = 28;
+
+	private:
+
+		// a slot in the open-addressing array
+		struct Slot
+		{
+			uint32_t Tag;
+			uint32_t Index;
+		};
+
+		// a bucket and its key, as stored in pages
+		struct Entry
+		{
+			BucketT Bucket;
+			BucketKey Key;
+			typename ThreadingT::template Atomic<uint32_t> Generation { 0 };
+			typename ThreadingT::template Atomic<bool> Used { false };
+		};
+
+		// a removed entry that readers may still look at, and the epoch it was removed at
+		struct Retired
+		{
+			uint32_t Index;
+			uint64_t Epoch;
+		};
+
+		// open-addressing slots (size is always power of 2)
+		std::vector<Slot> _slots;
+
+		// pages of entries (a fixed array, so concurrent readers can access pages while new ones are added)
+		std::unique_ptr<Entry[]> _pages[MaxPages];
+		uint32_t _pages_count = 0;
+
+		// how many entries were handed out (removed entries included).
+		// increased only after the new entry is set, so concurrent readers only see ready entries.
+		typename ThreadingT::template Atomic<uint32_t> _count { 0 };
+
+		// how many buckets are currently in use
+		uint32_t _size = 0;
+
+		// indices of removed entries, to reuse before handing out new ones
+		std::vector<uint32_t> _free;
+
+		// retired entries, that are not reused until readers are done with them (see Reclaim())
+		std::vector<Retired> _retired;
+
+		// total entries in all allocated pages
+		uint32_t _capacity = 0;
+
+		// get the index of the highest set bit
+		static inline uint32_t HighestBit(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long ret;
+			_BitScanReverse(&ret, value);
+			return (uint32_t)ret;
+#else
+			return 31 - (uint32_t)__builtin_clz(value);
+#endif
+		}
+
+		// get entry by index
+		inline Entry& EntryAt(uint32_t index)
+		{
+			uint32_t page = HighestBit(index / FirstPageSize + 1);
+			return _pages[page][index - ((1u << page) - 1) * FirstPageSize];
+		}
+
+		// get entry by index
+		inline const Entry& EntryAt(uint32_t index) const
+		{
+			uint32_t page = HighestBit(index / FirstPageSize + 1);
+			return _pages[page][index - ((1u << page) - 1) * FirstPageSize];
+		}
+
+		// allocate another page of entries
+		void AddPage()
+		{
+			uint32_t size = FirstPageSize << _pages_count;
+			_pages[_pages_count++].reset(new Entry[size]);
+			_capacity += size;
+		}
+
+		// get first slot to probe for a key hash
+		inline size_t FirstSlot(uint64_t hash) const
+		{
+			return (size_t)hash & (_slots.size() - 1);
+		}
+
+		// get slot tag from key hash
+		static inline uint32_t HashTag(uint64_t hash)
+		{
+			return (uint32_t)(hash >> 32);
+		}
+
+		// rebuild slots array with a new capacity
+		void Rehash(size_t capacity)
+		{
+			std::vector<Slot> slots(capacity, Slot { 0, EmptyIndex });
+			_slots.swap(slots);
+			uint32_t count = _count.load(std::memory_order_relaxed);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				if (!EntryAt(i).Used.load(std::memory_order_relaxed))
+					continue;
+				uint64_t hash = HashBucketKey(EntryAt(i).Key);
+				size_t pos = FirstSlot(hash);
+				while (_slots[pos].Index != EmptyIndex)
+					pos = (pos + 1) & (_slots.size() - 1);
+				_slots[pos].Tag = HashTag(hash);
+				_slots[pos].Index = i;
+			}
+		}
+
+		// remove a bucket from slots and mark its entry unused (doesn't free the entry). returns entry index, or EmptyIndex if not found.
+		uint32_t Unlink(BucketKey key)
+		{
+			// find slot
+			uint64_t hash = HashBucketKey(key);
+			uint32_t tag = HashTag(hash);
+			size_t mask = _slots.size() - 1;
+			size_t hole = FirstSlot(hash);
+			for (; ; hole = (hole + 1) & mask)
+			{
+				if (_slots[hole].Index == EmptyIndex)
+					return EmptyIndex;
+				if (_slots[hole].Tag == tag && EntryAt(_slots[hole].Index).Key == key)
+					break;
+			}
+
+			// mark entry unused
+			uint32_t index = _slots[hole].Index;
+			Entry& entry = EntryAt(index);
+			entry.Generation.fetch_add(1, std::memory_order_release);
+			entry.Used.store(false, std::memory_order_release);
+			_size--;
+
+			// shift back following slots that are allowed to be in the hole (their probe passes through it)
+			for (size_t next = (hole + 1) & mask; _slots[next].Index != EmptyIndex; next = (next + 1) & mask)
+			{
+				size_t home = FirstSlot(HashBucketKey(EntryAt(_slots[next].Index).Key));
+				if (((next - home) & mask) >= ((next - hole) & mask))
+				{
+					_slots[hole] = _slots[next];
+					hole = next;
+				}
+			}
+			_slots[hole].Index = EmptyIndex;
+			return index;
+		}
+
+	public:
+
+		/*!
+		 * \fn	BucketsTable::BucketsTable()
+		 *
+		 * \brief	Default constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		BucketsTable()
+		{
+			Rehash(16);
+		}
+
+		/*!
+		 * \fn	BucketT* BucketsTable::Find(BucketKey key)
+		 *
+		 * \brief	Find a bucket by key.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	key  	The combined key.
+		 * \param [out]	index	(Optional) If not null and bucket is found, will be set to bucket index.
+		 *
+		 * \return	Pointer to the bucket, or nullptr if not found.
+		 */
+		BucketT* Find(BucketKey key, uint32_t* index = nullptr)
+		{
+			uint64_t hash = HashBucketKey(key);
+			uint32_t tag = HashTag(hash);
+			size_t mask = _slots.size() - 1;
+			for (size_t pos = FirstSlot(hash); ; pos = (pos + 1) & mask)
+			{
+				const Slot& slot = _slots[pos];
+				if (slot.Index == EmptyIndex)
+					return nullptr;
+				if (slot.Tag == tag)
+				{
+					Entry& entry = EntryAt(slot.Index);
+					if (entry.Key == key)
+					{
+						if (index) *index = slot.Index;
+						return &entry.Bucket;
+					}
+				}
+			}
+		}
+
+		/*!
+		 * \fn	BucketT& BucketsTable::GetOrCreate(BucketKey key, bool& created, uint32_t* index = nullptr)
+		 *
+		 * \brief	Get a bucket by key, or create a new default bucket if not found.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	key	   	The combined key.
+		 * \param [out]	created	Will be set to true if a new bucket was created.
+		 * \param [out]	index  	(Optional) If not null, will be set to bucket index.
+		 *
+		 * \return	The bucket.
+		 */
+		BucketT& GetOrCreate(BucketKey key, bool& created, uint32_t* index = nullptr)
+		{
+			// grow if needed (keep load factor under 3/4)
+			if ((size_t)(_size + 1) * 4 > _slots.size() * 3)
+				Rehash(_slots.size() * 2);
+
+			// find slot
+			uint64_t hash = HashBucketKey(key);
+			uint32_t tag = HashTag(hash);
+			size_t mask = _slots.size() - 1;
+			size_t pos = FirstSlot(hash);
+			for (; _slots[pos].Index != EmptyIndex; pos = (pos + 1) & mask)
+			{
+				if (_slots[pos].Tag == tag)
+				{
+					Entry& entry = EntryAt(_slots[pos].Index);
+					if (entry.Key == key)
+					{
+						created = false;
+						if (index) *index = _slots[pos].Index;
+						return entry.Bucket;
+					}
+				}
+			}
+
+			// reuse a removed entry, or allocate a new page if needed
+			uint32_t new_index;
+			bool appended = false;
+			if (!_free.empty())
+			{
+				new_index = _free.back();
+				_free.pop_back();
+			}
+			else
+			{
+				new_index = _count.load(std::memory_order_relaxed);
+				if (new_index >= _capacity)
+					AddPage();
+				appended = true;
+			}
+			_size++;
+
+			// set slot
+			_slots[pos].Tag = tag;
+			_slots[pos].Index = new_index;
+
+			// set key and reset bucket (page memory may be reused after Clear())
+			Entry& entry = EntryAt(new_index);
+			entry.Key = key;
+			entry.Bucket = BucketT();
+			entry.Used.store(true, std::memory_order_release);
+			if (appended)
+				_count.store(new_index + 1, std::memory_order_release);
+			created = true;
+			if (index) *index = new_index;
+			return entry.Bucket;
+		}
+
+		/*!
+		 * \fn	bool BucketsTable::Remove(BucketKey key)
+		 *
+		 * \brief	Remove a bucket by key.
+		 * 			The bucket generation is increased and its entry is reused by the next new bucket.
+		 * 			Slots that follow it are shifted back, so lookups never need tombstones.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	key	The combined key.
+		 *
+		 * \return	True if bucket was found and removed.
+		 */
+		bool Remove(BucketKey key)
+		{
+			uint32_t index = Unlink(key);
+			if (index == EmptyIndex)
+				return false;
+
+			// free entry
+			EntryAt(index).Bucket = BucketT();
+			_free.push_back(index);
+			return true;
+		}
+
+		/*!
+		 * \fn	bool BucketsTable::Retire(BucketKey key, EpochDomain& epochs)
+		 *
+		 * \brief	Remove a bucket by key, but keep its entry as is until readers that may still look at it
+		 * 			are done (see Reclaim()). Use instead of Remove() when iterating concurrently.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	key   	The combined key.
+		 * \param	epochs	Epochs of the readers of this table.
+		 *
+		 * \return	True if bucket was found and removed.
+		 */
+		bool Retire(BucketKey key, EpochDomain& epochs)
+		{
+			uint32_t index = Unlink(key);
+			if (index == EmptyIndex)
+				return false;
+
+			// advance epoch only after entry is unlinked, so readers that enter from now on won't see it
+			Retired retired = { index, epochs.Advance() };
+			_retired.push_back(retired);
+			return true;
+		}
+
+		/*!
+		 * \fn	void BucketsTable::RetireAll(EpochDomain& epochs)
+		 *
+		 * \brief	Remove all buckets, but keep their entries as is until readers that may still look at them
+		 * 			are done (see Reclaim()). Use instead of Clear() when iterating concurrently.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	epochs	Epochs of the readers of this table.
+		 */
+		void RetireAll(EpochDomain& epochs)
+		{
+			// unlink all buckets
+			uint32_t count = _count.load(std::memory_order_relaxed);
+			size_t first = _retired.size();
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				Entry& entry = EntryAt(i);
+				if (!entry.Used.load(std::memory_order_relaxed))
+					continue;
+				entry.Generation.fetch_add(1, std::memory_order_release);
+				entry.Used.store(false, std::memory_order_release);
+				_retired.push_back(Retired { i, 0 });
+			}
+			for (size_t i = 0; i < _slots.size(); ++i)
+				_slots[i].Index = EmptyIndex;
+			_size = 0;
+
+			// advance epoch only after entries are unlinked, so readers that enter from now on won't see them
+			uint64_t epoch = epochs.Advance();
+			for (size_t i = first; i < _retired.size(); ++i)
+				_retired[i].Epoch = epoch;
+		}
+
+		/*!
+		 * \fn	void BucketsTable::Reclaim(const EpochDomain& epochs)
+		 *
+		 * \brief	Free retired entries that no reader can see anymore, so new buckets can reuse them.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	epochs	Epochs of the readers of this table.
+		 */
+		void Reclaim(const EpochDomain& epochs)
+		{
+			if (_retired.empty())
+				return;
+
+			uint64_t safe = epochs.SafeEpoch();
+			size_t kept = 0;
+			for (size_t i = 0; i < _retired.size(); ++i)
+			{
+				if (_retired[i].Epoch < safe)
+				{
+					EntryAt(_retired[i].Index).Bucket = BucketT();
+					_free.push_back(_retired[i].Index);
+				}
+				else
+				{
+					_retired[kept++] = _retired[i];
+				}
+			}
+			_retired.resize(kept);
+		}
+
+		/*!
+		 * \fn	BucketT& BucketsTable::At(uint32_t index)
+		 *
+		 * \brief	Get bucket by its index in table.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	index	Bucket index (between 0 and Count()).
+		 *
+		 * \return	The bucket.
+		 */
+		inline BucketT& At(uint32_t index)
+		{
+			return EntryAt(index).Bucket;
+		}
+
+		/*!
+		 * \fn	BucketKey BucketsTable::KeyAt(uint32_t index) const
+		 *
+		 * \brief	Get the key of a bucket by its index in table.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	index	Bucket index (between 0 and Count()).
+		 *
+		 * \return	The bucket key.
+		 */
+		inline BucketKey KeyAt(uint32_t index) const
+		{
+			return EntryAt(index).Key;
+		}
+
+		/*!
+		 * \fn	const GenerationCounter& BucketsTable::GenerationAt(uint32_t index) const
+		 *
+		 * \brief	Get the generation counter of a bucket by its index in table.
+		 * 			The counter changes whenever the bucket at this index is cleared.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	index	Bucket index (between 0 and Count()).
+		 *
+		 * \return	The bucket generation counter.
+		 */
+		inline const GenerationCounter& GenerationAt(uint32_t index) const
+		{
+			return EntryAt(index).Generation;
+		}
+
+		/*!
+		 * \fn	inline bool BucketsTable::Used(uint32_t index) const
+		 *
+		 * \brief	Check if a bucket index holds a bucket, or was removed.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	index	Bucket index (between 0 and Count()).
+		 *
+		 * \return	True if index holds a bucket.
+		 */
+		inline bool Used(uint32_t index) const
+		{
+			return EntryAt(index).Used.load(std::memory_order_acquire);
+		}
+
+		/*!
+		 * \fn	uint32_t BucketsTable::Count() const
+		 *
+		 * \brief	Get how many bucket indices are in use, to iterate buckets with At().
+		 * 			If buckets were removed, some of the indices may be free (see Used()).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Buckets indices count.
+		 */
+		inline uint32_t Count() const
+		{
+			return _count.load(std::memory_order_relaxed);
+		}
+
+		/*!
+		 * \fn	uint32_t BucketsTable::PublishedCount() const
+		 *
+		 * \brief	Like Count(), but safe to call while another thread adds buckets: all the entries below
+		 * 			the returned count are ready to read (with Used() and At()).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Buckets indices count.
+		 */
+		inline uint32_t PublishedCount() const
+		{
+			return _count.load(std::memory_order_acquire);
+		}
+
+		/*!
+		 * \fn	uint32_t BucketsTable::Size() const
+		 *
+		 * \brief	Get how many buckets are in table.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Buckets count.
+		 */
+		inline uint32_t Size() const
+		{
+			return _size;
+		}
+
+		/*!
+		 * \fn	void BucketsTable::Reserve(size_t count)
+		 *
+		 * \brief	Reserve room for a given number of buckets, so the table won't grow while filling it.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	count	Number of buckets to reserve room for.
+		 */
+		void Reserve(size_t count)
+		{
+			size_t capacity = _slots.size();
+			while (count * 4 > capacity * 3)
+				capacity *= 2;
+			if (capacity != _slots.size())
+				Rehash(capacity);
+			while (_capacity < count)
+				AddPage();
+		}
+
+		/*!
+		 * \fn	void BucketsTable::Clear()
+		 *
+		 * \brief	Remove all buckets.
+		 * 			Pages memory is kept and reused for new buckets, and the generation of every
+		 * 			removed bucket is increased. Entries are not retired, so wait for concurrent readers
+		 * 			before adding new buckets (see EpochDomain::Synchronize()).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Clear()
+		{
+			uint32_t count = _count.load(std::memory_order_relaxed);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				Entry& entry = EntryAt(i);
+				if (entry.Used.load(std::memory_order_relaxed))
+					entry.Generation.fetch_add(1, std::memory_order_release);
+				entry.Used.store(false, std::memory_order_release);
+			}
+			_count.store(0, std::memory_order_release);
+			_size = 0;
+			_free.clear();
+			_retired.clear();
+			for (size_t i = 0; i < _slots.size(); ++i)
+				_slots[i].Index = EmptyIndex;
+		}
+	};
+}
@@ -0,0 +1,51 @@
+#include "Clock.h"
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <time.h>
+#endif
+
+namespace BucketAlerts
+{
+	std::atomic<double> TscClock::_seconds_per_tick(0);
+	std::atomic<int64_t> VirtualClock::_now(0);
+
+	CoarseClock::TimePoint CoarseClock::Now() noexcept
+	{
+#if defined(_WIN32)
+		return (TimePoint)GetTickCount64() * 1000000;
+#elif defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+		return (TimePoint)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+		return (TimePoint)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	double TscClock::Calibrate() noexcept
+	{
+#if defined(BUCKET_ALERTS_HAS_TSC)
+		// measure counter ticks over a short period of steady time
+		auto start_time = std::chrono::steady_clock::now();
+		TimePoint start_ticks = Now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		auto end_time = std::chrono::steady_clock::now();
+		TimePoint end_ticks = Now();
+
+		double seconds = std::chrono::duration<double>(end_time - start_time).count();
+		double ret = end_ticks > start_ticks ? seconds / (double)(end_ticks - start_ticks) : 1e-9;
+#else
+		// fallback uses nanoseconds
+		double ret = 1e-9;
+#endif
+
+		// several threads may calibrate at the same time, that's fine, they all get similar results
+		_seconds_per_tick.store(ret, std::memory_order_relaxed);
+		return ret;
+	}
+}
@@ -1,11 +1,23 @@
 /*!
  * \file	Source\Clock.h.
  *
- * \brief	Provide an API to get accurate time.
+ * \brief	Provide clocks to measure time with.
+ * 			Buckets and managers are templates that take a clock as a policy. A clock needs to provide
+ * 			a TimePoint type, a static Now() method, and a static DiffSeconds(prev, now) method.
  */
 
 #pragma once
 #include <chrono>
+#include <atomic>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define BUCKET_ALERTS_HAS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BUCKET_ALERTS_HAS_TSC
+#endif
 
 namespace BucketAlerts
 {
@@ -53,7 +65,216 @@ namespace BucketAlerts
 		 */
 		static double DiffSeconds(const TimePoint& prev_t, const TimePoint& now_t) noexcept
 		{
-			return now_t == prev_t ? 0.0 : (double)((now_t - prev_t).count()) / 1000000000ULL;
+			return now_t == prev_t ? 0.0 : std::chrono::duration<double>(now_t - prev_t).count();
+		}
+	};
+
+	/*!
+	 * \class	CoarseClock
+	 *
+	 * \brief	A cheap monotonic clock with low resolution (usually 1-15 milliseconds, depending on OS).
+	 * 			Uses CLOCK_MONOTONIC_COARSE on Linux and GetTickCount64 on Windows, which are much
+	 * 			cheaper to read than the accurate clock. Use it when consuming a lot and you don't mind
+	 * 			buckets replenishing in small steps. Falls back to steady clock on other platforms.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class CoarseClock
+	{
+	public:
+		/*! \brief	Time point, in nanoseconds. */
+		typedef int64_t TimePoint;
+
+		/*!
+		 * \fn	static TimePoint CoarseClock::Now() noexcept;
+		 *
+		 * \brief	Gets coarse time now.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	A TimePoint.
+		 */
+		static TimePoint Now() noexcept;
+
+		/*!
+		 * \fn	static double CoarseClock::DiffSeconds(const TimePoint& prev_t, const TimePoint& now_t) noexcept
+		 *
+		 * \brief	Calc difference in seconds between two time points.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	prev_t	The previous time point.
+		 * \param	now_t 	The current time point.
+		 *
+		 * \return	Seconds between the time points.
+		 */
+		static double DiffSeconds(const TimePoint& prev_t, const TimePoint& now_t) noexcept
+		{
+			return (double)(now_t - prev_t) / 1000000000.0;
+		}
+	};
+
+	/*!
+	 * \class	TscClock
+	 *
+	 * \brief	A clock that reads the CPU time stamp counter, which is the cheapest way to get accurate time
+	 * 			on x86 / x64. The counter frequency is calibrated against the steady clock (takes ~10 milliseconds)
+	 * 			by Calibrate(), which metrics call when the program starts. If not calibrated yet, the first
+	 * 			DiffSeconds() call calibrates it.
+	 * 			Note: assumes an invariant TSC that is synchronized between cores (true on most modern CPUs).
+	 * 			On other architectures it falls back to the steady clock.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class TscClock
+	{
+	private:
+		// seconds per counter tick (0 until calibrated)
+		static std::atomic<double> _seconds_per_tick;
+
+	public:
+
+		/*! \brief	Time point, in counter ticks. */
+		typedef uint64_t TimePoint;
+
+		/*!
+		 * \fn	static double TscClock::Calibrate() noexcept
+		 *
+		 * \brief	Measure the counter frequency (sleeps ~10 milliseconds). Call ahead of time, so the first
+		 * 			DiffSeconds() call won't have to.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Seconds per counter tick.
+		 */
+		static double Calibrate() noexcept;
+
+		/*!
+		 * \fn	static TimePoint TscClock::Now() noexcept
+		 *
+		 * \brief	Gets counter value now.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	A TimePoint.
+		 */
+		static TimePoint Now() noexcept
+		{
+#if defined(BUCKET_ALERTS_HAS_TSC)
+			return (TimePoint)__rdtsc();
+#else
+			return (TimePoint)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+
+		/*!
+		 * \fn	static double TscClock::DiffSeconds(const TimePoint& prev_t, const TimePoint& now_t) noexcept
+		 *
+		 * \brief	Calc difference in seconds between two time points.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	prev_t	The previous time point.
+		 * \param	now_t 	The current time point.
+		 *
+		 * \return	Seconds between the time points.
+		 */
+		static double DiffSeconds(const TimePoint& prev_t, const TimePoint& now_t) noexcept
+		{
+			double seconds_per_tick = _seconds_per_tick.load(std::memory_order_relaxed);
+			if (seconds_per_tick == 0)
+				seconds_per_tick = Calibrate();
+			return (double)(int64_t)(now_t - prev_t) * seconds_per_tick;
+		}
+	};
+
+	/*!
+	 * \class	VirtualClock
+	 *
+	 * \brief	A clock that only moves when you tell it to. Useful for tests and benchmarks that need
+	 * 			to fast-forward time deterministically.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class VirtualClock
+	{
+	private:
+		// current time, in nanoseconds
+		static std::atomic<int64_t> _now;
+
+	public:
+		/*! \brief	Time point, in nanoseconds. */
+		typedef int64_t TimePoint;
+
+		/*!
+		 * \fn	static TimePoint VirtualClock::Now() noexcept
+		 *
+		 * \brief	Gets virtual time now.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	A TimePoint.
+		 */
+		static TimePoint Now() noexcept
+		{
+			return _now.load(std::memory_order_acquire);
+		}
+
+		/*!
+		 * \fn	static double VirtualClock::DiffSeconds(const TimePoint& prev_t, const TimePoint& now_t) noexcept
+		 *
+		 * \brief	Calc difference in seconds between two time points.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	prev_t	The previous time point.
+		 * \param	now_t 	The current time point.
+		 *
+		 * \return	Seconds between the time points.
+		 */
+		static double DiffSeconds(const TimePoint& prev_t, const TimePoint& now_t) noexcept
+		{
+			return (double)(now_t - prev_t) / 1000000000.0;
+		}
+
+		/*!
+		 * \fn	static void VirtualClock::Advance(double seconds) noexcept
+		 *
+		 * \brief	Move virtual time forward.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	seconds	Seconds to advance.
+		 */
+		static void Advance(double seconds) noexcept
+		{
+			_now.fetch_add((int64_t)(seconds * 1000000000.0), std::memory_order_acq_rel);
+		}
+
+		/*!
+		 * \fn	static void VirtualClock::Set(double seconds) noexcept
+		 *
+		 * \brief	Set virtual time.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	seconds	Time to set, in seconds.
+		 */
+		static void Set(double seconds) noexcept
+		{
+			_now.store((int64_t)(seconds * 1000000000.0), std::memory_order_release);
 		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,7 @@
+#include "ClusterSync.h"
+
+namespace BucketAlerts
+{
+	// compile the default cluster sync once
+	template class BasicClusterSync<AlertsManager>;
+}
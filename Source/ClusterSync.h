@@ -0,0 +1,287 @@
+/*!
+ * \file	Source\ClusterSync.h.
+ *
+ * \brief	Declares approximate cluster-wide limits, by exchanging consumption deltas between nodes.
+ */
+#pragma once
+#include "AlertsManager.h"
+#include "ClusterTransport.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	BasicClusterSync
+	 *
+	 * \brief	Makes the buckets of alerts managers on several nodes approximate shared, cluster-wide buckets.
+	 * 			Every node consumes from its local buckets at full speed, as usual. Periodically, a background
+	 * 			thread sends how many tokens every local bucket consumed since the previous exchange to all
+	 * 			peers (through a pluggable transport), and takes the tokens peers consumed from the matching
+	 * 			local buckets (without failing or invoking callbacks). So every bucket drains by the consumption
+	 * 			of the whole cluster, and nodes never talk to each other on the consuming path.
+	 *
+	 * 			Buckets should be created with the same params on all nodes (each holds the whole cluster
+	 * 			budget). Buckets that only exist on peers are created locally from their category template.
+	 * 			Accuracy: until the next exchange every node only sees its own consumption, so the cluster may
+	 * 			pass a bucket by up to (nodes - 1) * (tokens consumed per interval), and lost packets lose their deltas.
+	 * 			Category and global limits are not synced.
+	 *
+	 * 			Bucket type must provide TotalConsumed() and Take() (TokenBucket, AtomicTokenBucket and GcraBucket do),
+	 * 			and the manager must be thread safe, as the exchange runs on its own thread.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class ManagerT>
+	class BasicClusterSync
+	{
+	private:
+		// the manager we sync, transport to peers, and our id
+		ManagerT& _manager;
+		ClusterTransport& _transport;
+		uint32_t _node_id;
+
+		// total consumption of every bucket as of the previous exchange (including what we took for peers),
+		// and the exchange it was last seen in (to forget evicted buckets)
+		struct Tracked
+		{
+			double Total;
+			uint32_t Round;
+		};
+		std::unordered_map<BucketKey, Tracked> _tracked;
+		uint32_t _round = 0;
+
+		// next packet sequence number
+		uint32_t _sequence = 0;
+
+		// buffers reused between exchanges
+		std::vector<ClusterDelta> _totals;
+		std::vector<ClusterDelta> _deltas;
+		std::vector<char> _packet;
+
+		// counters
+		std::atomic<uint64_t> _deltas_sent { 0 };
+		std::atomic<uint64_t> _deltas_received { 0 };
+
+		// only one exchange at a time
+		std::mutex _exchange_mtx;
+
+		// background thread and its state
+		std::chrono::duration<double> _interval;
+		bool _running = false;
+		std::mutex _mtx;
+		std::condition_variable _wakeup;
+		std::thread _thread;
+
+		// background thread main loop
+		void Run();
+
+		// send local deltas since previous exchange
+		void SendDeltas();
+
+		// take tokens that peers consumed from our buckets
+		void ReceiveDeltas();
+
+	public:
+
+		/*!
+		 * \fn	BasicClusterSync::BasicClusterSync(ManagerT& manager, ClusterTransport& transport, uint32_t node_id, double interval = 0.05);
+		 *
+		 * \brief	Constructor. Starts the exchange thread (if interval is positive).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	manager  	The manager to sync (must outlive this object).
+		 * \param	transport	Transport to peers (must outlive this object).
+		 * \param	node_id  	Unique id of this node in the cluster (packets from the same id are ignored).
+		 * \param	interval 	Seconds between exchanges (0 = no thread, call Exchange() yourself).
+		 */
+		BasicClusterSync(ManagerT& manager, ClusterTransport& transport, uint32_t node_id, double interval = 0.05);
+
+		/*!
+		 * \fn	BasicClusterSync::~BasicClusterSync();
+		 *
+		 * \brief	Destructor. Stops the exchange thread and sends the last deltas.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		~BasicClusterSync();
+
+		// sync owns a thread, so it can't be copied
+		BasicClusterSync(const BasicClusterSync&) = delete;
+		BasicClusterSync& operator=(const BasicClusterSync&) = delete;
+
+		/*!
+		 * \fn	void BasicClusterSync::Exchange();
+		 *
+		 * \brief	Apply deltas received from peers, then send local deltas since the previous exchange.
+		 * 			Called periodically by the exchange thread, but can also be called directly.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Exchange();
+
+		/*!
+		 * \fn	inline uint64_t BasicClusterSync::DeltasSent() const
+		 *
+		 * \brief	Get how many deltas were sent to peers.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Sent deltas count.
+		 */
+		inline uint64_t DeltasSent() const { return _deltas_sent.load(std::memory_order_relaxed); }
+
+		/*!
+		 * \fn	inline uint64_t BasicClusterSync::DeltasReceived() const
+		 *
+		 * \brief	Get how many deltas were received from peers and applied.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Received deltas count.
+		 */
+		inline uint64_t DeltasReceived() const { return _deltas_received.load(std::memory_order_relaxed); }
+	};
+
+	/*!
+	 * \typedef	BasicClusterSync<AlertsManager> ClusterSync
+	 *
+	 * \brief	Cluster sync of the default alerts manager.
+	 */
+	typedef BasicClusterSync<AlertsManager> ClusterSync;
+
+	template <class ManagerT>
+	BasicClusterSync<ManagerT>::BasicClusterSync(ManagerT& manager, ClusterTransport& transport, uint32_t node_id, double interval) :
+		_manager(manager), _transport(transport), _node_id(node_id), _packet(ClusterTransport::MaxPacketSize), _interval(interval)
+	{
+		if (interval > 0)
+		{
+			_running = true;
+			_thread = std::thread(&BasicClusterSync::Run, this);
+		}
+	}
+
+	template <class ManagerT>
+	BasicClusterSync<ManagerT>::~BasicClusterSync()
+	{
+		// stop thread
+		if (_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				_running = false;
+			}
+			_wakeup.notify_one();
+			_thread.join();
+		}
+
+		// let peers know about our last consumption
+		Exchange();
+	}
+
+	template <class ManagerT>
+	void BasicClusterSync<ManagerT>::Run()
+	{
+		std::unique_lock<std::mutex> lock(_mtx);
+		while (_running)
+		{
+			_wakeup.wait_for(lock, _interval);
+			if (!_running)
+				break;
+			lock.unlock();
+			Exchange();
+			lock.lock();
+		}
+	}
+
+	template <class ManagerT>
+	void BasicClusterSync<ManagerT>::Exchange()
+	{
+		std::lock_guard<std::mutex> lock(_exchange_mtx);
+		ReceiveDeltas();
+		SendDeltas();
+	}
+
+	template <class ManagerT>
+	void BasicClusterSync<ManagerT>::ReceiveDeltas()
+	{
+		uint32_t node_id;
+		while (size_t size = _transport.Receive(_packet.data(), _packet.size()))
+		{
+			if (!ClusterPacket::Read(_packet.data(), size, node_id, _deltas) || node_id == _node_id)
+				continue;
+
+			// take what peers consumed (as much as we have), and count it as seen so we don't send it back
+			for (const ClusterDelta& delta : _deltas)
+			{
+				if (!(delta.Amount > 0))
+					continue;
+				double taken = _manager.Take((CategoryId)(delta.Key >> 32), (BucketId)delta.Key, delta.Amount);
+				Tracked& tracked = _tracked[delta.Key];
+				tracked.Total += taken;
+				tracked.Round = _round + 1;
+			}
+			_deltas_received.fetch_add(_deltas.size(), std::memory_order_relaxed);
+		}
+	}
+
+	template <class ManagerT>
+	void BasicClusterSync<ManagerT>::SendDeltas()
+	{
+		// read all buckets totals while shards are locked, and compare them to previous exchange after
+		_round++;
+		_totals.clear();
+		_manager.ForEachBucket([this](BucketKey key, typename ManagerT::Bucket& bucket) {
+			ClusterDelta total = { key, bucket.TotalConsumed() };
+			_totals.push_back(total);
+		});
+		_deltas.clear();
+		for (const ClusterDelta& total : _totals)
+		{
+			Tracked& tracked = _tracked[total.Key];
+			double delta = total.Amount - tracked.Total;
+			if (delta > 0)
+			{
+				ClusterDelta item = { total.Key, delta };
+				_deltas.push_back(item);
+			}
+			tracked.Total = total.Amount;
+			tracked.Round = _round;
+		}
+
+		// forget buckets that are gone (evicted or cleared)
+		if (_tracked.size() > _totals.size())
+		{
+			for (typename std::unordered_map<BucketKey, Tracked>::iterator it = _tracked.begin(); it != _tracked.end(); )
+			{
+				if (it->second.Round < _round) it = _tracked.erase(it);
+				else ++it;
+			}
+		}
+
+		// send in packets
+		for (size_t i = 0; i < _deltas.size(); i += ClusterPacket::MaxDeltas)
+		{
+			size_t count = _deltas.size() - i < ClusterPacket::MaxDeltas ? _deltas.size() - i : ClusterPacket::MaxDeltas;
+			size_t size = ClusterPacket::Write(_node_id, _sequence++, &_deltas[i], count, _packet.data());
+			_transport.Send(_packet.data(), size);
+		}
+		_deltas_sent.fetch_add(_deltas.size(), std::memory_order_relaxed);
+	}
+
+	// the default cluster sync is compiled once, in ClusterSync.cpp
+	extern template class BasicClusterSync<AlertsManager>;
+}
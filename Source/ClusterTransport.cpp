@@ -0,0 +1,237 @@
+#include "ClusterTransport.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace BucketAlerts
+{
+	// packets magic ("BKCS") and version
+	static const uint32_t PacketMagic = 0x53434b42;
+	static const uint16_t PacketVersion = 1;
+
+	// write and read little-endian numbers
+	static void PutLittle(unsigned char* out, uint64_t value, size_t bytes)
+	{
+		for (size_t i = 0; i < bytes; ++i)
+			out[i] = (unsigned char)(value >> (i * 8));
+	}
+	static uint64_t GetLittle(const unsigned char* data, size_t bytes)
+	{
+		uint64_t ret = 0;
+		for (size_t i = 0; i < bytes; ++i)
+			ret |= (uint64_t)data[i] << (i * 8);
+		return ret;
+	}
+
+	size_t ClusterPacket::Write(uint32_t node_id, uint32_t sequence, const ClusterDelta* deltas, size_t count, void* out)
+	{
+		unsigned char* data = (unsigned char*)out;
+		if (count > MaxDeltas)
+			count = MaxDeltas;
+		PutLittle(data, PacketMagic, 4);
+		PutLittle(data + 4, PacketVersion, 2);
+		PutLittle(data + 6, count, 2);
+		PutLittle(data + 8, node_id, 4);
+		PutLittle(data + 12, sequence, 4);
+		for (size_t i = 0; i < count; ++i)
+		{
+			unsigned char* delta = data + HeaderSize + i * DeltaSize;
+			float amount = (float)deltas[i].Amount;
+			uint32_t amount_bits;
+			std::memcpy(&amount_bits, &amount, sizeof(amount_bits));
+			PutLittle(delta, deltas[i].Key, 8);
+			PutLittle(delta + 8, amount_bits, 4);
+		}
+		return HeaderSize + count * DeltaSize;
+	}
+
+	bool ClusterPacket::Read(const void* data, size_t size, uint32_t& node_id, std::vector<ClusterDelta>& deltas)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		deltas.clear();
+		if (size < HeaderSize || GetLittle(bytes, 4) != PacketMagic || GetLittle(bytes + 4, 2) != PacketVersion)
+			return false;
+		size_t count = (size_t)GetLittle(bytes + 6, 2);
+		if (size != HeaderSize + count * DeltaSize)
+			return false;
+		node_id = (uint32_t)GetLittle(bytes + 8, 4);
+		deltas.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const unsigned char* delta = bytes + HeaderSize + i * DeltaSize;
+			uint32_t amount_bits = (uint32_t)GetLittle(delta + 8, 4);
+			float amount;
+			std::memcpy(&amount, &amount_bits, sizeof(amount));
+			deltas[i].Key = GetLittle(delta, 8);
+			deltas[i].Amount = amount;
+		}
+		return true;
+	}
+
+	LoopbackTransport::LoopbackTransport(LoopbackHub& hub) : _hub(hub)
+	{
+		std::lock_guard<std::mutex> lock(_hub._mtx);
+		_hub._transports.push_back(this);
+	}
+
+	LoopbackTransport::~LoopbackTransport()
+	{
+		std::lock_guard<std::mutex> lock(_hub._mtx);
+		_hub._transports.erase(std::remove(_hub._transports.begin(), _hub._transports.end(), this), _hub._transports.end());
+	}
+
+	bool LoopbackTransport::Send(const void* data, size_t size)
+	{
+		if (size > MaxPacketSize)
+			return false;
+
+		// queue a copy in every other transport (hub lock keeps them alive while we do)
+		std::lock_guard<std::mutex> lock(_hub._mtx);
+		for (LoopbackTransport* transport : _hub._transports)
+		{
+			if (transport == this)
+				continue;
+			std::lock_guard<std::mutex> transport_lock(transport->_mtx);
+			transport->_pending.emplace_back((const char*)data, (const char*)data + size);
+		}
+		return true;
+	}
+
+	size_t LoopbackTransport::Receive(void* buffer, size_t size)
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		if (_pending.empty() || _pending.front().size() > size)
+			return 0;
+		size_t ret = _pending.front().size();
+		std::memcpy(buffer, _pending.front().data(), ret);
+		_pending.pop_front();
+		return ret;
+	}
+
+#if defined(_WIN32)
+	// winsock must be initialized once per process before using sockets
+	static bool InitSockets()
+	{
+		static bool ret = []() {
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+		return ret;
+	}
+
+	// close a socket
+	static void CloseSocket(intptr_t sock)
+	{
+		closesocket((SOCKET)sock);
+	}
+
+	// make a socket non-blocking
+	static bool SetNonBlocking(intptr_t sock)
+	{
+		u_long mode = 1;
+		return ioctlsocket((SOCKET)sock, FIONBIO, &mode) == 0;
+	}
+#else
+	// sockets need no initialization on POSIX
+	static bool InitSockets()
+	{
+		return true;
+	}
+
+	// close a socket
+	static void CloseSocket(intptr_t sock)
+	{
+		close((int)sock);
+	}
+
+	// make a socket non-blocking
+	static bool SetNonBlocking(intptr_t sock)
+	{
+		int flags = fcntl((int)sock, F_GETFL, 0);
+		return flags >= 0 && fcntl((int)sock, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+#endif
+
+	UdpTransport::UdpTransport(uint16_t port, const char* address) : _socket(-1)
+	{
+		if (!InitSockets())
+			return;
+
+		// parse local address
+		sockaddr_in local;
+		std::memset(&local, 0, sizeof(local));
+		local.sin_family = AF_INET;
+		local.sin_port = htons(port);
+		if (inet_pton(AF_INET, address, &local.sin_addr) != 1)
+			return;
+
+		// open, bind and make non-blocking
+		intptr_t sock = (intptr_t)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (sock == -1)
+			return;
+		if (bind(sock, (const sockaddr*)&local, sizeof(local)) != 0 || !SetNonBlocking(sock))
+		{
+			CloseSocket(sock);
+			return;
+		}
+		_socket = sock;
+	}
+
+	UdpTransport::~UdpTransport()
+	{
+		if (_socket != -1)
+			CloseSocket(_socket);
+	}
+
+	bool UdpTransport::AddPeer(const char* address, uint16_t port)
+	{
+		in_addr parsed;
+		if (inet_pton(AF_INET, address, &parsed) != 1)
+			return false;
+		Peer peer = { (uint32_t)parsed.s_addr, htons(port) };
+		_peers.push_back(peer);
+		return true;
+	}
+
+	bool UdpTransport::Send(const void* data, size_t size)
+	{
+		if (_socket == -1 || size > MaxPacketSize)
+			return false;
+
+		bool ret = true;
+		for (const Peer& peer : _peers)
+		{
+			sockaddr_in to;
+			std::memset(&to, 0, sizeof(to));
+			to.sin_family = AF_INET;
+			to.sin_port = peer.Port;
+			to.sin_addr.s_addr = peer.Address;
+			if (sendto(_socket, (const char*)data, (int)size, 0, (const sockaddr*)&to, sizeof(to)) != (int)size)
+				ret = false;
+		}
+		return ret;
+	}
+
+	size_t UdpTransport::Receive(void* buffer, size_t size)
+	{
+		if (_socket == -1)
+			return 0;
+		int ret = (int)recv(_socket, (char*)buffer, (int)size, 0);
+		return ret > 0 ? (size_t)ret : 0;
+	}
+}
@@ -0,0 +1,310 @@
+/*!
+ * \file	Source\ClusterTransport.h.
+ *
+ * \brief	Declares transports that cluster nodes exchange consumption deltas with (see ClusterSync.h).
+ */
+#pragma once
+#include "Defs.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	ClusterTransport
+	 *
+	 * \brief	Interface of a transport that sends packets to all the peers of a node, and receives theirs.
+	 * 			Packets may be lost, duplicated or reordered (deltas are approximate anyway), but must not
+	 * 			be corrupted or truncated.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class ClusterTransport
+	{
+	public:
+
+		/*! \brief	Max packet size transports must support (fits a UDP datagram without fragmentation). */
+		static const size_t MaxPacketSize = 1400;
+
+		/*!
+		 * \fn	virtual ClusterTransport::~ClusterTransport()
+		 *
+		 * \brief	Destructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		virtual ~ClusterTransport() {}
+
+		/*!
+		 * \fn	virtual bool ClusterTransport::Send(const void* data, size_t size) = 0;
+		 *
+		 * \brief	Send a packet to all peers. Should not block for long.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	data	Packet data.
+		 * \param	size	Packet size (up to MaxPacketSize).
+		 *
+		 * \return	False if packet could not be sent to some of the peers.
+		 */
+		virtual bool Send(const void* data, size_t size) = 0;
+
+		/*!
+		 * \fn	virtual size_t ClusterTransport::Receive(void* buffer, size_t size) = 0;
+		 *
+		 * \brief	Receive the next pending packet from any peer, without waiting.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param [out]	buffer	Buffer to receive packet into.
+		 * \param 		  	size  	Buffer size (at least MaxPacketSize).
+		 *
+		 * \return	Packet size, or 0 if no packet is pending.
+		 */
+		virtual size_t Receive(void* buffer, size_t size) = 0;
+	};
+
+	/*!
+	 * \struct	ClusterDelta
+	 *
+	 * \brief	How many tokens a node consumed from a bucket since its previous exchange.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	struct ClusterDelta
+	{
+		/*! \brief	Bucket key (see MakeBucketKey()). */
+		BucketKey Key;
+
+		/*! \brief	Consumed tokens. */
+		double Amount;
+	};
+
+	/*!
+	 * \class	ClusterPacket
+	 *
+	 * \brief	Encodes and decodes packets of consumption deltas.
+	 * 			A packet is a 16 bytes header (magic, version, deltas count, node id, sequence) followed by
+	 * 			12 bytes per delta (key + amount as float), all little-endian, so nodes of different machines
+	 * 			can talk.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class ClusterPacket
+	{
+	public:
+
+		/*! \brief	Packet header size. */
+		static const size_t HeaderSize = 16;
+
+		/*! \brief	Encoded delta size. */
+		static const size_t DeltaSize = 12;
+
+		/*! \brief	Max deltas in a single packet. */
+		static const size_t MaxDeltas = (ClusterTransport::MaxPacketSize - HeaderSize) / DeltaSize;
+
+		/*!
+		 * \fn	static size_t ClusterPacket::Write(uint32_t node_id, uint32_t sequence, const ClusterDelta* deltas, size_t count, void* out);
+		 *
+		 * \brief	Encode a packet.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	node_id 	Sending node id.
+		 * \param 		  	sequence	Packet sequence number.
+		 * \param 		  	deltas  	Deltas to encode.
+		 * \param 		  	count   	Deltas count (up to MaxDeltas).
+		 * \param [out]	out			Buffer to write packet into (at least ClusterTransport::MaxPacketSize).
+		 *
+		 * \return	Packet size.
+		 */
+		static size_t Write(uint32_t node_id, uint32_t sequence, const ClusterDelta* deltas, size_t count, void* out);
+
+		/*!
+		 * \fn	static bool ClusterPacket::Read(const void* data, size_t size, uint32_t& node_id, std::vector<ClusterDelta>& deltas);
+		 *
+		 * \brief	Decode a packet.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	data   	Packet data.
+		 * \param 		  	size   	Packet size.
+		 * \param [out]	node_id	Sending node id.
+		 * \param [out]	deltas 	Decoded deltas (replaces content).
+		 *
+		 * \return	False if not a valid packet.
+		 */
+		static bool Read(const void* data, size_t size, uint32_t& node_id, std::vector<ClusterDelta>& deltas);
+	};
+
+	class LoopbackTransport;
+
+	/*!
+	 * \class	LoopbackHub
+	 *
+	 * \brief	Connects loopback transports of the same process: every packet sent by one of them is
+	 * 			received by all the others. Useful to test clusters in a single process.
+	 * 			Must outlive its transports.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class LoopbackHub
+	{
+	private:
+		// connected transports
+		std::vector<LoopbackTransport*> _transports;
+		std::mutex _mtx;
+
+		// transports register themselves
+		friend class LoopbackTransport;
+	};
+
+	/*!
+	 * \class	LoopbackTransport
+	 *
+	 * \brief	An in-process transport, connected to all the other transports of the same hub.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class LoopbackTransport : public ClusterTransport
+	{
+	private:
+		// the hub we're connected to, and packets sent to us
+		LoopbackHub& _hub;
+		std::deque<std::vector<char> > _pending;
+		std::mutex _mtx;
+
+	public:
+
+		/*!
+		 * \fn	LoopbackTransport::LoopbackTransport(LoopbackHub& hub);
+		 *
+		 * \brief	Constructor. Connects to a hub.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	hub	The hub to connect to.
+		 */
+		LoopbackTransport(LoopbackHub& hub);
+
+		/*!
+		 * \fn	LoopbackTransport::~LoopbackTransport();
+		 *
+		 * \brief	Destructor. Disconnects from hub.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		~LoopbackTransport();
+
+		// transport is registered in its hub by address, so it can't be copied
+		LoopbackTransport(const LoopbackTransport&) = delete;
+		LoopbackTransport& operator=(const LoopbackTransport&) = delete;
+
+		// send to all other transports of the hub
+		bool Send(const void* data, size_t size) override;
+
+		// receive next pending packet
+		size_t Receive(void* buffer, size_t size) override;
+	};
+
+	/*!
+	 * \class	UdpTransport
+	 *
+	 * \brief	A transport over UDP (IPv4): binds a local port, and sends every packet to a list of peers.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class UdpTransport : public ClusterTransport
+	{
+	private:
+		// peer address (IPv4, network byte order)
+		struct Peer
+		{
+			uint32_t Address;
+			uint16_t Port;
+		};
+
+		// the socket (invalid if failed to open), and peers to send to
+		intptr_t _socket;
+		std::vector<Peer> _peers;
+
+	public:
+
+		/*!
+		 * \fn	UdpTransport::UdpTransport(uint16_t port, const char* address = "127.0.0.1");
+		 *
+		 * \brief	Constructor. Opens a non-blocking UDP socket bound to an address and port.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	port   	Local port to bind.
+		 * \param	address	(Optional) Local IPv4 address to bind.
+		 */
+		UdpTransport(uint16_t port, const char* address = "127.0.0.1");
+
+		/*!
+		 * \fn	UdpTransport::~UdpTransport();
+		 *
+		 * \brief	Destructor. Closes the socket.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		~UdpTransport();
+
+		// transport owns its socket, so it can't be copied
+		UdpTransport(const UdpTransport&) = delete;
+		UdpTransport& operator=(const UdpTransport&) = delete;
+
+		/*!
+		 * \fn	inline bool UdpTransport::IsOpen() const
+		 *
+		 * \brief	Check if socket was opened and bound successfully.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	True if open.
+		 */
+		inline bool IsOpen() const { return _socket != -1; }
+
+		/*!
+		 * \fn	bool UdpTransport::AddPeer(const char* address, uint16_t port);
+		 *
+		 * \brief	Add a peer to send packets to.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	address	Peer IPv4 address.
+		 * \param	port   	Peer port.
+		 *
+		 * \return	False if address is invalid.
+		 */
+		bool AddPeer(const char* address, uint16_t port);
+
+		// send to all peers
+		bool Send(const void* data, size_t size) override;
+
+		// receive next pending datagram
+		size_t Receive(void* buffer, size_t size) override;
+	};
+}
@@ -0,0 +1,258 @@
+#include "ColumnAlertsManager.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BUCKET_ALERTS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BUCKET_ALERTS_SSE2
+#endif
+
+namespace BucketAlerts
+{
+	// replenish tokens of all rows: tokens = min(max, tokens + (now - last) * rate), last = now.
+	// like UpdateRow(), rows that are already updated past now (clock stepped back) are left as is.
+	static void UpdateColumns(double* tokens, double* last_update, const double* rate, const double* max, double now, size_t count)
+	{
+		size_t i = 0;
+
+#if defined(BUCKET_ALERTS_AVX2)
+		// 4 buckets at a time
+		__m256d now4 = _mm256_set1_pd(now);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m256d last = _mm256_loadu_pd(last_update + i);
+			__m256d current = _mm256_loadu_pd(tokens + i);
+			__m256d forward = _mm256_cmp_pd(now4, last, _CMP_GT_OQ);
+			__m256d dt = _mm256_sub_pd(now4, last);
+			__m256d added = _mm256_min_pd(_mm256_add_pd(current, _mm256_mul_pd(dt, _mm256_loadu_pd(rate + i))), _mm256_loadu_pd(max + i));
+			_mm256_storeu_pd(tokens + i, _mm256_blendv_pd(current, added, forward));
+			_mm256_storeu_pd(last_update + i, _mm256_blendv_pd(last, now4, forward));
+		}
+#elif defined(BUCKET_ALERTS_SSE2)
+		// 2 buckets at a time
+		__m128d now2 = _mm_set1_pd(now);
+		for (; i + 2 <= count; i += 2)
+		{
+			__m128d last = _mm_loadu_pd(last_update + i);
+			__m128d current = _mm_loadu_pd(tokens + i);
+			__m128d forward = _mm_cmpgt_pd(now2, last);
+			__m128d dt = _mm_sub_pd(now2, last);
+			__m128d added = _mm_min_pd(_mm_add_pd(current, _mm_mul_pd(dt, _mm_loadu_pd(rate + i))), _mm_loadu_pd(max + i));
+			_mm_storeu_pd(tokens + i, _mm_or_pd(_mm_and_pd(forward, added), _mm_andnot_pd(forward, current)));
+			_mm_storeu_pd(last_update + i, _mm_or_pd(_mm_and_pd(forward, now2), _mm_andnot_pd(forward, last)));
+		}
+#endif
+
+		// leftovers (or everything, if no SIMD)
+		for (; i < count; ++i)
+		{
+			double dt = now - last_update[i];
+			if (dt <= 0)
+				continue;
+			tokens[i] = std::min(tokens[i] + dt * rate[i], max[i]);
+			last_update[i] = now;
+		}
+	}
+
+	ColumnAlertsManager::ColumnAlertsManager()
+	{
+		_epoch = AccurateClock::Now();
+	}
+
+	uint32_t ColumnAlertsManager::AddColumnsRow(BucketKey key, double starting_tokens, double max_tokens, double replenish_rate, ColumnBucketCallback callback)
+	{
+		// get index (rows are added in the same order as the table indices)
+		bool created;
+		uint32_t index;
+		uint32_t& row = _indices.GetOrCreate(key, created, &index);
+		row = index;
+
+		// add new row
+		if (created)
+		{
+			_tokens.push_back(0);
+			_replenish_rate.push_back(0);
+			_max_tokens.push_back(0);
+			_starting_count.push_back(0);
+			_total_consumption.push_back(0);
+			_last_update_time.push_back(0);
+			_callbacks.push_back(nullptr);
+		}
+
+		// set row values
+		_tokens[row] = starting_tokens;
+		_replenish_rate[row] = replenish_rate;
+		_max_tokens[row] = max_tokens;
+		_starting_count[row] = starting_tokens;
+		_total_consumption[row] = 0;
+		_last_update_time[row] = Now();
+		_callbacks[row] = callback;
+		return row;
+	}
+
+	uint32_t ColumnAlertsManager::FindOrCreate(BucketKey key)
+	{
+		// try to find existing
+		uint32_t* row = _indices.Find(key);
+		if (row)
+			return *row;
+
+		// not found? switch to exclusive lock and create with default params
+		if (Defs::ThreadSafe) { _mtx.unlock_shared(); _mtx.lock(); }
+		uint32_t* existing = _indices.Find(key);
+		uint32_t ret = existing ? *existing : AddColumnsRow(key, 0, 10, 1, nullptr);
+		if (Defs::ThreadSafe) { _mtx.unlock(); _mtx.lock_shared(); }
+		return ret;
+	}
+
+	void ColumnAlertsManager::UpdateRow(uint32_t index, double now)
+	{
+		double dt = now - _last_update_time[index];
+		if (dt <= 0)
+			return;
+
+		_last_update_time[index] = now;
+		_tokens[index] = std::min(_tokens[index] + dt * _replenish_rate[index], _max_tokens[index]);
+	}
+
+	void ColumnAlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, ColumnBucketCallback callback)
+	{
+		if (Defs::ThreadSafe) _mtx.lock();
+		AddColumnsRow(MakeBucketKey(cat_id, bucket_id), starting_tokens, max_tokens, replenish_rate, callback);
+		if (Defs::ThreadSafe) _mtx.unlock();
+	}
+
+	void ColumnAlertsManager::CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, ColumnBucketCallback callback)
+	{
+		CreateBucket(Defs::DefaultCategoryId, bucket_id, starting_tokens, max_tokens, replenish_rate, callback);
+	}
+
+	bool ColumnAlertsManager::Consume(CategoryId cat_id, BucketId bucket_id, double amount)
+	{
+		// skip if disabled
+		if (!Enabled)
+			return true;
+
+		// read time before locking, if we need it
+		double now = Defs::AutoUpdate ? Now() : 0;
+
+		// get bucket row and lock it
+		if (Defs::ThreadSafe) _mtx.lock_shared();
+		uint32_t row = FindOrCreate(MakeBucketKey(cat_id, bucket_id));
+		std::mutex& lock = _locks[row % LocksCount];
+		if (Defs::ThreadSafe) lock.lock();
+
+		// update tokens before consuming
+		if (Defs::AutoUpdate)
+			UpdateRow(row, now);
+
+		// if got enough to consume reduce tokens and return true
+		bool ret = _tokens[row] >= amount;
+		if (ret)
+		{
+			_tokens[row] -= amount;
+			_total_consumption[row] += amount;
+		}
+		// if don't have enough zero tokens (or reset them if needed)
+		else
+		{
+			_total_consumption[row] += _tokens[row];
+			_tokens[row] = Defs::ResetWhenConsumed ? _starting_count[row] : 0;
+		}
+
+		// get callback and unlock
+		ColumnBucketCallback callback = ret ? nullptr : _callbacks[row];
+		if (Defs::ThreadSafe) { lock.unlock(); _mtx.unlock_shared(); }
+
+		// invoke callback outside the locks
+		if (callback)
+		{
+			callback(cat_id, bucket_id);
+		}
+
+		return ret;
+	}
+
+	bool ColumnAlertsManager::Consume(BucketId bucket_id, double amount)
+	{
+		return Consume(Defs::DefaultCategoryId, bucket_id, amount);
+	}
+
+	void ColumnAlertsManager::Restore(CategoryId cat_id, BucketId bucket_id, double amount)
+	{
+		if (Defs::ThreadSafe) _mtx.lock_shared();
+		uint32_t row = FindOrCreate(MakeBucketKey(cat_id, bucket_id));
+		std::mutex& lock = _locks[row % LocksCount];
+		if (Defs::ThreadSafe) lock.lock();
+
+		// add tokens and make sure didn't pass max
+		_tokens[row] = std::min(_tokens[row] + amount, _max_tokens[row]);
+
+		if (Defs::ThreadSafe) { lock.unlock(); _mtx.unlock_shared(); }
+	}
+
+	double ColumnAlertsManager::Count(CategoryId cat_id, BucketId bucket_id)
+	{
+		double now = Defs::AutoUpdate ? Now() : 0;
+
+		if (Defs::ThreadSafe) _mtx.lock_shared();
+		uint32_t row = FindOrCreate(MakeBucketKey(cat_id, bucket_id));
+		std::mutex& lock = _locks[row % LocksCount];
+		if (Defs::ThreadSafe) lock.lock();
+
+		// update tokens and get current balance
+		if (Defs::AutoUpdate)
+			UpdateRow(row, now);
+		double ret = _tokens[row];
+
+		if (Defs::ThreadSafe) { lock.unlock(); _mtx.unlock_shared(); }
+		return ret;
+	}
+
+	double ColumnAlertsManager::TotalConsumed(CategoryId cat_id, BucketId bucket_id)
+	{
+		if (Defs::ThreadSafe) _mtx.lock_shared();
+		uint32_t row = FindOrCreate(MakeBucketKey(cat_id, bucket_id));
+		std::mutex& lock = _locks[row % LocksCount];
+		if (Defs::ThreadSafe) lock.lock();
+
+		double ret = _total_consumption[row];
+
+		if (Defs::ThreadSafe) { lock.unlock(); _mtx.unlock_shared(); }
+		return ret;
+	}
+
+	void ColumnAlertsManager::ResetAll()
+	{
+		if (Defs::ThreadSafe) _mtx.lock();
+		std::copy(_starting_count.begin(), _starting_count.end(), _tokens.begin());
+		if (Defs::ThreadSafe) _mtx.unlock();
+	}
+
+	void ColumnAlertsManager::ManualUpdate()
+	{
+		// single clock read for all buckets
+		double now = Now();
+
+		// lock for writing, so we don't need the per-bucket locks
+		if (Defs::ThreadSafe) _mtx.lock();
+		UpdateColumns(_tokens.data(), _last_update_time.data(), _replenish_rate.data(), _max_tokens.data(), now, _tokens.size());
+		if (Defs::ThreadSafe) _mtx.unlock();
+	}
+
+	void ColumnAlertsManager::Clear()
+	{
+		if (Defs::ThreadSafe) _mtx.lock();
+		_indices.Clear();
+		_tokens.clear();
+		_replenish_rate.clear();
+		_max_tokens.clear();
+		_starting_count.clear();
+		_total_consumption.clear();
+		_last_update_time.clear();
+		_callbacks.clear();
+		if (Defs::ThreadSafe) _mtx.unlock();
+	}
+}
@@ -0,0 +1,247 @@
+/*!
+ * \file	Source\ColumnAlertsManager.h.
+ *
+ * \brief	Declares an alerts manager that stores buckets as columns.
+ */
+#pragma once
+#include "Defs.h"
+#include "Clock.h"
+#include "BucketsTable.h"
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \typedef	void(*ColumnBucketCallback)(CategoryId cat_id, BucketId bucket_id)
+	 *
+	 * \brief	A callback to call when a bucket in a column alerts manager is exhausted.
+	 */
+	typedef void(*ColumnBucketCallback)(CategoryId cat_id, BucketId bucket_id);
+
+	/*!
+	 * \class	ColumnAlertsManager
+	 *
+	 * \brief	An alerts manager that doesn't use TokenBucket objects, but instead stores all the
+	 * 			buckets tokens, replenish rates, max values etc. in contiguous columns (structure of arrays).
+	 * 			This makes ManualUpdate() replenish all buckets with a single clock read and a vectorized
+	 * 			loop (AVX2 / SSE2 when compiled with them, scalar otherwise), so its meant to be used
+	 * 			with Defs::AutoUpdate = false and a lot of buckets.
+	 * 			Note that with auto-update on, every consume touches several columns, so the regular
+	 * 			AlertsManager is better for that case.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class ColumnAlertsManager
+	{
+	public:
+
+		/*! \brief	How many locks we use to protect buckets while consuming (buckets share locks by index). */
+		static const unsigned int LocksCount = 64;
+
+	private:
+
+		// maps keys to column index
+		BucketsTable<uint32_t> _indices;
+
+		// buckets columns
+		std::vector<double> _tokens;
+		std::vector<double> _replenish_rate;
+		std::vector<double> _max_tokens;
+		std::vector<double> _starting_count;
+		std::vector<double> _total_consumption;
+		std::vector<double> _last_update_time;
+		std::vector<ColumnBucketCallback> _callbacks;
+
+		// time point that columns time is counted from (in seconds)
+		AccurateClock::TimePoint _epoch;
+
+		// mutex to protect columns structure (consumers lock for reading, creating / updating all buckets for writing)
+		std::shared_mutex _mtx;
+
+		// locks to protect single buckets while consuming
+		std::mutex _locks[LocksCount];
+
+		// get current time in seconds since epoch
+		inline double Now() const { return AccurateClock::DiffSeconds(_epoch, AccurateClock::Now()); }
+
+		// find bucket index or create it with default params. must be called with shared lock, which might be released and re-acquired.
+		uint32_t FindOrCreate(BucketKey key);
+
+		// add a new bucket to columns and return its index. must be called with exclusive lock.
+		uint32_t AddColumnsRow(BucketKey key, double starting_tokens, double max_tokens, double replenish_rate, ColumnBucketCallback callback);
+
+		// replenish a single bucket. must be called with the bucket lock.
+		void UpdateRow(uint32_t index, double now);
+
+	public:
+
+		/*! \brief	Enable / disable the alerts manager and consumption counting. */
+		bool Enabled = true;
+
+		/*!
+		 * \fn	ColumnAlertsManager::ColumnAlertsManager();
+		 *
+		 * \brief	Default constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		ColumnAlertsManager();
+
+		/*!
+		 * \fn	void ColumnAlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, ColumnBucketCallback callback);
+		 *
+		 * \brief	Creates a new bucket (or override existing one).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id		   	Identifier for the category.
+		 * \param	bucket_id	   	Identifier for the bucket.
+		 * \param	starting_tokens	Bucket starting tokens count.
+		 * \param	max_tokens	   	Bucket max tokens.
+		 * \param	replenish_rate 	Bucket replenish rate.
+		 * \param	callback		Callback to trigger when bucket exhausted.
+		 */
+		void CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, ColumnBucketCallback callback);
+
+		/*!
+		 * \fn	void ColumnAlertsManager::CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, ColumnBucketCallback callback);
+		 *
+		 * \brief	Creates a new bucket in the default category.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket_id	   	Identifier for the bucket.
+		 * \param	starting_tokens	Bucket starting tokens count.
+		 * \param	max_tokens	   	Bucket max tokens.
+		 * \param	replenish_rate 	Bucket replenish rate.
+		 * \param	callback		Callback to trigger when bucket exhausted.
+		 */
+		void CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate, ColumnBucketCallback callback);
+
+		/*!
+		 * \fn	bool ColumnAlertsManager::Consume(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+		 *
+		 * \brief	Consumes from bucket, and return false if was exhausted.
+		 * 			If bucket doesn't exist, will create it with default params.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 * \param	amount   	(Optional) The amount to consume.
+		 *
+		 * \return	True if bucket is not empty, false if consumed.
+		 */
+		bool Consume(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+
+		/*!
+		 * \fn	bool ColumnAlertsManager::Consume(BucketId bucket_id, double amount = 1.0);
+		 *
+		 * \brief	Consumes from bucket in default category, and return false if was exhausted.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket_id	Identifier for the bucket in default category.
+		 * \param	amount   	(Optional) The amount to consume.
+		 *
+		 * \return	True if bucket is not empty, false if consumed.
+		 */
+		bool Consume(BucketId bucket_id, double amount = 1.0);
+
+		/*!
+		 * \fn	void ColumnAlertsManager::Restore(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+		 *
+		 * \brief	Restore tokens to bucket.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 * \param	amount   	(Optional) The amount to restore.
+		 */
+		void Restore(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+
+		/*!
+		 * \fn	double ColumnAlertsManager::Count(CategoryId cat_id, BucketId bucket_id);
+		 *
+		 * \brief	Get current tokens count of a bucket.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 *
+		 * \return	Current tokens count.
+		 */
+		double Count(CategoryId cat_id, BucketId bucket_id);
+
+		/*!
+		 * \fn	double ColumnAlertsManager::TotalConsumed(CategoryId cat_id, BucketId bucket_id);
+		 *
+		 * \brief	Return how many tokens were consumed in total from a bucket.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 *
+		 * \return	The total number of consumed token since the creation of this bucket.
+		 */
+		double TotalConsumed(CategoryId cat_id, BucketId bucket_id);
+
+		/*!
+		 * \fn	void ColumnAlertsManager::ResetAll();
+		 *
+		 * \brief	Resets all buckets.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void ResetAll();
+
+		/*!
+		 * \fn	void ColumnAlertsManager::ManualUpdate();
+		 *
+		 * \brief	Replenish all buckets, with a single clock read and a vectorized loop.
+		 * 			Use this if you disable auto-update mode.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void ManualUpdate();
+
+		/*!
+		 * \fn	void ColumnAlertsManager::Clear();
+		 *
+		 * \brief	Remove all buckets.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Clear();
+
+		/*!
+		 * \fn	inline uint32_t ColumnAlertsManager::BucketsCount() const
+		 *
+		 * \brief	Get how many buckets we have.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Buckets count.
+		 */
+		inline uint32_t BucketsCount() const { return _indices.Count(); }
+	};
+}
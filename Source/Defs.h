@@ -4,6 +4,7 @@
  * \brief	Declares the defs class.
  */
 #pragma once
+#include <cstdint>
 
 namespace BucketAlerts
 {
@@ -21,6 +22,53 @@ namespace BucketAlerts
 	*/
 	typedef unsigned int BucketId;
 
+	/*!
+	* \typedef	uint64_t BucketKey
+	*
+	* \brief	Defines an alias representing a combined (category id, bucket id) key.
+	*/
+	typedef uint64_t BucketKey;
+
+	/*!
+	 * \fn	inline BucketKey MakeBucketKey(CategoryId cat_id, BucketId bucket_id)
+	 *
+	 * \brief	Combine category id and bucket id into a single key.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 *
+	 * \param	cat_id   	Identifier for the category.
+	 * \param	bucket_id	Identifier for the bucket.
+	 *
+	 * \return	The combined key.
+	 */
+	inline BucketKey MakeBucketKey(CategoryId cat_id, BucketId bucket_id)
+	{
+		return ((BucketKey)cat_id << 32) | (BucketKey)bucket_id;
+	}
+
+	/*!
+	 * \fn	inline uint64_t HashBucketKey(BucketKey key)
+	 *
+	 * \brief	Mix the bits of a combined key (used to pick shards and table slots).
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 *
+	 * \param	key	The combined key.
+	 *
+	 * \return	Hash value.
+	 */
+	inline uint64_t HashBucketKey(BucketKey key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	}
+
 	/*!
 	 * \class	Defs
 	 *
@@ -0,0 +1,155 @@
+#include "EpochDomain.h"
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace BucketAlerts
+{
+	std::atomic<bool> EpochDomain::_asymmetric(false);
+
+	EpochDomain::Registry::~Registry()
+	{
+		Reader* reader = Readers.load(std::memory_order_acquire);
+		while (reader)
+		{
+			Reader* next = reader->Next;
+			delete reader;
+			reader = next;
+		}
+	}
+
+	EpochDomain::EpochDomain() :
+		_registry(std::make_shared<Registry>())
+	{
+		// register for process-wide barriers once (if it fails, readers keep using fences)
+		static std::once_flag registered;
+		std::call_once(registered, [] {
+#if defined(_WIN32)
+			_asymmetric.store(true, std::memory_order_relaxed);
+#elif defined(__linux__) && defined(__NR_membarrier)
+			if (syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0)
+				_asymmetric.store(true, std::memory_order_relaxed);
+#endif
+		});
+	}
+
+	EpochDomain::~EpochDomain()
+	{
+		_registry->Alive.store(false, std::memory_order_release);
+	}
+
+	EpochDomain::Reader& EpochDomain::ThreadReader()
+	{
+		// registries the calling thread read and its records in them. records are released when thread exits.
+		struct ThreadRecords
+		{
+			std::vector<std::pair<std::shared_ptr<Registry>, Reader*>> Records;
+			~ThreadRecords()
+			{
+				for (auto& record : Records)
+					record.second->Taken.store(false, std::memory_order_release);
+				_thread_registry = nullptr;
+				_thread_reader = nullptr;
+			}
+		};
+		static thread_local ThreadRecords thread_records;
+		std::vector<std::pair<std::shared_ptr<Registry>, Reader*>>& records = thread_records.Records;
+
+		// already registered? (drop records of domains that are gone while looking)
+		Reader* ret = nullptr;
+		for (size_t i = 0; i < records.size(); )
+		{
+			if (records[i].first == _registry)
+			{
+				ret = records[i].second;
+				++i;
+			}
+			else if (!records[i].first->Alive.load(std::memory_order_acquire))
+			{
+				records[i].second->Taken.store(false, std::memory_order_release);
+				records[i] = records.back();
+				records.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		// not registered? take a record released by a thread that exited, or add a new one
+		if (!ret)
+		{
+			for (Reader* reader = _registry->Readers.load(std::memory_order_acquire); reader && !ret; reader = reader->Next)
+			{
+				bool taken = false;
+				if (reader->Taken.compare_exchange_strong(taken, true, std::memory_order_acquire))
+					ret = reader;
+			}
+			if (!ret)
+			{
+				ret = new Reader();
+				ret->Taken.store(true, std::memory_order_relaxed);
+				ret->Next = _registry->Readers.load(std::memory_order_relaxed);
+				while (!_registry->Readers.compare_exchange_weak(ret->Next, ret, std::memory_order_release, std::memory_order_relaxed))
+				{
+				}
+			}
+			records.emplace_back(_registry, ret);
+		}
+
+		// remember it for next reads
+		_thread_registry = _registry.get();
+		_thread_reader = ret;
+		return *ret;
+	}
+
+	void EpochDomain::HeavyBarrier()
+	{
+		if (!_asymmetric.load(std::memory_order_relaxed))
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			return;
+		}
+#if defined(_WIN32)
+		FlushProcessWriteBuffers();
+#elif defined(__linux__) && defined(__NR_membarrier)
+		syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+#endif
+	}
+
+	uint64_t EpochDomain::Advance()
+	{
+		return _epoch.fetch_add(1, std::memory_order_seq_cst);
+	}
+
+	uint64_t EpochDomain::SafeEpoch() const
+	{
+		// readers don't fence when they enter, so make their records visible first
+		HeavyBarrier();
+		uint64_t ret = _epoch.load(std::memory_order_seq_cst);
+		for (const Reader* reader = _registry->Readers.load(std::memory_order_acquire); reader; reader = reader->Next)
+		{
+			uint64_t epoch = reader->Epoch.load(std::memory_order_seq_cst);
+			if (epoch && epoch < ret)
+				ret = epoch;
+		}
+		return ret;
+	}
+
+	void EpochDomain::Synchronize()
+	{
+		uint64_t epoch = Advance();
+		while (SafeEpoch() <= epoch)
+			std::this_thread::yield();
+	}
+}
@@ -0,0 +1,182 @@
+/*!
+ * \file	Source\EpochDomain.h.
+ *
+ * \brief	Declares epochs that let readers traverse shared data without locks, while writers defer reusing what they removed.
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	EpochDomain
+	 *
+	 * \brief	Epoch-based reclamation: readers announce the epoch they started at, and writers tag what they
+	 * 			remove with the epoch it was removed at (see Advance()). Removed memory is only reused once
+	 * 			every active reader started after it was removed (see SafeEpoch()), so readers never take
+	 * 			a lock and never block writers, and writers never wait for readers.
+	 *
+	 * 			Every thread gets its own reader record in a domain the first time it reads, so entering and
+	 * 			leaving is a plain store to a cache line no other thread writes. Instead of a fence on every
+	 * 			read, writers issue a process-wide barrier when they check readers (membarrier() on linux,
+	 * 			FlushProcessWriteBuffers() on windows). Where that's not available, readers use a fence.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class EpochDomain
+	{
+	private:
+
+		// a thread reader record: the epoch it started reading at (0 = not reading) and how many guards it has open.
+		// each in its own cache line, so readers don't contend.
+		struct alignas(64) Reader
+		{
+			std::atomic<uint64_t> Epoch { 0 };
+			uint32_t Depth = 0;
+			std::atomic<bool> Taken { false };
+			Reader* Next = nullptr;
+		};
+
+		// reader records of a domain. threads keep it alive too, so they can release their records after the domain is gone.
+		struct Registry
+		{
+			std::atomic<Reader*> Readers { nullptr };
+			std::atomic<bool> Alive { true };
+			~Registry();
+		};
+
+		// current epoch
+		alignas(64) std::atomic<uint64_t> _epoch { 1 };
+
+		// reader records
+		std::shared_ptr<Registry> _registry;
+
+		// last registry the calling thread read, and its record in it (so reading doesn't look it up)
+		inline static thread_local const Registry* _thread_registry = nullptr;
+		inline static thread_local Reader* _thread_reader = nullptr;
+
+		// true if writers issue process-wide barriers, so readers don't need a fence
+		static std::atomic<bool> _asymmetric;
+
+		// get the record of the calling thread (registers it on first use)
+		Reader& ThreadReader();
+
+		// make sure reader records are visible to writers before they check them
+		static void HeavyBarrier();
+
+		// announce current epoch in the calling thread record
+		inline Reader* Enter()
+		{
+			Reader* reader = (_thread_registry == _registry.get()) ? _thread_reader : &ThreadReader();
+			if (reader->Depth++ == 0)
+			{
+				reader->Epoch.store(_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+				if (_asymmetric.load(std::memory_order_relaxed))
+					std::atomic_signal_fence(std::memory_order_seq_cst);
+				else
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+			return reader;
+		}
+
+		// leave the epoch (when the outermost guard of the thread is done)
+		static inline void Exit(Reader* reader)
+		{
+			if (--reader->Depth == 0)
+				reader->Epoch.store(0, std::memory_order_release);
+		}
+
+	public:
+
+		/*!
+		 * \fn	EpochDomain::EpochDomain();
+		 *
+		 * \brief	Default constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		EpochDomain();
+
+		/*!
+		 * \fn	EpochDomain::~EpochDomain();
+		 *
+		 * \brief	Destructor. Threads release their reader records when they exit.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		~EpochDomain();
+
+		// domain is shared by its readers, so it can't be copied
+		EpochDomain(const EpochDomain&) = delete;
+		EpochDomain& operator=(const EpochDomain&) = delete;
+
+		/*!
+		 * \class	ReadGuard
+		 *
+		 * \brief	Marks the calling thread as reading while in scope. Guards can nest.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		class ReadGuard
+		{
+		private:
+			Reader* _reader;
+
+		public:
+
+			// enter epoch (unless told not to, when there are no concurrent writers)
+			ReadGuard(EpochDomain& domain, bool enter = true) : _reader(enter ? domain.Enter() : nullptr) {}
+
+			// leave epoch
+			~ReadGuard() { if (_reader) Exit(_reader); }
+
+			// guard marks its thread as reading, so it can't be copied
+			ReadGuard(const ReadGuard&) = delete;
+			ReadGuard& operator=(const ReadGuard&) = delete;
+		};
+
+		/*!
+		 * \fn	uint64_t EpochDomain::Advance();
+		 *
+		 * \brief	Start a new epoch. Call after removing something readers may see (so readers that enter
+		 * 			from now on can't see it), and tag it with the returned epoch.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	The epoch that just ended.
+		 */
+		uint64_t Advance();
+
+		/*!
+		 * \fn	uint64_t EpochDomain::SafeEpoch() const;
+		 *
+		 * \brief	Get the oldest epoch an active reader started at (or current epoch, if no readers).
+		 * 			Anything tagged with a lower epoch is no longer seen by any reader, and can be reused.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Safe epoch.
+		 */
+		uint64_t SafeEpoch() const;
+
+		/*!
+		 * \fn	void EpochDomain::Synchronize();
+		 *
+		 * \brief	Wait until all readers that are active now are done (readers that enter after are not waited for).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Synchronize();
+	};
+}
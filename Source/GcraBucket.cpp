@@ -0,0 +1,7 @@
+#include "GcraBucket.h"
+
+namespace BucketAlerts
+{
+	// compile the default bucket once
+	template class BasicGcraBucket<AccurateClock>;
+}
@@ -0,0 +1,579 @@
+/*!
+ * \file	Source\GcraBucket.h.
+ *
+ * \brief	Declares a bucket based on the generic cell rate algorithm (GCRA).
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "Clock.h"
+#include "Policies.h"
+
+
+namespace BucketAlerts
+{
+	// predef
+	template <class ClockT = AccurateClock, class UpdateT = RuntimeUpdate>
+	class BasicGcraBucket;
+
+	/*!
+	 * \typedef	BasicGcraBucket<AccurateClock> GcraBucket
+	 *
+	 * \brief	The default GCRA bucket, using the accurate clock.
+	 */
+	typedef BasicGcraBucket<AccurateClock> GcraBucket;
+
+	/*!
+	 * \typedef	void(*GcraBucketCallback)(const GcraBucket& bucket)
+	 *
+	 * \brief	A callback we can attach to a GCRA bucket to call when exhausted.
+	 */
+	typedef void(*GcraBucketCallback)(const GcraBucket& bucket);
+
+	/*!
+	 * \class	BasicGcraBucket
+	 *
+	 * \brief	A token bucket implemented with the generic cell rate algorithm.
+	 * 			Instead of tokens and last update time, the whole state is a single timestamp: the time
+	 * 			the bucket will be full again. Every token consumed pushes it forward by 1 / replenish rate,
+	 * 			and the bucket is exhausted if it would pass 'max tokens' worth of time from now.
+	 * 			This gives the same burst and rate behavior as TokenBucket (including zeroing the bucket
+	 * 			when exhausted), but the state is updated with a single CAS and nothing is written while
+	 * 			time passes, so its lock-free and much smaller.
+	 * 			When not auto-updating, the bucket sees time as it was on the last Update() call, so tokens
+	 * 			only replenish when updated. If replenish rate is 0 the bucket's time never moves, so it
+	 * 			never replenishes (like TokenBucket).
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class ClockT, class UpdateT>
+	class BasicGcraBucket
+	{
+	public:
+
+		/*! \brief	The clock this bucket measures time with. */
+		typedef ClockT Clock;
+
+		/*! \brief	The update policy of this bucket (if not auto, time passed to Consume() is ignored). */
+		typedef UpdateT UpdatePolicy;
+
+		/*! \brief	A callback we can attach to this bucket type to call when exhausted. */
+		typedef void(*Callback)(const BasicGcraBucket& bucket);
+
+	private:
+		// time the bucket will be full again, in nanoseconds since epoch.
+		std::atomic<int64_t> _full_time;
+
+		// time of last Update(), in nanoseconds since epoch (the bucket's time when not auto-updating).
+		std::atomic<int64_t> _update_time;
+
+		// total consumed tokens, in nanoseconds.
+		std::atomic<int64_t> _total_consumption;
+
+		// nanoseconds to replenish a single token (if bucket doesn't replenish, just the scale of a token).
+		double _ns_per_token;
+
+		// false if replenish rate is 0.
+		bool _replenishes;
+
+		// nanoseconds to replenish the whole bucket (max tokens).
+		int64_t _max_time;
+
+		// nanoseconds to replenish from starting tokens to max tokens.
+		int64_t _starting_time;
+
+		// time point that all buckets of this type count time from (shared, so copies stay exact).
+		static const typename ClockT::TimePoint& Epoch();
+
+		// get nanoseconds since epoch at a given time point.
+		static int64_t TimeAt(const typename ClockT::TimePoint& now);
+
+		// convert tokens to nanoseconds.
+		inline int64_t ToTime(double amount) const { return (int64_t)(amount * _ns_per_token); }
+
+		// get the bucket's current time, in nanoseconds since epoch (only reads the clock if auto-updating).
+		int64_t NowTime() const;
+
+		// get the bucket's time at a time point we already read.
+		int64_t NowTime(const typename ClockT::TimePoint& now) const;
+
+		// pull full time back by up to gain nanoseconds, and return how much was actually restored.
+		int64_t RestoreTime(int64_t gain);
+
+	public:
+
+		/*! \brief	Optional function to call when bucket runs out of tokens */
+		Callback OnBucketExhausted = nullptr;
+
+		/*!
+		 * \fn	GcraBucket::GcraBucket(double starting, double max, double replenish_rate);
+		 *
+		 * \brief	Constructor
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	starting	  	Starting tokens count.
+		 * \param	max			  	Max tokens allowed in bucket.
+		 * \param	replenish_rate	Tokens replenish rate (tokens per second, 0 to never replenish).
+		 */
+		BasicGcraBucket(double starting=0, double max=10, double replenish_rate=1);
+
+		/*!
+		 * \fn	GcraBucket::GcraBucket(const GcraBucket& other);
+		 *
+		 * \brief	Copy constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	other	The other object.
+		 */
+		BasicGcraBucket(const BasicGcraBucket& other);
+
+		/*!
+		 * \fn	const GcraBucket& GcraBucket::operator=(const GcraBucket& other);
+		 *
+		 * \brief	Assignment operator.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	other	The other object.
+		 *
+		 * \return	A shallow copy of this object.
+		 */
+		const BasicGcraBucket& operator=(const BasicGcraBucket& other);
+
+		/*!
+		 * \fn	bool GcraBucket::Consume(double amount = 1.0);
+		 *
+		 * \brief	Consumes the given amount of tokens.
+		 * 			If there are not enough tokens, will zero the bucket and invoke the callback from
+		 * 			the calling thread (once per failed consume, like TokenBucket does).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount to consume.
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount = 1.0);
+
+		/*!
+		 * \fn	bool GcraBucket::Consume(double amount, bool notify);
+		 *
+		 * \brief	Consumes the given amount of tokens, optionally without invoking the callback.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to consume.
+		 * \param	notify	If false, will not invoke the callback when exhausted (caller will do it).
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount, bool notify);
+
+		/*!
+		 * \fn	bool GcraBucket::Consume(double amount, const typename ClockT::TimePoint& now, bool notify);
+		 *
+		 * \brief	Consumes the given amount of tokens, using a time point we already read.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to consume.
+		 * \param	now   	Current time.
+		 * \param	notify	If false, will not invoke the callback when exhausted (caller will do it).
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount, const typename ClockT::TimePoint& now, bool notify);
+
+		/*!
+		 * \fn	void GcraBucket::Restore(double amount = 1.0);
+		 *
+		 * \brief	Restore tokens (up to max tokens).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount.
+		 */
+		void Restore(double amount = 1.0);
+
+		/*!
+		 * \fn	double GcraBucket::Take(double max_amount);
+		 *
+		 * \brief	Take up to max_amount tokens (or whatever is left, if less), without exhausting the bucket.
+		 * 			Never invokes the callback.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	max_amount	Max tokens to take.
+		 *
+		 * \return	How many tokens were taken.
+		 */
+		double Take(double max_amount);
+
+		/*!
+		 * \fn	void GcraBucket::Return(double amount);
+		 *
+		 * \brief	Return tokens that were taken but not used.
+		 * 			Unlike Restore(), this also removes them from the total consumption (only the tokens
+		 * 			that fit in the bucket are returned, so consumption matches the tokens it holds).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to return.
+		 */
+		void Return(double amount);
+
+		/*!
+		 * \fn	double GcraBucket::Reserve(double amount, double max_wait);
+		 *
+		 * \brief	Reserve tokens that may not be available yet, and get how long to wait until they are.
+		 * 			Pushes full time past max tokens worth of time, so Consume() fails until the reservation
+		 * 			is paid. Waiters are served in the order they reserved. Never invokes the callback.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount  	The amount to reserve.
+		 * \param	max_wait	Max seconds caller is willing to wait (if longer, nothing is reserved).
+		 *
+		 * \return	Seconds to wait before using the tokens (0 if available now), or -1 if not reserved.
+		 */
+		double Reserve(double amount, double max_wait);
+
+		/*!
+		 * \fn	bool GcraBucket::Test(double amount = 1.0) const;
+		 *
+		 * \brief	Test if got enough tokens (without consuming them).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount.
+		 *
+		 * \return	True if have enough tokens, false if not.
+		 */
+		bool Test(double amount = 1.0) const;
+
+		/*!
+		 * \fn	double GcraBucket::Count() const;
+		 *
+		 * \brief	Get current tokens count.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current tokens count.
+		 */
+		double Count() const;
+
+		/*!
+		 * \fn	inline double GcraBucket::MaxTokens() const
+		 *
+		 * \brief	Get the max tokens this bucket can hold.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Max tokens.
+		 */
+		inline double MaxTokens() const { return (double)_max_time / _ns_per_token; }
+
+		/*!
+		 * \fn	inline double GcraBucket::ReplenishRate() const
+		 *
+		 * \brief	Get how many tokens are added per second.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Replenish rate.
+		 */
+		inline double ReplenishRate() const { return _replenishes ? 1000000000.0 / _ns_per_token : 0; }
+
+		/*!
+		 * \fn	inline double GcraBucket::Peek() const
+		 *
+		 * \brief	Get current tokens count without writing anything (same as Count(), exists so the bucket can be used by managers).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current tokens count.
+		 */
+		inline double Peek() const { return Count(); }
+
+		/*!
+		 * \fn	inline double GcraBucket::TotalConsumed() const
+		 *
+		 * \brief	Get total tokens consumed from this bucket.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Total tokens consumed.
+		 */
+		inline double TotalConsumed() const { return (double)_total_consumption.load(std::memory_order_relaxed) / _ns_per_token; }
+
+		/*!
+		 * \fn	void GcraBucket::Reset();
+		 *
+		 * \brief	Resets this bucket to its starting value;
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Reset();
+
+		/*!
+		 * \fn	void GcraBucket::Update();
+		 *
+		 * \brief	Updates the tokens (moves the bucket's time to now).
+		 * 			Note: you do not need to call this function manually, unless you disable auto-update.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Update();
+	};
+
+	template <class ClockT, class UpdateT>
+	const typename ClockT::TimePoint& BasicGcraBucket<ClockT, UpdateT>::Epoch()
+	{
+		static const typename ClockT::TimePoint epoch = ClockT::Now();
+		return epoch;
+	}
+
+	template <class ClockT, class UpdateT>
+	int64_t BasicGcraBucket<ClockT, UpdateT>::TimeAt(const typename ClockT::TimePoint& now)
+	{
+		return (int64_t)(ClockT::DiffSeconds(Epoch(), now) * 1000000000.0);
+	}
+
+	template <class ClockT, class UpdateT>
+	int64_t BasicGcraBucket<ClockT, UpdateT>::NowTime() const
+	{
+		// only read the clock if we need it
+		if (!_replenishes || !UpdateT::Auto())
+			return _update_time.load(std::memory_order_relaxed);
+		return TimeAt(ClockT::Now());
+	}
+
+	template <class ClockT, class UpdateT>
+	int64_t BasicGcraBucket<ClockT, UpdateT>::NowTime(const typename ClockT::TimePoint& now) const
+	{
+		if (!_replenishes || !UpdateT::Auto())
+			return _update_time.load(std::memory_order_relaxed);
+		return TimeAt(now);
+	}
+
+	template <class ClockT, class UpdateT>
+	BasicGcraBucket<ClockT, UpdateT>::BasicGcraBucket(double starting, double max, double replenish_rate) :
+		_ns_per_token(replenish_rate > 0 ? 1000000000.0 / replenish_rate : 1000000000.0), _replenishes(replenish_rate > 0)
+	{
+		int64_t now_time = TimeAt(ClockT::Now());
+		_max_time = ToTime(max);
+		_starting_time = ToTime(max - (starting < max ? starting : max));
+		_update_time.store(now_time, std::memory_order_relaxed);
+		_total_consumption.store(0, std::memory_order_relaxed);
+		_full_time.store(now_time + _starting_time, std::memory_order_relaxed);
+	}
+
+	template <class ClockT, class UpdateT>
+	BasicGcraBucket<ClockT, UpdateT>::BasicGcraBucket(const BasicGcraBucket& other)
+	{
+		*this = other;
+	}
+
+	template <class ClockT, class UpdateT>
+	const BasicGcraBucket<ClockT, UpdateT>& BasicGcraBucket<ClockT, UpdateT>::operator=(const BasicGcraBucket& other)
+	{
+		_ns_per_token = other._ns_per_token;
+		_replenishes = other._replenishes;
+		_max_time = other._max_time;
+		_starting_time = other._starting_time;
+		_update_time.store(other._update_time.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		_total_consumption.store(other._total_consumption.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		_full_time.store(other._full_time.load(std::memory_order_acquire), std::memory_order_release);
+		OnBucketExhausted = other.OnBucketExhausted;
+		return *this;
+	}
+
+	template <class ClockT, class UpdateT>
+	bool BasicGcraBucket<ClockT, UpdateT>::Consume(double amount)
+	{
+		return Consume(amount, true);
+	}
+
+	template <class ClockT, class UpdateT>
+	bool BasicGcraBucket<ClockT, UpdateT>::Consume(double amount, bool notify)
+	{
+		// only read the clock if we need it
+		return Consume(amount, UpdateT::Auto() ? ClockT::Now() : typename ClockT::TimePoint(), notify);
+	}
+
+	template <class ClockT, class UpdateT>
+	bool BasicGcraBucket<ClockT, UpdateT>::Consume(double amount, const typename ClockT::TimePoint& now, bool notify)
+	{
+		int64_t now_time = NowTime(now);
+		int64_t cost = ToTime(amount);
+		int64_t full_time = _full_time.load(std::memory_order_acquire);
+		while (true)
+		{
+			// push full time forward by amount (if bucket is already full, start from now)
+			int64_t base = full_time > now_time ? full_time : now_time;
+			int64_t next = base + cost;
+
+			// passed max tokens worth of time? exhausted, so zero the bucket (never move full time backwards)
+			bool ret = next - now_time <= _max_time;
+			if (!ret)
+			{
+				next = now_time + _max_time;
+				if (next < full_time) next = full_time;
+			}
+
+			if (next == full_time || _full_time.compare_exchange_weak(full_time, next, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				// count what we took (when exhausted, whatever was left in the bucket)
+				if (next > base)
+					_total_consumption.fetch_add(next - base, std::memory_order_relaxed);
+
+				// only the thread that won the CAS gets here, so callback is invoked once per failed consume
+				if (!ret && notify && OnBucketExhausted)
+				{
+					OnBucketExhausted(*this);
+				}
+				return ret;
+			}
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	int64_t BasicGcraBucket<ClockT, UpdateT>::RestoreTime(int64_t gain)
+	{
+		int64_t now_time = NowTime();
+		int64_t full_time = _full_time.load(std::memory_order_acquire);
+		while (true)
+		{
+			// pull full time back, but not before now (can't pass max tokens)
+			int64_t next = full_time - gain;
+			if (next < now_time) next = now_time;
+			if (next >= full_time)
+				return 0;
+			if (_full_time.compare_exchange_weak(full_time, next, std::memory_order_acq_rel, std::memory_order_acquire))
+				return full_time - next;
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicGcraBucket<ClockT, UpdateT>::Restore(double amount)
+	{
+		RestoreTime(ToTime(amount));
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicGcraBucket<ClockT, UpdateT>::Return(double amount)
+	{
+		// only remove what was actually restored from consumption
+		int64_t returned = RestoreTime(ToTime(amount));
+		if (returned > 0)
+			_total_consumption.fetch_sub(returned, std::memory_order_relaxed);
+	}
+
+	template <class ClockT, class UpdateT>
+	double BasicGcraBucket<ClockT, UpdateT>::Take(double max_amount)
+	{
+		int64_t now_time = NowTime();
+		int64_t full_time = _full_time.load(std::memory_order_acquire);
+		while (true)
+		{
+			// take as much as we can
+			int64_t base = full_time > now_time ? full_time : now_time;
+			int64_t available = _max_time - (base - now_time);
+			int64_t taken = ToTime(max_amount);
+			if (taken > available) taken = available;
+			if (taken <= 0)
+				return 0;
+
+			if (_full_time.compare_exchange_weak(full_time, base + taken, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				_total_consumption.fetch_add(taken, std::memory_order_relaxed);
+				return (double)taken / _ns_per_token;
+			}
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	double BasicGcraBucket<ClockT, UpdateT>::Reserve(double amount, double max_wait)
+	{
+		int64_t now_time = NowTime();
+		int64_t cost = ToTime(amount);
+		int64_t full_time = _full_time.load(std::memory_order_acquire);
+		while (true)
+		{
+			// push full time forward like consume, but allow passing max tokens worth of time
+			int64_t next = (full_time > now_time ? full_time : now_time) + cost;
+			int64_t wait = next - now_time - _max_time;
+			if (wait < 0) wait = 0;
+
+			// can't wait for a bucket that never replenishes
+			if (wait > 0 && !_replenishes)
+				return -1;
+			if ((double)wait > max_wait * 1000000000.0)
+				return -1;
+
+			if (_full_time.compare_exchange_weak(full_time, next, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				_total_consumption.fetch_add(cost, std::memory_order_relaxed);
+				return (double)wait / 1000000000.0;
+			}
+		}
+	}
+
+	template <class ClockT, class UpdateT>
+	double BasicGcraBucket<ClockT, UpdateT>::Count() const
+	{
+		int64_t now_time = NowTime();
+		int64_t full_time = _full_time.load(std::memory_order_acquire);
+		int64_t missing = full_time > now_time ? full_time - now_time : 0;
+		return (double)(_max_time - missing) / _ns_per_token;
+	}
+
+	template <class ClockT, class UpdateT>
+	bool BasicGcraBucket<ClockT, UpdateT>::Test(double amount) const
+	{
+		return Count() >= amount;
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicGcraBucket<ClockT, UpdateT>::Update()
+	{
+		// bucket that never replenishes keeps its time
+		if (!_replenishes)
+			return;
+
+		// move time forward (never backwards, if another thread already updated past us)
+		int64_t now_time = TimeAt(ClockT::Now());
+		int64_t update_time = _update_time.load(std::memory_order_relaxed);
+		while (update_time < now_time && !_update_time.compare_exchange_weak(update_time, now_time, std::memory_order_relaxed)) {}
+	}
+
+	template <class ClockT, class UpdateT>
+	void BasicGcraBucket<ClockT, UpdateT>::Reset()
+	{
+		_full_time.store(NowTime() + _starting_time, std::memory_order_release);
+	}
+
+	// the default bucket is compiled once, in GcraBucket.cpp
+	extern template class BasicGcraBucket<AccurateClock>;
+}
@@ -0,0 +1,7 @@
+#include "LazyTokenBucket.h"
+
+namespace BucketAlerts
+{
+	// compile the default bucket once
+	template class BasicLazyTokenBucket<AccurateClock>;
+}
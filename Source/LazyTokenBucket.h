@@ -0,0 +1,557 @@
+/*!
+ * \file	Source\LazyTokenBucket.h.
+ *
+ * \brief	Declares a token bucket that calculates its tokens on demand.
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "Clock.h"
+#include "Policies.h"
+
+
+namespace BucketAlerts
+{
+	// predef
+	template <class ClockT = AccurateClock, class ThreadingT = RuntimeThreading, class UpdateT = RuntimeUpdate>
+	class BasicLazyTokenBucket;
+
+	/*!
+	 * \typedef	BasicLazyTokenBucket<AccurateClock> LazyTokenBucket
+	 *
+	 * \brief	The default lazy token bucket, using the accurate clock.
+	 */
+	typedef BasicLazyTokenBucket<AccurateClock> LazyTokenBucket;
+
+	/*!
+	 * \typedef	void(*LazyBucketCallback)(const LazyTokenBucket& bucket)
+	 *
+	 * \brief	A callback we can attach to a lazy bucket to call when exhausted.
+	 */
+	typedef void(*LazyBucketCallback)(const LazyTokenBucket& bucket);
+
+	/*!
+	 * \class	BasicLazyTokenBucket
+	 *
+	 * \brief	A token bucket that doesn't replenish by writing new tokens count, but instead only stores
+	 * 			an anchor ("had X tokens at time T") and calculates current tokens when asked.
+	 * 			This makes Count() and Test() accurate and read-only (they never write shared memory
+	 * 			or take a lock, readers use a sequence lock), while writes only happen when tokens are
+	 * 			consumed or restored.
+	 * 			If UpdateT::Auto() is false, tokens are only replenished when calling Update(), just
+	 * 			like with TokenBucket. Threading and auto-update are policies (see Policies.h).
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class ClockT, class ThreadingT, class UpdateT>
+	class BasicLazyTokenBucket
+	{
+	public:
+
+		/*! \brief	The clock this bucket measures time with. */
+		typedef ClockT Clock;
+
+		/*! \brief	The update policy of this bucket (if not auto, time passed to Consume() is ignored). */
+		typedef UpdateT UpdatePolicy;
+
+		/*! \brief	The threading policy of this bucket. */
+		typedef ThreadingT Threading;
+
+		/*! \brief	A callback we can attach to this bucket type to call when exhausted. */
+		typedef void(*Callback)(const BasicLazyTokenBucket& bucket);
+
+	private:
+		// sequence counter for readers (odd while anchor is being written).
+		std::atomic<uint32_t> _sequence;
+
+		// tokens we had at anchor time.
+		std::atomic<double> _anchor_tokens;
+
+		// anchor time, in nanoseconds since epoch.
+		std::atomic<int64_t> _anchor_time;
+
+		// total tokens consumed since created.
+		std::atomic<double> _total_consumption;
+
+		// how many new tokens we get per second.
+		double _replenish_rate;
+
+		// max tokens allowed in bucket.
+		double _max_tokens;
+
+		// starting value.
+		double _starting_count;
+
+		// time point that anchor time is counted from.
+		typename ClockT::TimePoint _epoch;
+
+		// mutex for writers (does nothing if single threaded)
+		typename ThreadingT::Mutex _mtx;
+
+		// get nanoseconds since epoch.
+		int64_t NowTime() const;
+
+		// get nanoseconds since epoch at a given time point.
+		int64_t TimeAt(const typename ClockT::TimePoint& now) const;
+
+		// calculate tokens at a given time from anchor values.
+		double TokensAt(double anchor_tokens, int64_t anchor_time, int64_t now_time) const;
+
+		// read anchor consistently (without writing anything).
+		void ReadAnchor(double& tokens, int64_t& time) const;
+
+		// write new anchor. must be called by a single writer at a time.
+		void WriteAnchor(double tokens, int64_t time);
+
+	public:
+
+		/*! \brief	Optional function to call when bucket runs out of tokens */
+		Callback OnBucketExhausted = nullptr;
+
+		/*!
+		 * \fn	LazyTokenBucket::LazyTokenBucket(double starting, double max, double replenish_rate);
+		 *
+		 * \brief	Constructor
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	starting	  	Starting tokens count.
+		 * \param	max			  	Max tokens allowed in bucket.
+		 * \param	replenish_rate	Tokens replenish rate (tokens per second).
+		 */
+		BasicLazyTokenBucket(double starting=0, double max=10, double replenish_rate=1);
+
+		/*!
+		 * \fn	LazyTokenBucket::LazyTokenBucket(const LazyTokenBucket& other);
+		 *
+		 * \brief	Copy constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	other	The other object.
+		 */
+		BasicLazyTokenBucket(const BasicLazyTokenBucket& other);
+
+		/*!
+		 * \fn	const LazyTokenBucket& LazyTokenBucket::operator=(const LazyTokenBucket& other);
+		 *
+		 * \brief	Assignment operator.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	other	The other object.
+		 *
+		 * \return	A shallow copy of this object.
+		 */
+		const BasicLazyTokenBucket& operator=(const BasicLazyTokenBucket& other);
+
+		/*!
+		 * \fn	bool LazyTokenBucket::Consume(double amount = 1.0);
+		 *
+		 * \brief	Consumes the given amount of tokens.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount to consume.
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount = 1.0);
+
+		/*!
+		 * \fn	bool LazyTokenBucket::Consume(double amount, bool notify);
+		 *
+		 * \brief	Consumes the given amount of tokens, optionally without invoking the callback.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to consume.
+		 * \param	notify	If false, will not invoke the callback when exhausted (caller will do it).
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount, bool notify);
+
+		/*!
+		 * \fn	bool LazyTokenBucket::Consume(double amount, const typename ClockT::TimePoint& now, bool notify);
+		 *
+		 * \brief	Consumes the given amount of tokens, using a time point we already read.
+		 * 			Useful when consuming many buckets at once, to read the clock only once.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to consume.
+		 * \param	now   	Current time (ignored if auto-update is off).
+		 * \param	notify	If false, will not invoke the callback when exhausted (caller will do it).
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount, const typename ClockT::TimePoint& now, bool notify);
+
+		/*!
+		 * \fn	void LazyTokenBucket::Restore(double amount = 1.0);
+		 *
+		 * \brief	Restore the given amount of tokens.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount to restore.
+		 */
+		void Restore(double amount = 1.0);
+
+		/*!
+		 * \fn	void LazyTokenBucket::Return(double amount);
+		 *
+		 * \brief	Return tokens that were taken but not used.
+		 * 			Unlike Restore(), this also removes them from the total consumption (only the tokens
+		 * 			that fit in the bucket are returned, so consumption matches the tokens it holds).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to return.
+		 */
+		void Return(double amount);
+
+		/*!
+		 * \fn	bool LazyTokenBucket::Test(double amount = 1.0) const;
+		 *
+		 * \brief	Tests if have enough tokens to consume (including tokens replenished since last write).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount.
+		 *
+		 * \return	True if have enough tokens, false if not.
+		 */
+		bool Test(double amount = 1.0) const;
+
+		/*!
+		 * \fn	double LazyTokenBucket::Count() const;
+		 *
+		 * \brief	Get current tokens count, without writing anything.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current tokens count.
+		 */
+		double Count() const;
+
+		/*!
+		 * \fn	double LazyTokenBucket::TotalConsumed() const
+		 *
+		 * \brief	Return how many tokens were consumed in total.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	The total number of consumed token since the creation of this bucket.
+		 */
+		double TotalConsumed() const { return _total_consumption.load(std::memory_order_relaxed); }
+
+		/*!
+		 * \fn	inline double LazyTokenBucket::MaxTokens() const
+		 *
+		 * \brief	Get the max tokens this bucket can hold.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Max tokens.
+		 */
+		inline double MaxTokens() const { return _max_tokens; }
+
+		/*!
+		 * \fn	inline double LazyTokenBucket::ReplenishRate() const
+		 *
+		 * \brief	Get how many tokens are added per second.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Replenish rate.
+		 */
+		inline double ReplenishRate() const { return _replenish_rate; }
+
+		/*!
+		 * \fn	inline double LazyTokenBucket::Peek() const
+		 *
+		 * \brief	Get current tokens count without writing anything (same as Count(), exists so the bucket can be used by managers).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current tokens count.
+		 */
+		inline double Peek() const { return Count(); }
+
+		/*!
+		 * \fn	void LazyTokenBucket::Reset();
+		 *
+		 * \brief	Resets this bucket to its starting value;
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Reset();
+
+		/*!
+		 * \fn	void LazyTokenBucket::Update();
+		 *
+		 * \brief	Move the anchor to current time, replenishing tokens.
+		 * 			Note: you only need this if you disable auto-update, otherwise tokens are calculated on demand.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Update();
+	};
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::BasicLazyTokenBucket(double starting, double max, double replenish_rate) :
+		_replenish_rate(replenish_rate), _max_tokens(max), _starting_count(starting)
+	{
+		_epoch = ClockT::Now();
+		_sequence.store(0, std::memory_order_relaxed);
+		_anchor_tokens.store(starting, std::memory_order_relaxed);
+		_anchor_time.store(0, std::memory_order_relaxed);
+		_total_consumption.store(0, std::memory_order_relaxed);
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::BasicLazyTokenBucket(const BasicLazyTokenBucket& other)
+	{
+		_sequence.store(0, std::memory_order_relaxed);
+		*this = other;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	const BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>& BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::operator=(const BasicLazyTokenBucket& other)
+	{
+		double tokens;
+		int64_t time;
+		other.ReadAnchor(tokens, time);
+
+		_replenish_rate = other._replenish_rate;
+		_max_tokens = other._max_tokens;
+		_starting_count = other._starting_count;
+		_epoch = other._epoch;
+		_total_consumption.store(other.TotalConsumed(), std::memory_order_relaxed);
+		OnBucketExhausted = other.OnBucketExhausted;
+		WriteAnchor(tokens, time);
+		return *this;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	int64_t BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::NowTime() const
+	{
+		return TimeAt(ClockT::Now());
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	int64_t BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::TimeAt(const typename ClockT::TimePoint& now) const
+	{
+		return (int64_t)(ClockT::DiffSeconds(_epoch, now) * 1000000000.0);
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	double BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::TokensAt(double anchor_tokens, int64_t anchor_time, int64_t now_time) const
+	{
+		// no time passed since anchor? nothing to add
+		if (now_time <= anchor_time)
+			return anchor_tokens;
+
+		// add tokens and limit to max
+		double ret = anchor_tokens + (double)(now_time - anchor_time) / 1000000000.0 * _replenish_rate;
+		return ret > _max_tokens ? _max_tokens : ret;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::ReadAnchor(double& tokens, int64_t& time) const
+	{
+		// sequence lock read: retry if a writer was active or finished while we were reading
+		while (true)
+		{
+			uint32_t before = _sequence.load(std::memory_order_acquire);
+			if (before & 1)
+				continue;
+
+			tokens = _anchor_tokens.load(std::memory_order_relaxed);
+			time = _anchor_time.load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (_sequence.load(std::memory_order_relaxed) == before)
+				return;
+		}
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::WriteAnchor(double tokens, int64_t time)
+	{
+		// sequence lock write: odd sequence while writing
+		uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+		_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		_anchor_tokens.store(tokens, std::memory_order_relaxed);
+		_anchor_time.store(time, std::memory_order_relaxed);
+
+		_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Update()
+	{
+		int64_t now = NowTime();
+
+		_mtx.lock();
+		int64_t time = _anchor_time.load(std::memory_order_relaxed);
+		if (now > time)
+			WriteAnchor(TokensAt(_anchor_tokens.load(std::memory_order_relaxed), time, now), now);
+		_mtx.unlock();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Restore(double amount)
+	{
+		bool auto_update = UpdateT::Auto();
+		int64_t now = auto_update ? NowTime() : 0;
+
+		_mtx.lock();
+
+		// get current tokens (and anchor time to write)
+		double tokens = _anchor_tokens.load(std::memory_order_relaxed);
+		int64_t time = _anchor_time.load(std::memory_order_relaxed);
+		if (auto_update && now > time)
+		{
+			tokens = TokensAt(tokens, time, now);
+			time = now;
+		}
+
+		// add tokens and make sure didn't pass max
+		tokens += amount;
+		if (tokens > _max_tokens)
+			tokens = _max_tokens;
+		WriteAnchor(tokens, time);
+
+		_mtx.unlock();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Return(double amount)
+	{
+		bool auto_update = UpdateT::Auto();
+		int64_t now = auto_update ? NowTime() : 0;
+
+		_mtx.lock();
+
+		// get current tokens (and anchor time to write)
+		double tokens = _anchor_tokens.load(std::memory_order_relaxed);
+		int64_t time = _anchor_time.load(std::memory_order_relaxed);
+		if (auto_update && now > time)
+		{
+			tokens = TokensAt(tokens, time, now);
+			time = now;
+		}
+
+		// add tokens (limited to max) and remove only what was actually added from consumption
+		double returned = _max_tokens - tokens;
+		if (returned > amount)
+			returned = amount;
+		if (returned > 0)
+		{
+			WriteAnchor(tokens + returned, time);
+			_total_consumption.store(_total_consumption.load(std::memory_order_relaxed) - returned, std::memory_order_relaxed);
+		}
+
+		_mtx.unlock();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	bool BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Consume(double amount)
+	{
+		return Consume(amount, true);
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	bool BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Consume(double amount, bool notify)
+	{
+		// only read the clock if we need it
+		return Consume(amount, UpdateT::Auto() ? ClockT::Now() : typename ClockT::TimePoint(), notify);
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	bool BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Consume(double amount, const typename ClockT::TimePoint& now_point, bool notify)
+	{
+		bool auto_update = UpdateT::Auto();
+		int64_t now = auto_update ? TimeAt(now_point) : 0;
+
+		_mtx.lock();
+
+		// get current tokens (and anchor time to write)
+		double tokens = _anchor_tokens.load(std::memory_order_relaxed);
+		int64_t time = _anchor_time.load(std::memory_order_relaxed);
+		if (auto_update && now > time)
+		{
+			tokens = TokensAt(tokens, time, now);
+			time = now;
+		}
+
+		// if got enough to consume reduce tokens, if not zero them
+		bool ret = tokens >= amount;
+		double consumed = ret ? amount : tokens;
+		_total_consumption.store(_total_consumption.load(std::memory_order_relaxed) + consumed, std::memory_order_relaxed);
+		WriteAnchor(tokens - consumed, time);
+
+		// release the lock before calling the callback
+		_mtx.unlock();
+
+		// invoke callback
+		if (!ret && notify && OnBucketExhausted)
+		{
+			OnBucketExhausted(*this);
+		}
+
+		return ret;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	double BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Count() const
+	{
+		double tokens;
+		int64_t time;
+		ReadAnchor(tokens, time);
+		return UpdateT::Auto() ? TokensAt(tokens, time, NowTime()) : tokens;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	bool BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Test(double amount) const
+	{
+		return Count() >= amount;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicLazyTokenBucket<ClockT, ThreadingT, UpdateT>::Reset()
+	{
+		// reset also moves the anchor to now, so we won't add the time passed before the reset
+		int64_t now = NowTime();
+
+		_mtx.lock();
+		WriteAnchor(_starting_count, now);
+		_mtx.unlock();
+	}
+
+	// the default bucket is compiled once, in LazyTokenBucket.cpp
+	extern template class BasicLazyTokenBucket<AccurateClock>;
+}
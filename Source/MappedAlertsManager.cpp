@@ -0,0 +1,380 @@
+#include "MappedAlertsManager.h"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+namespace BucketAlerts
+{
+	// the layout must be the same in every build that opens the file
+	static_assert(sizeof(MappedAlertsManager::FileHeader) == 64, "unexpected file header layout");
+	static_assert(sizeof(MappedAlertsManager::Record) == 48, "unexpected record layout");
+	static_assert(std::atomic<int64_t>::is_always_lock_free && std::atomic<double>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+		"mapped records need lock-free (and so process-shared) atomics");
+
+	// how many times to wait for a claimed state before checking if its process died
+	static const unsigned int ClaimedWaitTries = 1024;
+
+	// magic bytes at the beginning of the file
+	static const char FileMagic[8] = { 'B', 'K', 'T', 'A', 'L', 'R', 'T', 'S' };
+
+	// default bucket params (same as TokenBucket)
+	static const double DefaultStartingTokens = 0;
+	static const double DefaultMaxTokens = 10;
+	static const double DefaultReplenishRate = 1;
+
+	int64_t MappedAlertsManager::Now()
+	{
+		return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	uint64_t MappedAlertsManager::HeaderChecksum(const FileHeader& header)
+	{
+		// FNV-1a over all fields before the checksum
+		const unsigned char* bytes = (const unsigned char*)&header;
+		uint64_t ret = 0xcbf29ce484222325ULL;
+		for (size_t i = 0; i < offsetof(FileHeader, Checksum); ++i)
+		{
+			ret ^= bytes[i];
+			ret *= 0x100000001b3ULL;
+		}
+		return ret;
+	}
+
+	// get file size for a capacity: header + table, which is a power of 2 with room for capacity at 3/4 load
+	static size_t FileSize(size_t capacity)
+	{
+		size_t table_size = 16;
+		while (table_size / 4 * 3 < capacity)
+			table_size <<= 1;
+		return sizeof(MappedAlertsManager::FileHeader) + table_size * sizeof(MappedAlertsManager::Record);
+	}
+
+	bool MappedAlertsManager::Open(const char* path, size_t capacity)
+	{
+		Close();
+		bool created;
+		return _file.Open(path, FileSize(capacity), created) && Attach();
+	}
+
+	bool MappedAlertsManager::OpenShared(const char* name, size_t capacity)
+	{
+		Close();
+		bool created;
+		return _file.OpenShared(name, FileSize(capacity), created) && Attach();
+	}
+
+	bool MappedAlertsManager::RemoveShared(const char* name)
+	{
+		return MappedFile::RemoveShared(name);
+	}
+
+	uint64_t MappedAlertsManager::Settle(std::atomic<uint64_t>& state, std::atomic<uint64_t>* count)
+	{
+		uint64_t ret = state.load(std::memory_order_acquire);
+		for (unsigned int tries = 1; StatusOf(ret) == Status::Claimed; ++tries)
+		{
+			// claims are short, so only check once in a while if the claiming process died
+			if (tries % ClaimedWaitTries == 0 && !MappedFile::ProcessAlive(ProcessOf(ret)))
+			{
+				uint64_t abandoned = MakeState(Status::Abandoned, ProcessOf(ret));
+				if (state.compare_exchange_strong(ret, abandoned, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					if (count) count->fetch_add(1, std::memory_order_relaxed);
+					return abandoned;
+				}
+				continue;
+			}
+			std::this_thread::yield();
+			ret = state.load(std::memory_order_acquire);
+		}
+		return ret;
+	}
+
+	bool MappedAlertsManager::Attach()
+	{
+		FileHeader* header = (FileHeader*)_file.Data();
+		size_t size = _file.Size();
+		bool valid = size >= FileSize(0);
+
+		// new file (all zero)? initialize its header (if another process died while initializing it, take over).
+		// files of older versions have no header state, but they have a magic, so they're rejected and not initialized.
+		bool initialized = false;
+		while (valid)
+		{
+			uint64_t state = Settle(header->State, nullptr);
+			if (StatusOf(state) == Status::Ready)
+				break;
+
+			if (StatusOf(state) == Status::Empty && header->Magic[0] != 0)
+			{
+				std::atomic_thread_fence(std::memory_order_acquire);
+				valid = header->State.load(std::memory_order_acquire) != state;
+				continue;
+			}
+
+			uint32_t process = MappedFile::ProcessId();
+			if (header->State.compare_exchange_strong(state, MakeState(Status::Claimed, process), std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				// table size is the largest power of 2 that fits (segments may be rounded up to pages)
+				size_t table_size = 16;
+				while (sizeof(FileHeader) + table_size * 2 * sizeof(Record) <= size)
+					table_size <<= 1;
+				std::memcpy(header->Magic, FileMagic, sizeof(FileMagic));
+				header->Version = FileVersion;
+				header->HeaderSize = sizeof(FileHeader);
+				header->RecordSize = sizeof(Record);
+				header->ByteOrder = 0x01020304;
+				header->Capacity = table_size;
+				header->Checksum = HeaderChecksum(*header);
+				header->Count.store(0, std::memory_order_relaxed);
+				header->State.store(MakeState(Status::Ready, process), std::memory_order_release);
+				initialized = true;
+				break;
+			}
+		}
+
+		// make sure its compatible
+		valid = valid &&
+			std::memcmp(header->Magic, FileMagic, sizeof(FileMagic)) == 0 &&
+			header->Checksum == HeaderChecksum(*header) &&
+			header->Version == FileVersion &&
+			header->HeaderSize == sizeof(FileHeader) &&
+			header->RecordSize == sizeof(Record) &&
+			header->ByteOrder == 0x01020304 &&
+			header->Capacity >= 16 && (header->Capacity & (header->Capacity - 1)) == 0 &&
+			header->Capacity <= (size - sizeof(FileHeader)) / sizeof(Record);
+		if (!valid)
+		{
+			_file.Close();
+			return false;
+		}
+
+		_header = header;
+		_records = (Record*)((char*)_file.Data() + sizeof(FileHeader));
+		_mask = (size_t)header->Capacity - 1;
+		_resumed = !initialized;
+		return true;
+	}
+
+	void MappedAlertsManager::Close()
+	{
+		_file.Close();
+		_header = nullptr;
+		_records = nullptr;
+		_mask = 0;
+		_resumed = false;
+	}
+
+	MappedAlertsManager::Record* MappedAlertsManager::Find(BucketKey key) const
+	{
+		// linear probing until empty record. records are never removed (except by Clear), so this is safe without locking.
+		// records that are being created may be ours, so we wait for them.
+		for (size_t i = (size_t)HashBucketKey(key) & _mask; ; i = (i + 1) & _mask)
+		{
+			Record& record = _records[i];
+			uint64_t state = record.State.load(std::memory_order_acquire);
+			if (StatusOf(state) == Status::Claimed)
+				state = Settle(record.State, &_header->Count);
+			if (StatusOf(state) == Status::Empty)
+				return nullptr;
+			if (StatusOf(state) == Status::Ready && record.Key == key)
+				return &record;
+		}
+	}
+
+	MappedAlertsManager::Record* MappedAlertsManager::FindOrCreate(BucketKey key, double starting_tokens, double max_tokens, double replenish_rate, bool& created)
+	{
+		created = false;
+		if (!_header)
+			return nullptr;
+
+		// find existing record
+		Record* ret = Find(key);
+		if (ret)
+			return ret;
+
+		// create it: claim the first empty or abandoned record in its probe sequence, then fill it and only then publish it.
+		// if another thread or process claims it first, check it again (it may have created our key).
+		for (size_t i = (size_t)HashBucketKey(key) & _mask; ; i = (i + 1) & _mask)
+		{
+			Record& record = _records[i];
+			while (true)
+			{
+				uint64_t state = Settle(record.State, &_header->Count);
+				if (StatusOf(state) == Status::Ready && record.Key == key)
+					return &record;
+				// abandoned records (their process died while creating them) are reused like empty ones.
+				// they are already counted, so reusing them never fills the table.
+				bool abandoned = StatusOf(state) == Status::Abandoned;
+				if (StatusOf(state) != Status::Empty && !abandoned)
+					break;
+
+				// full? (we keep a quarter of the table empty, so probing stays short)
+				if (!abandoned && _header->Count.load(std::memory_order_relaxed) >= Capacity())
+					return nullptr;
+
+				uint32_t process = MappedFile::ProcessId();
+				if (!record.State.compare_exchange_strong(state, MakeState(Status::Claimed, process), std::memory_order_acq_rel, std::memory_order_acquire))
+					continue;
+
+				// claimed records are not counted (if we die now, whoever marks it abandoned counts it again)
+				if (abandoned)
+					_header->Count.fetch_sub(1, std::memory_order_relaxed);
+				record.Key = key;
+				SetParams(record, starting_tokens, max_tokens, replenish_rate, true, Now());
+				record.State.store(MakeState(Status::Ready, process), std::memory_order_release);
+				_header->Count.fetch_add(1, std::memory_order_relaxed);
+				created = true;
+				return &record;
+			}
+		}
+	}
+
+	void MappedAlertsManager::SetParams(Record& record, double starting_tokens, double max_tokens, double replenish_rate, bool reset, int64_t now)
+	{
+		double ns_per_token = 1000000000.0 / replenish_rate;
+		int64_t starting_time = (int64_t)((max_tokens - std::min(starting_tokens, max_tokens)) * ns_per_token);
+		record.NsPerToken.store(ns_per_token, std::memory_order_relaxed);
+		record.MaxTime.store((int64_t)(max_tokens * ns_per_token), std::memory_order_relaxed);
+		record.StartingTime.store(starting_time, std::memory_order_relaxed);
+		if (reset)
+			record.FullTime.store(now + starting_time, std::memory_order_relaxed);
+	}
+
+	bool MappedAlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate)
+	{
+		if (replenish_rate <= 0)
+			return false;
+
+		// create it, or update params of existing bucket (and keep its tokens)
+		bool created;
+		Record* record = FindOrCreate(MakeBucketKey(cat_id, bucket_id), starting_tokens, max_tokens, replenish_rate, created);
+		if (!record)
+			return false;
+		if (!created)
+			SetParams(*record, starting_tokens, max_tokens, replenish_rate, false, 0);
+		return true;
+	}
+
+	bool MappedAlertsManager::CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate)
+	{
+		return CreateBucket(Defs::DefaultCategoryId, bucket_id, starting_tokens, max_tokens, replenish_rate);
+	}
+
+	bool MappedAlertsManager::Consume(CategoryId cat_id, BucketId bucket_id, double amount)
+	{
+		// skip if disabled
+		if (!Enabled)
+			return true;
+
+		// get bucket (can't track it? let it pass)
+		bool created;
+		Record* record = FindOrCreate(MakeBucketKey(cat_id, bucket_id), DefaultStartingTokens, DefaultMaxTokens, DefaultReplenishRate, created);
+		if (!record)
+			return true;
+
+		// push full time forward by amount, like GcraBucket does
+		int64_t now = Now();
+		int64_t cost = (int64_t)(amount * record->NsPerToken.load(std::memory_order_relaxed));
+		int64_t max_time = record->MaxTime.load(std::memory_order_relaxed);
+		int64_t full_time = record->FullTime.load(std::memory_order_acquire);
+		bool ret;
+		while (true)
+		{
+			int64_t next = std::max(full_time, now) + cost;
+
+			// exhausted? zero the bucket, or reset it to starting tokens (never move full time backwards)
+			ret = next - now <= max_time;
+			if (!ret)
+			{
+				next = now + (Defs::ResetWhenConsumed ? record->StartingTime.load(std::memory_order_relaxed) : max_time);
+				if (next < full_time) next = full_time;
+			}
+
+			if (next == full_time || record->FullTime.compare_exchange_weak(full_time, next, std::memory_order_acq_rel, std::memory_order_acquire))
+				break;
+		}
+
+		// exhausted? invoke callback
+		if (!ret)
+		{
+			MappedBucketCallback callback = OnBucketExhausted;
+			if (callback)
+				callback(cat_id, bucket_id);
+		}
+		return ret;
+	}
+
+	bool MappedAlertsManager::Consume(BucketId bucket_id, double amount)
+	{
+		return Consume(Defs::DefaultCategoryId, bucket_id, amount);
+	}
+
+	void MappedAlertsManager::Restore(CategoryId cat_id, BucketId bucket_id, double amount)
+	{
+		bool created;
+		Record* record = FindOrCreate(MakeBucketKey(cat_id, bucket_id), DefaultStartingTokens, DefaultMaxTokens, DefaultReplenishRate, created);
+		if (!record)
+			return;
+
+		// pull full time back, but not before now (can't pass max tokens)
+		int64_t now = Now();
+		int64_t gain = (int64_t)(amount * record->NsPerToken.load(std::memory_order_relaxed));
+		int64_t full_time = record->FullTime.load(std::memory_order_acquire);
+		while (true)
+		{
+			int64_t next = std::max(full_time - gain, now);
+			if (next >= full_time || record->FullTime.compare_exchange_weak(full_time, next, std::memory_order_acq_rel, std::memory_order_acquire))
+				return;
+		}
+	}
+
+	double MappedAlertsManager::Count(CategoryId cat_id, BucketId bucket_id)
+	{
+		if (!_header)
+			return 0;
+		Record* record = Find(MakeBucketKey(cat_id, bucket_id));
+		if (!record)
+			return 0;
+
+		int64_t now = Now();
+		int64_t missing = std::max<int64_t>(record->FullTime.load(std::memory_order_acquire) - now, 0);
+		return (double)(record->MaxTime.load(std::memory_order_relaxed) - missing) / record->NsPerToken.load(std::memory_order_relaxed);
+	}
+
+	void MappedAlertsManager::ResetAll()
+	{
+		if (!_header)
+			return;
+
+		int64_t now = Now();
+		for (size_t i = 0; i <= _mask; ++i)
+		{
+			Record& record = _records[i];
+			if (StatusOf(record.State.load(std::memory_order_acquire)) == Status::Ready)
+				record.FullTime.store(now + record.StartingTime.load(std::memory_order_relaxed), std::memory_order_release);
+		}
+	}
+
+	void MappedAlertsManager::Clear()
+	{
+		if (!_header)
+			return;
+
+		for (size_t i = 0; i <= _mask; ++i)
+			_records[i].State.store(0, std::memory_order_relaxed);
+		_header->Count.store(0, std::memory_order_release);
+	}
+
+	bool MappedAlertsManager::Sync()
+	{
+		return _file.Sync();
+	}
+
+	size_t MappedAlertsManager::BucketsCount() const
+	{
+		return _header ? (size_t)_header->Count.load(std::memory_order_relaxed) : 0;
+	}
+}
@@ -0,0 +1,445 @@
+/*!
+ * \file	Source\MappedAlertsManager.h.
+ *
+ * \brief	Declares an alerts manager that keeps its buckets in a memory-mapped file or shared memory, so they survive restarts and can be shared by processes.
+ */
+#pragma once
+#include "Defs.h"
+#include "MappedFile.h"
+#include <atomic>
+#include <cstdint>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \typedef	void(*MappedBucketCallback)(CategoryId cat_id, BucketId bucket_id)
+	 *
+	 * \brief	A callback to call when a bucket in a mapped alerts manager is exhausted.
+	 */
+	typedef void(*MappedBucketCallback)(CategoryId cat_id, BucketId bucket_id);
+
+	/*!
+	 * \class	MappedAlertsManager
+	 *
+	 * \brief	An alerts manager that keeps all buckets state in a memory-mapped file with a fixed binary
+	 * 			layout, so a restarted process remaps it and resumes where it stopped, instead of rebuilding
+	 * 			all buckets from their starting values.
+	 *
+	 * 			Every bucket is a GCRA record (see GcraBucket.h): its state is the wall-clock time it will be
+	 * 			full again, so tokens replenish while the process is down too, and resuming needs no work at all.
+	 * 			Records live in an open-addressing table inside the file, which is sized when the file is
+	 * 			created and never grows. Consuming and creating buckets are both lock-free.
+	 *
+	 * 			Several processes can open the same file, or the same shared memory segment (see OpenShared()),
+	 * 			and consume from the same buckets. The file holds no pointers, only process-shared atomics.
+	 * 			A process creating a bucket claims its record with its process id first. If it dies before
+	 * 			the record is ready, other processes detect it and mark the record abandoned, so they never
+	 * 			wait on it again, and the next bucket created in its probe sequence reuses it. The same goes
+	 * 			for the file header. Liveness is checked by process id, so if the id is reused by a new process
+	 * 			before anyone checks, the record looks claimed until that process exits too.
+	 *
+	 * 			The file starts with a header (magic, layout version, record size, byte order, capacity and
+	 * 			a checksum of all of them), and files that don't match are rejected rather than reinterpreted.
+	 *
+	 * 			Limitations:
+	 * 			- Replenish rate must be positive, and total consumed tokens are not tracked.
+	 * 			- Time is wall-clock (steady clocks restart with the machine), so moving the system clock
+	 * 			  backwards makes buckets look emptier until it catches up.
+	 * 			- Callbacks can't be stored in a file, so there's a single manager-level callback with ids,
+	 * 			  invoked by the process that exhausted the bucket.
+	 * 			- Buckets can't be removed one by one, and Clear() must not run while other processes use the file.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class MappedAlertsManager
+	{
+	public:
+
+		/*! \brief	Version of the file layout. Files with a different version are rejected. */
+		static const uint32_t FileVersion = 2;
+
+		/*! \brief	Status of a record or the header, in the low bits of its state (the high bits are the owner process id). */
+		enum class Status : uint32_t
+		{
+			/*! \brief	Not used yet (or header not initialized yet). */
+			Empty = 0,
+
+			/*! \brief	Claimed by a process that is filling it. */
+			Claimed = 1,
+
+			/*! \brief	Ready to use. */
+			Ready = 2,
+
+			/*! \brief	Its process died while filling it, so its skipped (and reused by the next bucket created there). */
+			Abandoned = 3,
+		};
+
+		/*!
+		 * \struct	FileHeader
+		 *
+		 * \brief	Header at the beginning of the file.
+		 */
+		struct FileHeader
+		{
+			/*! \brief	Magic bytes, "BKTALRTS". */
+			char Magic[8];
+
+			/*! \brief	Layout version (FileVersion). */
+			uint32_t Version;
+
+			/*! \brief	Size of this header. */
+			uint32_t HeaderSize;
+
+			/*! \brief	Size of a bucket record. */
+			uint32_t RecordSize;
+
+			/*! \brief	0x01020304 as written by the machine that created the file (rejects other byte orders). */
+			uint32_t ByteOrder;
+
+			/*! \brief	Max records in file (power of 2). */
+			uint64_t Capacity;
+
+			/*! \brief	Checksum of all fields above. */
+			uint64_t Checksum;
+
+			/*! \brief	Records in use (abandoned records included). */
+			std::atomic<uint64_t> Count;
+
+			/*! \brief	Header status and the process id that initialized it. */
+			std::atomic<uint64_t> State;
+
+			/*! \brief	Padding to cache line. */
+			uint8_t Reserved[8];
+		};
+
+		/*!
+		 * \struct	Record
+		 *
+		 * \brief	A bucket in the file.
+		 */
+		struct Record
+		{
+			/*! \brief	Record status and the process id that created it. Other fields are only valid when ready. */
+			std::atomic<uint64_t> State;
+
+			/*! \brief	Bucket key (see MakeBucketKey()). */
+			uint64_t Key;
+
+			/*! \brief	Wall-clock time the bucket will be full again, in nanoseconds since unix epoch. */
+			std::atomic<int64_t> FullTime;
+
+			/*! \brief	Nanoseconds to replenish a single token. */
+			std::atomic<double> NsPerToken;
+
+			/*! \brief	Nanoseconds to replenish the whole bucket. */
+			std::atomic<int64_t> MaxTime;
+
+			/*! \brief	Nanoseconds to replenish from starting tokens to max tokens. */
+			std::atomic<int64_t> StartingTime;
+		};
+
+	private:
+
+		// the file and its parts
+		MappedFile _file;
+		FileHeader* _header = nullptr;
+		Record* _records = nullptr;
+		size_t _mask = 0;
+
+		// true if file was resumed (not created)
+		bool _resumed = false;
+
+		// get wall-clock time in nanoseconds since unix epoch
+		static int64_t Now();
+
+		// get checksum of header fields
+		static uint64_t HeaderChecksum(const FileHeader& header);
+
+		// combine status and process id into a state, and split them back
+		static inline uint64_t MakeState(Status status, uint32_t process) { return ((uint64_t)process << 32) | (uint64_t)status; }
+		static inline Status StatusOf(uint64_t state) { return (Status)(uint32_t)state; }
+		static inline uint32_t ProcessOf(uint64_t state) { return (uint32_t)(state >> 32); }
+
+		// wait while a state is claimed, and mark it abandoned if its process died (and then count it, if given a counter).
+		// return the settled state.
+		static uint64_t Settle(std::atomic<uint64_t>& state, std::atomic<uint64_t>* count);
+
+		// initialize the header of the mapped file, or wait for another process to do it, then validate it
+		bool Attach();
+
+		// find a record. return null if not found.
+		Record* Find(BucketKey key) const;
+
+		// find a record or create it with given params. return null if file is not open or full.
+		Record* FindOrCreate(BucketKey key, double starting_tokens, double max_tokens, double replenish_rate, bool& created);
+
+		// set record params (and state, if asked to)
+		static void SetParams(Record& record, double starting_tokens, double max_tokens, double replenish_rate, bool reset, int64_t now);
+
+	public:
+
+		/*! \brief	Enable / disable the alerts manager and consumption counting. */
+		bool Enabled = true;
+
+		/*! \brief	Callback to trigger when a bucket is exhausted. */
+		MappedBucketCallback OnBucketExhausted = nullptr;
+
+		/*!
+		 * \fn	MappedAlertsManager::MappedAlertsManager();
+		 *
+		 * \brief	Default constructor. Call Open() before using the manager.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		MappedAlertsManager() {}
+
+		// manager owns its file mapping, so it can't be copied
+		MappedAlertsManager(const MappedAlertsManager&) = delete;
+		MappedAlertsManager& operator=(const MappedAlertsManager&) = delete;
+
+		/*!
+		 * \fn	bool MappedAlertsManager::Open(const char* path, size_t capacity);
+		 *
+		 * \brief	Open a buckets file and resume its buckets, or create it if it doesn't exist.
+		 * 			Fails if the file has a different layout, version or byte order, or is corrupted.
+		 * 			Other processes may open the same file at the same time.
+		 * 			Note: don't call this while other threads are using the manager.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	path		File path.
+		 * \param	capacity	Max buckets, if creating a new file (existing files keep their capacity).
+		 *
+		 * \return	True if file is open and ready.
+		 */
+		bool Open(const char* path, size_t capacity);
+
+		/*!
+		 * \fn	bool MappedAlertsManager::OpenShared(const char* name, size_t capacity);
+		 *
+		 * \brief	Open a named shared memory segment, or create it if it doesn't exist (see Open()).
+		 * 			All processes on the machine that open the same name share the same buckets, and
+		 * 			the buckets survive processes restarts (but not reboots, see RemoveShared()).
+		 * 			Note: don't call this while other threads are using the manager.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	name		Segment name (on POSIX it should start with '/' and have no other slashes).
+		 * \param	capacity	Max buckets, if creating a new segment (existing segments keep their capacity).
+		 *
+		 * \return	True if segment is open and ready.
+		 */
+		bool OpenShared(const char* name, size_t capacity);
+
+		/*!
+		 * \fn	static bool MappedAlertsManager::RemoveShared(const char* name);
+		 *
+		 * \brief	Remove a named shared memory segment, so the next OpenShared() starts over.
+		 * 			Processes that have it open keep using the old segment until they close it.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	name	Segment name.
+		 *
+		 * \return	True if removed.
+		 */
+		static bool RemoveShared(const char* name);
+
+		/*!
+		 * \fn	void MappedAlertsManager::Close();
+		 *
+		 * \brief	Close the file (its buckets remain in it). Consuming from a closed manager does nothing.
+		 * 			Note: don't call this while other threads are using the manager.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Close();
+
+		/*!
+		 * \fn	inline bool MappedAlertsManager::IsOpen() const
+		 *
+		 * \brief	Check if file is open.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	True if open.
+		 */
+		inline bool IsOpen() const { return _header != nullptr; }
+
+		/*!
+		 * \fn	inline bool MappedAlertsManager::Resumed() const
+		 *
+		 * \brief	Check if the open file already existed (buckets were resumed, or another process created it) or was created.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	True if resumed an existing file.
+		 */
+		inline bool Resumed() const { return _resumed; }
+
+		/*!
+		 * \fn	bool MappedAlertsManager::CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate);
+		 *
+		 * \brief	Creates a new bucket. If bucket already exists (eg was resumed from file), only updates its
+		 * 			params and keeps its tokens, so you can declare all buckets on every startup.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id		  	Identifier for the category.
+		 * \param	bucket_id	  	Identifier for the bucket.
+		 * \param	starting_tokens	Starting tokens.
+		 * \param	max_tokens	  	Max tokens.
+		 * \param	replenish_rate 	Replenish rate (tokens per second, must be positive).
+		 *
+		 * \return	False if file is not open, full, or params are invalid.
+		 */
+		bool CreateBucket(CategoryId cat_id, BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate);
+
+		/*!
+		 * \fn	bool MappedAlertsManager::CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate);
+		 *
+		 * \brief	Creates a new bucket in default category (see above).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket_id	  	Identifier for the bucket.
+		 * \param	starting_tokens	Starting tokens.
+		 * \param	max_tokens	  	Max tokens.
+		 * \param	replenish_rate 	Replenish rate (tokens per second, must be positive).
+		 *
+		 * \return	False if file is not open, full, or params are invalid.
+		 */
+		bool CreateBucket(BucketId bucket_id, double starting_tokens, double max_tokens, double replenish_rate);
+
+		/*!
+		 * \fn	bool MappedAlertsManager::Consume(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+		 *
+		 * \brief	Consumes from bucket (create it with default params if needed), and return false if was exhausted.
+		 * 			If the file is not open or full, buckets can't be tracked and this always returns true.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 * \param	amount   	(Optional) The amount to consume.
+		 *
+		 * \return	True if bucket is not empty, false if consumed.
+		 */
+		bool Consume(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+
+		/*!
+		 * \fn	bool MappedAlertsManager::Consume(BucketId bucket_id, double amount = 1.0);
+		 *
+		 * \brief	Consumes from bucket in default category, and return false if was exhausted.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket_id	Identifier for the bucket in default category.
+		 * \param	amount   	(Optional) The amount to consume.
+		 *
+		 * \return	True if bucket is not empty, false if consumed.
+		 */
+		bool Consume(BucketId bucket_id, double amount = 1.0);
+
+		/*!
+		 * \fn	void MappedAlertsManager::Restore(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+		 *
+		 * \brief	Restore tokens to a bucket (up to its max tokens).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 * \param	amount   	(Optional) The amount.
+		 */
+		void Restore(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+
+		/*!
+		 * \fn	double MappedAlertsManager::Count(CategoryId cat_id, BucketId bucket_id);
+		 *
+		 * \brief	Get current tokens count of a bucket.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 *
+		 * \return	Current tokens count (0 if bucket doesn't exist).
+		 */
+		double Count(CategoryId cat_id, BucketId bucket_id);
+
+		/*!
+		 * \fn	void MappedAlertsManager::ResetAll();
+		 *
+		 * \brief	Resets all buckets to their starting tokens.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void ResetAll();
+
+		/*!
+		 * \fn	void MappedAlertsManager::Clear();
+		 *
+		 * \brief	Removes all buckets from the file (abandoned records included).
+		 * 			Note: don't call this while other threads or processes are using the file.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Clear();
+
+		/*!
+		 * \fn	bool MappedAlertsManager::Sync();
+		 *
+		 * \brief	Write buckets state to disk and wait for it.
+		 * 			Not needed to survive process restarts or crashes (the OS keeps the mapped pages),
+		 * 			only to survive machine crashes.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	True on success.
+		 */
+		bool Sync();
+
+		/*!
+		 * \fn	size_t MappedAlertsManager::BucketsCount() const;
+		 *
+		 * \brief	Get how many buckets are in the file.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Buckets count.
+		 */
+		size_t BucketsCount() const;
+
+		/*!
+		 * \fn	inline size_t MappedAlertsManager::Capacity() const
+		 *
+		 * \brief	Get max buckets the file can hold.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Capacity (0 if not open).
+		 */
+		inline size_t Capacity() const { return _header ? (size_t)(_mask + 1) / 4 * 3 : 0; }
+	};
+}
@@ -0,0 +1,255 @@
+#include "MappedFile.h"
+#include <chrono>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace BucketAlerts
+{
+	// how many times to check if the creator of a file already set its size, and how long to wait between checks
+	static const int CreatorWaitTries = 100;
+	static const std::chrono::milliseconds CreatorWaitInterval(10);
+
+#if defined(_WIN32)
+	bool MappedFile::Open(const char* path, size_t new_size, bool& created)
+	{
+		Close();
+
+		// open or create file (other processes may map it too)
+		HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		created = GetLastError() != ERROR_ALREADY_EXISTS;
+		_file = file;
+
+		// existing but empty? its creator may not have set its size yet, so wait a bit before setting it ourselves
+		LARGE_INTEGER size;
+		for (int i = 0; ; ++i)
+		{
+			if (!GetFileSizeEx(file, &size))
+			{
+				Close();
+				return false;
+			}
+			if (size.QuadPart > 0 || created)
+				break;
+			if (i == CreatorWaitTries)
+			{
+				created = true;
+				break;
+			}
+			std::this_thread::sleep_for(CreatorWaitInterval);
+		}
+
+		// new file? set its size (new space is zero)
+		if (size.QuadPart == 0)
+		{
+			size.QuadPart = (LONGLONG)new_size;
+			if (!SetFilePointerEx(file, size, nullptr, FILE_BEGIN) || !SetEndOfFile(file))
+			{
+				Close();
+				return false;
+			}
+		}
+		if (size.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+
+		// map it
+		_mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+		if (!_mapping)
+		{
+			Close();
+			return false;
+		}
+		_data = MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		if (!_data)
+		{
+			Close();
+			return false;
+		}
+		_size = (size_t)size.QuadPart;
+		return true;
+	}
+
+	bool MappedFile::OpenShared(const char* name, size_t new_size, bool& created)
+	{
+		Close();
+
+		// open or create a named mapping backed by the paging file (new mappings are zero)
+		HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((unsigned long long)new_size >> 32), (DWORD)new_size, name);
+		if (!mapping)
+			return false;
+		created = GetLastError() != ERROR_ALREADY_EXISTS;
+		_mapping = mapping;
+
+		// map it, and get its size (rounded up to pages)
+		_data = MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		MEMORY_BASIC_INFORMATION info;
+		if (!_data || !VirtualQuery(_data, &info, sizeof(info)))
+		{
+			Close();
+			return false;
+		}
+		_size = (size_t)info.RegionSize;
+		return true;
+	}
+
+	bool MappedFile::RemoveShared(const char* name)
+	{
+		return true;
+	}
+
+	uint32_t MappedFile::ProcessId()
+	{
+		return (uint32_t)GetCurrentProcessId();
+	}
+
+	bool MappedFile::ProcessAlive(uint32_t process)
+	{
+		HANDLE handle = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)process);
+		if (!handle)
+			return GetLastError() != ERROR_INVALID_PARAMETER;
+		bool ret = WaitForSingleObject(handle, 0) == WAIT_TIMEOUT;
+		CloseHandle(handle);
+		return ret;
+	}
+
+	void MappedFile::Close()
+	{
+		if (_data) UnmapViewOfFile(_data);
+		if (_mapping) CloseHandle(_mapping);
+		if (_file) CloseHandle(_file);
+		_data = nullptr;
+		_mapping = nullptr;
+		_file = nullptr;
+		_size = 0;
+	}
+
+	bool MappedFile::Sync()
+	{
+		return _data && FlushViewOfFile(_data, 0) && FlushFileBuffers(_file);
+	}
+#else
+	bool MappedFile::Open(const char* path, size_t new_size, bool& created)
+	{
+		Close();
+
+		// create file, or open it if exists
+		_fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+		created = _fd >= 0;
+		if (_fd < 0 && errno == EEXIST)
+			_fd = open(path, O_RDWR);
+		if (_fd < 0)
+			return false;
+		return MapDescriptor(new_size, created);
+	}
+
+	bool MappedFile::OpenShared(const char* name, size_t new_size, bool& created)
+	{
+		Close();
+
+		// create segment, or open it if exists
+		_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+		created = _fd >= 0;
+		if (_fd < 0 && errno == EEXIST)
+			_fd = shm_open(name, O_RDWR, 0644);
+		if (_fd < 0)
+			return false;
+		return MapDescriptor(new_size, created);
+	}
+
+	bool MappedFile::RemoveShared(const char* name)
+	{
+		return shm_unlink(name) == 0;
+	}
+
+	uint32_t MappedFile::ProcessId()
+	{
+		return (uint32_t)getpid();
+	}
+
+	bool MappedFile::ProcessAlive(uint32_t process)
+	{
+		return kill((pid_t)process, 0) == 0 || errno != ESRCH;
+	}
+
+	bool MappedFile::MapDescriptor(size_t new_size, bool& created)
+	{
+		// existing but empty? its creator may not have set its size yet, so wait a bit before setting it ourselves
+		struct stat info;
+		size_t size;
+		for (int i = 0; ; ++i)
+		{
+			if (fstat(_fd, &info) != 0)
+			{
+				Close();
+				return false;
+			}
+			size = (size_t)info.st_size;
+			if (size > 0 || created)
+				break;
+			if (i == CreatorWaitTries)
+			{
+				created = true;
+				break;
+			}
+			std::this_thread::sleep_for(CreatorWaitInterval);
+		}
+
+		// new file? set its size (new space is zero)
+		if (size == 0)
+		{
+			size = new_size;
+			if (ftruncate(_fd, (off_t)size) != 0)
+			{
+				Close();
+				return false;
+			}
+		}
+		if (size == 0)
+		{
+			Close();
+			return false;
+		}
+
+		// map it
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+		if (data == MAP_FAILED)
+		{
+			Close();
+			return false;
+		}
+		_data = data;
+		_size = size;
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (_data) munmap(_data, _size);
+		if (_fd >= 0) close(_fd);
+		_data = nullptr;
+		_fd = -1;
+		_size = 0;
+	}
+
+	bool MappedFile::Sync()
+	{
+		return _data && msync(_data, _size, MS_SYNC) == 0;
+	}
+#endif
+}
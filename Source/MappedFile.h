@@ -0,0 +1,193 @@
+/*!
+ * \file	Source\MappedFile.h.
+ *
+ * \brief	Declares a minimal cross-platform memory-mapped file or shared memory segment.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	MappedFile
+	 *
+	 * \brief	A file or a named shared memory segment, mapped into memory for reading and writing (shared
+	 * 			mapping, so writes go to the file and are seen by all processes that map it).
+	 * 			Uses mmap and shm_open on POSIX, and file mappings on Windows.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class MappedFile
+	{
+	private:
+		// mapped memory and its size
+		void* _data = nullptr;
+		size_t _size = 0;
+
+		// native handles (file descriptor on POSIX, file and mapping handles on Windows)
+#if defined(_WIN32)
+		void* _file = nullptr;
+		void* _mapping = nullptr;
+#else
+		int _fd = -1;
+
+		// wait for the creator to set the size of the open descriptor (or set it ourselves), then map it
+		bool MapDescriptor(size_t new_size, bool& created);
+#endif
+
+	public:
+
+		/*!
+		 * \fn	MappedFile::MappedFile();
+		 *
+		 * \brief	Default constructor (nothing is mapped).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		MappedFile() {}
+
+		/*!
+		 * \fn	MappedFile::~MappedFile();
+		 *
+		 * \brief	Destructor. Unmaps and closes the file.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		~MappedFile() { Close(); }
+
+		// mapping is owned, so it can't be copied
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/*!
+		 * \fn	bool MappedFile::Open(const char* path, size_t new_size, bool& created);
+		 *
+		 * \brief	Open or create a file and map all of it.
+		 * 			If the file doesn't exist (or is empty) its created with new_size bytes, all zero.
+		 * 			Otherwise its mapped with its existing size.
+		 * 			If several processes create the same file at once, only one of them sets its size.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	path		File path.
+		 * \param 		  	new_size	Size to create the file with, if new.
+		 * \param [out]		created 	Set to true if file was created (or was empty).
+		 *
+		 * \return	True if file is mapped, false on error.
+		 */
+		bool Open(const char* path, size_t new_size, bool& created);
+
+		/*!
+		 * \fn	bool MappedFile::OpenShared(const char* name, size_t new_size, bool& created);
+		 *
+		 * \brief	Open or create a named shared memory segment and map all of it (same as Open(), but the
+		 * 			segment lives in memory only and is gone after reboot or RemoveShared()).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param 		  	name		Segment name (on POSIX it should start with '/' and have no other slashes).
+		 * \param 		  	new_size	Size to create the segment with, if new.
+		 * \param [out]		created 	Set to true if segment was created.
+		 *
+		 * \return	True if segment is mapped, false on error.
+		 */
+		bool OpenShared(const char* name, size_t new_size, bool& created);
+
+		/*!
+		 * \fn	static bool MappedFile::RemoveShared(const char* name);
+		 *
+		 * \brief	Remove a named shared memory segment. Processes that have it mapped keep using it, but
+		 * 			the next OpenShared() creates a new segment.
+		 * 			On Windows segments are removed when the last process unmaps them, so this does nothing.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	name	Segment name.
+		 *
+		 * \return	True if removed.
+		 */
+		static bool RemoveShared(const char* name);
+
+		/*!
+		 * \fn	static uint32_t MappedFile::ProcessId();
+		 *
+		 * \brief	Get the id of the current process (to mark what a process owns in a shared mapping).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current process id.
+		 */
+		static uint32_t ProcessId();
+
+		/*!
+		 * \fn	static bool MappedFile::ProcessAlive(uint32_t process);
+		 *
+		 * \brief	Check if a process is still running (to recover what a dead process owned in a shared mapping).
+		 * 			Process ids are reused, so a dead process looks alive if another process got its id since.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	process	Process id.
+		 *
+		 * \return	False if process doesn't exist anymore.
+		 */
+		static bool ProcessAlive(uint32_t process);
+
+		/*!
+		 * \fn	void MappedFile::Close();
+		 *
+		 * \brief	Unmap and close the file (does nothing if not open).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Close();
+
+		/*!
+		 * \fn	bool MappedFile::Sync();
+		 *
+		 * \brief	Write dirty pages to disk and wait for it.
+		 * 			Not needed to survive process restarts (the OS keeps the pages), only to survive machine crashes.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	True on success.
+		 */
+		bool Sync();
+
+		/*!
+		 * \fn	inline void* MappedFile::Data() const
+		 *
+		 * \brief	Get mapped memory.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Mapped memory, or null if not open.
+		 */
+		inline void* Data() const { return _data; }
+
+		/*!
+		 * \fn	inline size_t MappedFile::Size() const
+		 *
+		 * \brief	Get mapped size, in bytes.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Mapped size.
+		 */
+		inline size_t Size() const { return _size; }
+	};
+}
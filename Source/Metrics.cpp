@@ -0,0 +1,182 @@
+#include "Metrics.h"
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+
+namespace BucketAlerts
+{
+#if defined(BUCKET_ALERTS_METRICS)
+	// calibrate the clock latencies are measured with when the program starts, so the first measured call won't sleep
+	static const double TscSecondsPerTick = TscClock::Calibrate();
+#endif
+
+	// blocks of live threads, and the total of exited threads
+	static std::mutex& BlocksMutex()
+	{
+		static std::mutex ret;
+		return ret;
+	}
+	static std::vector<Metrics::ThreadBlock*>& Blocks()
+	{
+		static std::vector<Metrics::ThreadBlock*> ret;
+		return ret;
+	}
+	static Metrics::ThreadBlock& Retired()
+	{
+		static Metrics::ThreadBlock ret = {};
+		return ret;
+	}
+
+	// apply a function on every value of two blocks
+	template <class Func>
+	static void ForEachValue(Metrics::ThreadBlock& a, const Metrics::ThreadBlock& b, Func func)
+	{
+		for (size_t i = 0; i < (size_t)MetricCounter::Count; ++i)
+			func(a.Counters[i], b.Counters[i], false);
+		for (size_t i = 0; i < (size_t)MetricTimer::Count; ++i)
+		{
+			for (size_t j = 0; j < LatencyHistogram::BinsCount; ++j)
+				func(a.Bins[i][j], b.Bins[i][j], false);
+			func(a.Nanos[i], b.Nanos[i], false);
+			func(a.MaxNanos[i], b.MaxNanos[i], true);
+		}
+	}
+
+	// add a block into another block (max values take the max)
+	static void AddBlock(Metrics::ThreadBlock& to, const Metrics::ThreadBlock& from)
+	{
+		ForEachValue(to, from, [](std::atomic<uint64_t>& a, const std::atomic<uint64_t>& b, bool is_max) {
+			uint64_t value = b.load(std::memory_order_relaxed);
+			uint64_t current = a.load(std::memory_order_relaxed);
+			a.store(is_max ? std::max(current, value) : current + value, std::memory_order_relaxed);
+		});
+	}
+
+	// zero a block
+	static void ZeroBlock(Metrics::ThreadBlock& block)
+	{
+		ForEachValue(block, block, [](std::atomic<uint64_t>& a, const std::atomic<uint64_t>&, bool) {
+			a.store(0, std::memory_order_relaxed);
+		});
+	}
+
+	Metrics::ThreadHolder::ThreadHolder()
+	{
+		Block = new ThreadBlock();
+		ZeroBlock(*Block);
+		std::lock_guard<std::mutex> lock(BlocksMutex());
+		Blocks().push_back(Block);
+	}
+
+	Metrics::ThreadHolder::~ThreadHolder()
+	{
+		// fold into retired total and unregister
+		std::lock_guard<std::mutex> lock(BlocksMutex());
+		AddBlock(Retired(), *Block);
+		std::vector<ThreadBlock*>& blocks = Blocks();
+		blocks.erase(std::remove(blocks.begin(), blocks.end(), Block), blocks.end());
+		delete Block;
+	}
+
+	void Metrics::Snapshot(MetricsSnapshot& out)
+	{
+		// sum all blocks
+		ThreadBlock total;
+		ZeroBlock(total);
+		{
+			std::lock_guard<std::mutex> lock(BlocksMutex());
+			AddBlock(total, Retired());
+			for (ThreadBlock* block : Blocks())
+				AddBlock(total, *block);
+		}
+
+		// convert to snapshot
+		out = MetricsSnapshot();
+		out.Enabled = Enabled;
+		for (size_t i = 0; i < (size_t)MetricCounter::Count; ++i)
+			out.Counters[i] = total.Counters[i].load(std::memory_order_relaxed);
+		for (size_t i = 0; i < (size_t)MetricTimer::Count; ++i)
+		{
+			LatencyHistogram& histogram = out.Timers[i];
+			for (size_t j = 0; j < LatencyHistogram::BinsCount; ++j)
+			{
+				histogram.Bins[j] = total.Bins[i][j].load(std::memory_order_relaxed);
+				histogram.Count += histogram.Bins[j];
+			}
+			histogram.TotalSeconds = (double)total.Nanos[i].load(std::memory_order_relaxed) / 1000000000.0;
+			histogram.MaxSeconds = (double)total.MaxNanos[i].load(std::memory_order_relaxed) / 1000000000.0;
+		}
+	}
+
+	void Metrics::Reset()
+	{
+		std::lock_guard<std::mutex> lock(BlocksMutex());
+		ZeroBlock(Retired());
+		for (ThreadBlock* block : Blocks())
+			ZeroBlock(*block);
+	}
+
+	double LatencyHistogram::BinLimit(size_t bin)
+	{
+		return (double)(1ull << bin) / 1000000000.0;
+	}
+
+	double LatencyHistogram::Percentile(double percentile) const
+	{
+		if (Count == 0)
+			return 0;
+
+		// find the bin the percentile falls in
+		uint64_t target = (uint64_t)(percentile * (double)Count);
+		uint64_t sum = 0;
+		for (size_t i = 0; i < BinsCount; ++i)
+		{
+			sum += Bins[i];
+			if (sum > target || sum == Count)
+				return i + 1 < BinsCount ? std::min(BinLimit(i), MaxSeconds) : MaxSeconds;
+		}
+		return MaxSeconds;
+	}
+
+	std::string MetricsSnapshot::ToText(const char* prefix) const
+	{
+		static const char* counter_names[] = { "exhaustions_total", "lookup_misses_total", "buckets_created_total", "buckets_evicted_total", "alerts_coalesced_total" };
+		static const char* timer_names[] = { "consume_seconds", "consume_many_seconds", "create_bucket_seconds", "manual_update_seconds", "callback_seconds", "lock_wait_seconds" };
+		static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == (size_t)MetricCounter::Count, "missing counter name");
+		static_assert(sizeof(timer_names) / sizeof(timer_names[0]) == (size_t)MetricTimer::Count, "missing timer name");
+
+		std::ostringstream out;
+		out.precision(9);
+
+		// counters
+		for (size_t i = 0; i < (size_t)MetricCounter::Count; ++i)
+		{
+			out << "# TYPE " << prefix << "_" << counter_names[i] << " counter\n";
+			out << prefix << "_" << counter_names[i] << " " << Counters[i] << "\n";
+		}
+
+		// registry size
+		out << "# TYPE " << prefix << "_buckets gauge\n";
+		out << prefix << "_buckets " << Buckets << "\n";
+
+		// histograms (cumulative, the last bin is the +Inf bucket)
+		for (size_t i = 0; i < (size_t)MetricTimer::Count; ++i)
+		{
+			const LatencyHistogram& histogram = Timers[i];
+			std::string name = std::string(prefix) + "_" + timer_names[i];
+			out << "# TYPE " << name << " histogram\n";
+			uint64_t sum = 0;
+			for (size_t j = 0; j + 1 < LatencyHistogram::BinsCount; ++j)
+			{
+				sum += histogram.Bins[j];
+				out << name << "_bucket{le=\"" << LatencyHistogram::BinLimit(j) << "\"} " << sum << "\n";
+			}
+			out << name << "_bucket{le=\"+Inf\"} " << histogram.Count << "\n";
+			out << name << "_sum " << histogram.TotalSeconds << "\n";
+			out << name << "_count " << histogram.Count << "\n";
+		}
+
+		return out.str();
+	}
+}
@@ -0,0 +1,409 @@
+/*!
+ * \file	Source\Metrics.h.
+ *
+ * \brief	Declares opt-in metrics: counters and latency histograms of managers operations.
+ * 			Metrics are only collected if BUCKET_ALERTS_METRICS is defined when compiling. Otherwise,
+ * 			all the recording functions are empty and compile to nothing.
+ */
+#pragma once
+#include "Clock.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \enum	MetricCounter
+	 *
+	 * \brief	Events we count.
+	 */
+	enum class MetricCounter
+	{
+		/*! \brief	Consumes that found the bucket exhausted. */
+		Exhaustions,
+
+		/*! \brief	Consumes (or lookups) of buckets that didn't exist, and were created from category template. */
+		LookupMisses,
+
+		/*! \brief	Buckets created, explicitly or by lookup misses. */
+		BucketsCreated,
+
+		/*! \brief	Idle buckets evicted. */
+		BucketsEvicted,
+
+		/*! \brief	Alerts that were coalesced (not delivered on their own). */
+		AlertsCoalesced,
+
+		/*! \brief	Number of counters (not a counter). */
+		Count,
+	};
+
+	/*!
+	 * \enum	MetricTimer
+	 *
+	 * \brief	Operations we measure latency of (every measured operation is also counted).
+	 */
+	enum class MetricTimer
+	{
+		/*! \brief	Consume calls, by ids or by handle (including bucket lookup and inline callbacks). */
+		Consume,
+
+		/*! \brief	ConsumeMany() calls (a whole batch per call, including lookups and callbacks). */
+		ConsumeMany,
+
+		/*! \brief	Explicit CreateBucket() calls. */
+		CreateBucket,
+
+		/*! \brief	ManualUpdate() calls. */
+		ManualUpdate,
+
+		/*! \brief	Exhaustion callbacks execution, inline or on dispatcher thread. */
+		Callback,
+
+		/*! \brief	Waiting for a contended shard lock (uncontended locks are not measured). */
+		LockWait,
+
+		/*! \brief	Number of timers (not a timer). */
+		Count,
+	};
+
+	/*!
+	 * \struct	LatencyHistogram
+	 *
+	 * \brief	Latency histogram with power of 2 bins.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	struct LatencyHistogram
+	{
+		/*! \brief	How many bins we have. Bin i counts latencies above 2^(i-1) and up to 2^i nanoseconds, last bin counts the rest. */
+		static const size_t BinsCount = 32;
+
+		/*! \brief	Samples count per bin. */
+		uint64_t Bins[BinsCount];
+
+		/*! \brief	Total samples count. */
+		uint64_t Count;
+
+		/*! \brief	Sum of all samples, in seconds. */
+		double TotalSeconds;
+
+		/*! \brief	Longest sample, in seconds. */
+		double MaxSeconds;
+
+		/*!
+		 * \fn	static double LatencyHistogram::BinLimit(size_t bin);
+		 *
+		 * \brief	Get the upper limit of a bin, in seconds.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bin	Bin index.
+		 *
+		 * \return	Upper limit, in seconds.
+		 */
+		static double BinLimit(size_t bin);
+
+		/*!
+		 * \fn	double LatencyHistogram::Percentile(double percentile) const;
+		 *
+		 * \brief	Estimate a percentile (the upper limit of the bin it falls in, but never above max).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	percentile	Percentile to get, between 0 and 1.
+		 *
+		 * \return	Estimated latency, in seconds (0 if no samples).
+		 */
+		double Percentile(double percentile) const;
+
+		/*!
+		 * \fn	inline double LatencyHistogram::Mean() const
+		 *
+		 * \brief	Get average latency, in seconds.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Average latency, in seconds (0 if no samples).
+		 */
+		inline double Mean() const { return Count ? TotalSeconds / Count : 0; }
+	};
+
+	/*!
+	 * \struct	MetricsSnapshot
+	 *
+	 * \brief	Metrics of all threads and all managers (they are process-wide), aggregated at a point in time.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	struct MetricsSnapshot
+	{
+		/*! \brief	True if metrics were compiled in (if false, everything is 0). */
+		bool Enabled;
+
+		/*! \brief	Counters values (index with MetricCounter). */
+		uint64_t Counters[(size_t)MetricCounter::Count];
+
+		/*! \brief	Latency histograms (index with MetricTimer). */
+		LatencyHistogram Timers[(size_t)MetricTimer::Count];
+
+		/*! \brief	Buckets in the manager the snapshot was taken from (0 if not taken from a manager). */
+		size_t Buckets;
+
+		/*! \brief	Get counter value. */
+		inline uint64_t Get(MetricCounter counter) const { return Counters[(size_t)counter]; }
+
+		/*! \brief	Get latency histogram. */
+		inline const LatencyHistogram& Get(MetricTimer timer) const { return Timers[(size_t)timer]; }
+
+		/*!
+		 * \fn	std::string MetricsSnapshot::ToText(const char* prefix = "bucket_alerts") const;
+		 *
+		 * \brief	Format metrics in the Prometheus text exposition format (counters, a buckets gauge,
+		 * 			and cumulative histograms in seconds).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	prefix	(Optional) Prefix of all metric names.
+		 *
+		 * \return	Metrics text.
+		 */
+		std::string ToText(const char* prefix = "bucket_alerts") const;
+	};
+
+	/*!
+	 * \class	Metrics
+	 *
+	 * \brief	Process-wide metrics of all managers.
+	 * 			Every thread records into its own cache-line aligned block with plain (non-RMW) writes,
+	 * 			so recording never contends with other threads. Blocks are aggregated only when taking
+	 * 			a snapshot, and blocks of exited threads are folded into a shared total.
+	 * 			Latencies are measured with TscClock.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class Metrics
+	{
+	public:
+
+		// a thread's metrics (written only by its thread, read by snapshots)
+		struct alignas(64) ThreadBlock
+		{
+			std::atomic<uint64_t> Counters[(size_t)MetricCounter::Count];
+			std::atomic<uint64_t> Bins[(size_t)MetricTimer::Count][LatencyHistogram::BinsCount];
+			std::atomic<uint64_t> Nanos[(size_t)MetricTimer::Count];
+			std::atomic<uint64_t> MaxNanos[(size_t)MetricTimer::Count];
+		};
+
+	private:
+
+		// registers the calling thread's block on first use, and folds it into the total on thread exit
+		struct ThreadHolder
+		{
+			ThreadBlock* Block;
+			ThreadHolder();
+			~ThreadHolder();
+		};
+
+		// get the calling thread's block
+		static inline ThreadBlock& Local()
+		{
+			static thread_local ThreadHolder holder;
+			return *holder.Block;
+		}
+
+		// add to a value only the calling thread writes
+		static inline void Add(std::atomic<uint64_t>& value, uint64_t amount)
+		{
+			value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		// get histogram bin of a latency, in nanoseconds (bin i holds latencies above 2^(i-1) and up to 2^i)
+		static inline size_t BinOf(uint64_t nanos)
+		{
+			if (nanos <= 1)
+				return 0;
+			if (nanos - 1 >= (1ull << (LatencyHistogram::BinsCount - 1)))
+				return LatencyHistogram::BinsCount - 1;
+#if defined(_MSC_VER)
+			unsigned long highest;
+			_BitScanReverse(&highest, (unsigned long)(nanos - 1));
+			return (size_t)highest + 1;
+#else
+			return 32 - (size_t)__builtin_clz((uint32_t)(nanos - 1));
+#endif
+		}
+
+	public:
+
+#if defined(BUCKET_ALERTS_METRICS)
+		/*! \brief	True if metrics are compiled in. */
+		static const bool Enabled = true;
+
+		/*!
+		 * \fn	static inline void Metrics::Count(MetricCounter counter, uint64_t amount = 1)
+		 *
+		 * \brief	Count an event.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	counter	The counter.
+		 * \param	amount 	(Optional) Amount to add.
+		 */
+		static inline void Count(MetricCounter counter, uint64_t amount = 1)
+		{
+			Add(Local().Counters[(size_t)counter], amount);
+		}
+
+		/*!
+		 * \fn	static inline void Metrics::Record(MetricTimer timer, TscClock::TimePoint start)
+		 *
+		 * \brief	Record latency of an operation that started at a given time.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	timer	The timer.
+		 * \param	start	When operation started.
+		 */
+		static inline void Record(MetricTimer timer, TscClock::TimePoint start)
+		{
+			double seconds = TscClock::DiffSeconds(start, TscClock::Now());
+			uint64_t nanos = seconds > 0 ? (uint64_t)(seconds * 1000000000.0) : 0;
+			ThreadBlock& block = Local();
+			Add(block.Bins[(size_t)timer][BinOf(nanos)], 1);
+			Add(block.Nanos[(size_t)timer], nanos);
+			if (nanos > block.MaxNanos[(size_t)timer].load(std::memory_order_relaxed))
+				block.MaxNanos[(size_t)timer].store(nanos, std::memory_order_relaxed);
+		}
+
+		/*!
+		 * \fn	static inline TscClock::TimePoint Metrics::Start()
+		 *
+		 * \brief	Get start time of an operation, to pass to Record() later.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current time.
+		 */
+		static inline TscClock::TimePoint Start() { return TscClock::Now(); }
+#else
+		// metrics are compiled out: all recording does nothing
+		static const bool Enabled = false;
+		static inline void Count(MetricCounter, uint64_t = 1) {}
+		static inline void Record(MetricTimer, TscClock::TimePoint) {}
+		static inline TscClock::TimePoint Start() { return TscClock::TimePoint(); }
+#endif
+
+		/*!
+		 * \fn	static void Metrics::Snapshot(MetricsSnapshot& out);
+		 *
+		 * \brief	Aggregate the metrics of all threads (live and exited).
+		 * 			Values written by other threads while taking the snapshot may or may not be included.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param [out]	out	Snapshot to fill (Buckets is set to 0).
+		 */
+		static void Snapshot(MetricsSnapshot& out);
+
+		/*!
+		 * \fn	static void Metrics::Reset();
+		 *
+		 * \brief	Zero all metrics. Events recorded by other threads while resetting may be lost.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		static void Reset();
+	};
+
+	/*!
+	 * \class	MetricsTimer
+	 *
+	 * \brief	Records the latency of the scope it lives in (does nothing if metrics are compiled out).
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class MetricsTimer
+	{
+#if defined(BUCKET_ALERTS_METRICS)
+	private:
+		MetricTimer _timer;
+		TscClock::TimePoint _start;
+
+	public:
+		explicit MetricsTimer(MetricTimer timer) : _timer(timer), _start(Metrics::Start()) {}
+		~MetricsTimer() { Metrics::Record(_timer, _start); }
+#else
+	public:
+		explicit MetricsTimer(MetricTimer) {}
+#endif
+		MetricsTimer(const MetricsTimer&) = delete;
+		MetricsTimer& operator=(const MetricsTimer&) = delete;
+	};
+
+	/*!
+	 * \fn	template <class MutexT> inline void LockMeasured(MutexT& mtx)
+	 *
+	 * \brief	Lock a mutex, and if its contended measure the wait (plain lock if metrics are compiled out).
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 *
+	 * \param	mtx	The mutex.
+	 */
+	template <class MutexT>
+	inline void LockMeasured(MutexT& mtx)
+	{
+#if defined(BUCKET_ALERTS_METRICS)
+		if (mtx.try_lock())
+			return;
+		TscClock::TimePoint start = Metrics::Start();
+		mtx.lock();
+		Metrics::Record(MetricTimer::LockWait, start);
+#else
+		mtx.lock();
+#endif
+	}
+
+	/*!
+	 * \fn	template <class MutexT> inline void LockSharedMeasured(MutexT& mtx)
+	 *
+	 * \brief	Lock a mutex for reading, and if its contended measure the wait (plain lock if metrics are compiled out).
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 *
+	 * \param	mtx	The mutex.
+	 */
+	template <class MutexT>
+	inline void LockSharedMeasured(MutexT& mtx)
+	{
+#if defined(BUCKET_ALERTS_METRICS)
+		if (mtx.try_lock_shared())
+			return;
+		TscClock::TimePoint start = Metrics::Start();
+		mtx.lock_shared();
+		Metrics::Record(MetricTimer::LockWait, start);
+#else
+		mtx.lock_shared();
+#endif
+	}
+}
@@ -0,0 +1,213 @@
+/*!
+ * \file	Source\Policies.h.
+ *
+ * \brief	Declares the compile-time policies of buckets and managers.
+ * 			The runtime policies read the global flags in Defs (this is the default behavior), while
+ * 			the others pick a behavior at compile time, so you don't pay for features you don't use.
+ */
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include "Defs.h"
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	NullMutex
+	 *
+	 * \brief	A mutex that does nothing, for single threaded policies.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class NullMutex
+	{
+	public:
+		inline void lock() {}
+		inline void unlock() {}
+		inline bool try_lock() { return true; }
+		inline void lock_shared() {}
+		inline void unlock_shared() {}
+		inline bool try_lock_shared() { return true; }
+	};
+
+	/*!
+	 * \class	RuntimeMutex
+	 *
+	 * \brief	A mutex that only locks if Defs::ThreadSafe is true.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class RuntimeMutex
+	{
+	private:
+		std::mutex _mtx;
+
+	public:
+		inline void lock() { if (Defs::ThreadSafe) _mtx.lock(); }
+		inline void unlock() { if (Defs::ThreadSafe) _mtx.unlock(); }
+		inline bool try_lock() { return !Defs::ThreadSafe || _mtx.try_lock(); }
+	};
+
+	/*!
+	 * \class	RuntimeSharedMutex
+	 *
+	 * \brief	A read-write mutex that only locks if Defs::ThreadSafe is true.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class RuntimeSharedMutex
+	{
+	private:
+		std::shared_mutex _mtx;
+
+	public:
+		inline void lock() { if (Defs::ThreadSafe) _mtx.lock(); }
+		inline void unlock() { if (Defs::ThreadSafe) _mtx.unlock(); }
+		inline bool try_lock() { return !Defs::ThreadSafe || _mtx.try_lock(); }
+		inline void lock_shared() { if (Defs::ThreadSafe) _mtx.lock_shared(); }
+		inline void unlock_shared() { if (Defs::ThreadSafe) _mtx.unlock_shared(); }
+		inline bool try_lock_shared() { return !Defs::ThreadSafe || _mtx.try_lock_shared(); }
+	};
+
+	/*!
+	 * \class	PlainAtomic
+	 *
+	 * \brief	A plain value with the same interface as std::atomic, for single threaded policies.
+	 * 			Memory orders are accepted and ignored.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class T>
+	class PlainAtomic
+	{
+	private:
+		T _value;
+
+	public:
+		PlainAtomic() : _value() {}
+		PlainAtomic(T value) : _value(value) {}
+		PlainAtomic(const PlainAtomic&) = delete;
+		PlainAtomic& operator=(const PlainAtomic&) = delete;
+
+		inline T load(std::memory_order = std::memory_order_seq_cst) const { return _value; }
+		inline void store(T value, std::memory_order = std::memory_order_seq_cst) { _value = value; }
+		inline T exchange(T value, std::memory_order = std::memory_order_seq_cst) { T ret = _value; _value = value; return ret; }
+		inline T fetch_add(T value, std::memory_order = std::memory_order_seq_cst) { T ret = _value; _value += value; return ret; }
+		inline T fetch_sub(T value, std::memory_order = std::memory_order_seq_cst) { T ret = _value; _value -= value; return ret; }
+		inline bool compare_exchange_strong(T& expected, T desired, std::memory_order = std::memory_order_seq_cst, std::memory_order = std::memory_order_seq_cst)
+		{
+			if (_value != expected) { expected = _value; return false; }
+			_value = desired;
+			return true;
+		}
+		inline bool compare_exchange_weak(T& expected, T desired, std::memory_order success = std::memory_order_seq_cst, std::memory_order failure = std::memory_order_seq_cst)
+		{
+			return compare_exchange_strong(expected, desired, success, failure);
+		}
+	};
+
+	/*!
+	 * \struct	RuntimeThreading
+	 *
+	 * \brief	Threading policy: lock only if Defs::ThreadSafe is true (default).
+	 */
+	struct RuntimeThreading
+	{
+		typedef RuntimeMutex Mutex;
+		typedef RuntimeSharedMutex SharedMutex;
+		template <class T> using Atomic = std::atomic<T>;
+		static inline bool Concurrent() { return Defs::ThreadSafe; }
+	};
+
+	/*!
+	 * \struct	MultiThreaded
+	 *
+	 * \brief	Threading policy: always lock.
+	 */
+	struct MultiThreaded
+	{
+		typedef std::mutex Mutex;
+		typedef std::shared_mutex SharedMutex;
+		template <class T> using Atomic = std::atomic<T>;
+		static constexpr bool Concurrent() { return true; }
+	};
+
+	/*!
+	 * \struct	SingleThreaded
+	 *
+	 * \brief	Threading policy: never lock (no mutex is kept at all), and use plain values instead of atomics.
+	 */
+	struct SingleThreaded
+	{
+		typedef NullMutex Mutex;
+		typedef NullMutex SharedMutex;
+		template <class T> using Atomic = PlainAtomic<T>;
+		static constexpr bool Concurrent() { return false; }
+	};
+
+	/*!
+	 * \struct	RuntimeUpdate
+	 *
+	 * \brief	Update policy: replenish on consume only if Defs::AutoUpdate is true (default).
+	 */
+	struct RuntimeUpdate
+	{
+		static inline bool Auto() { return Defs::AutoUpdate; }
+	};
+
+	/*!
+	 * \struct	AutoUpdated
+	 *
+	 * \brief	Update policy: always replenish on consume.
+	 */
+	struct AutoUpdated
+	{
+		static constexpr bool Auto() { return true; }
+	};
+
+	/*!
+	 * \struct	ManuallyUpdated
+	 *
+	 * \brief	Update policy: only replenish when calling Update() / ManualUpdate().
+	 */
+	struct ManuallyUpdated
+	{
+		static constexpr bool Auto() { return false; }
+	};
+
+	/*!
+	 * \struct	RuntimeExhaust
+	 *
+	 * \brief	Exhaust policy: reset exhausted buckets only if Defs::ResetWhenConsumed is true (default).
+	 */
+	struct RuntimeExhaust
+	{
+		static inline bool Reset() { return Defs::ResetWhenConsumed; }
+	};
+
+	/*!
+	 * \struct	ResetOnExhaust
+	 *
+	 * \brief	Exhaust policy: always reset exhausted buckets to their starting value.
+	 */
+	struct ResetOnExhaust
+	{
+		static constexpr bool Reset() { return true; }
+	};
+
+	/*!
+	 * \struct	ZeroOnExhaust
+	 *
+	 * \brief	Exhaust policy: leave exhausted buckets empty.
+	 */
+	struct ZeroOnExhaust
+	{
+		static constexpr bool Reset() { return false; }
+	};
+}
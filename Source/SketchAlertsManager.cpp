@@ -0,0 +1,145 @@
+#include "SketchAlertsManager.h"
+#include <algorithm>
+
+namespace BucketAlerts
+{
+	// raise counter to value, if its lower
+	static inline void RaiseCounter(std::atomic<int64_t>& counter, int64_t value)
+	{
+		int64_t current = counter.load(std::memory_order_relaxed);
+		while (current < value && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+
+	SketchAlertsManager::SketchAlertsManager(size_t width, size_t depth, double max_tokens, double replenish_rate, size_t heavy_hitters) :
+		_heavy_hitters_capacity(heavy_hitters)
+	{
+		// round width up to power of 2, and limit depth
+		_width = 1;
+		while (_width < width)
+			_width <<= 1;
+		_mask = _width - 1;
+		_depth = depth < 1 ? 1 : depth > MaxDepth ? MaxDepth : depth;
+
+		// counters start at 0 (buckets are full from the epoch)
+		_counters.reset(new std::atomic<int64_t>[_width * _depth]);
+		_epoch = AccurateClock::Now();
+		Clear();
+
+		// get tokens replenish time
+		_replenishes = replenish_rate > 0;
+		_ns_per_token = _replenishes ? 1000000000.0 / replenish_rate : 1000000000.0;
+		_full_ns = (int64_t)(max_tokens * _ns_per_token);
+		_heavy_hitters.reserve(_heavy_hitters_capacity);
+	}
+
+	int64_t SketchAlertsManager::GetCounters(BucketKey key, std::atomic<int64_t>** counters)
+	{
+		// derive a counter per row from a single hash (double hashing)
+		uint64_t hash = HashBucketKey(key);
+		size_t h1 = (size_t)(uint32_t)hash;
+		size_t h2 = (size_t)(hash >> 32) | 1;
+
+		int64_t ret = INT64_MAX;
+		for (size_t i = 0; i < _depth; ++i)
+		{
+			counters[i] = &_counters[i * _width + ((h1 + i * h2) & _mask)];
+			ret = std::min(ret, counters[i]->load(std::memory_order_relaxed));
+		}
+		return ret;
+	}
+
+	bool SketchAlertsManager::Consume(CategoryId cat_id, BucketId bucket_id, double amount)
+	{
+		// skip if disabled
+		if (!Enabled)
+			return true;
+
+		// get counters and the least loaded value
+		int64_t now = Now();
+		std::atomic<int64_t>* counters[MaxDepth];
+		int64_t full_time = GetCounters(MakeBucketKey(cat_id, bucket_id), counters);
+
+		// add amount to the time bucket will be full again, and check if it passes the bucket size.
+		// if it does, bucket is exhausted and we zero it (like TokenBucket does).
+		int64_t new_full_time = std::max(full_time, now) + (int64_t)(amount * _ns_per_token);
+		bool ret = new_full_time - now <= _full_ns;
+		if (!ret)
+			new_full_time = now + _full_ns;
+
+		// raise all counters to new value
+		for (size_t i = 0; i < _depth; ++i)
+			RaiseCounter(*counters[i], new_full_time);
+
+		// exhausted? count it and invoke callback
+		if (!ret)
+		{
+			uint64_t alerts = CountHeavyHitter(cat_id, bucket_id);
+			SketchBucketCallback callback = OnBucketExhausted;
+			if (callback)
+				callback(cat_id, bucket_id, alerts);
+		}
+
+		return ret;
+	}
+
+	bool SketchAlertsManager::Consume(BucketId bucket_id, double amount)
+	{
+		return Consume(Defs::DefaultCategoryId, bucket_id, amount);
+	}
+
+	double SketchAlertsManager::Count(CategoryId cat_id, BucketId bucket_id)
+	{
+		int64_t now = Now();
+		std::atomic<int64_t>* counters[MaxDepth];
+		int64_t full_time = GetCounters(MakeBucketKey(cat_id, bucket_id), counters);
+		return (double)(_full_ns - (std::max(full_time, now) - now)) / _ns_per_token;
+	}
+
+	uint64_t SketchAlertsManager::CountHeavyHitter(CategoryId cat_id, BucketId bucket_id)
+	{
+		if (_heavy_hitters_capacity == 0)
+			return 0;
+
+		std::lock_guard<std::mutex> lock(_heavy_hitters_mutex);
+
+		// already tracked? count it
+		for (HeavyHitter& entry : _heavy_hitters)
+		{
+			if (entry.Category == cat_id && entry.Bucket == bucket_id)
+				return ++entry.Alerts;
+		}
+
+		// got room? add it
+		if (_heavy_hitters.size() < _heavy_hitters_capacity)
+		{
+			_heavy_hitters.push_back(HeavyHitter { cat_id, bucket_id, 1, 0 });
+			return 1;
+		}
+
+		// replace the least exhausted entry, and inherit its count as error (space-saving)
+		HeavyHitter& least = *std::min_element(_heavy_hitters.begin(), _heavy_hitters.end(),
+			[](const HeavyHitter& a, const HeavyHitter& b) { return a.Alerts < b.Alerts; });
+		least.Category = cat_id;
+		least.Bucket = bucket_id;
+		least.Error = least.Alerts;
+		return ++least.Alerts;
+	}
+
+	void SketchAlertsManager::GetHeavyHitters(std::vector<HeavyHitter>& out)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_heavy_hitters_mutex);
+			out = _heavy_hitters;
+		}
+		std::sort(out.begin(), out.end(), [](const HeavyHitter& a, const HeavyHitter& b) { return a.Alerts > b.Alerts; });
+	}
+
+	void SketchAlertsManager::Clear()
+	{
+		for (size_t i = 0; i < _width * _depth; ++i)
+			_counters[i].store(0, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(_heavy_hitters_mutex);
+		_heavy_hitters.clear();
+	}
+}
@@ -0,0 +1,232 @@
+/*!
+ * \file	Source\SketchAlertsManager.h.
+ *
+ * \brief	Declares a fixed memory alerts manager, that keeps approximate buckets in a sketch.
+ */
+#pragma once
+#include "Defs.h"
+#include "Clock.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \typedef	void(*SketchBucketCallback)(CategoryId cat_id, BucketId bucket_id, uint64_t alerts)
+	 *
+	 * \brief	A callback to call when a bucket in a sketch alerts manager is exhausted.
+	 * 			Gets the exact ids of the exhausted bucket, and how many times it was exhausted so far
+	 * 			(as counted by the heavy hitters table, see SketchAlertsManager::GetHeavyHitters()).
+	 */
+	typedef void(*SketchBucketCallback)(CategoryId cat_id, BucketId bucket_id, uint64_t alerts);
+
+	/*!
+	 * \struct	HeavyHitter
+	 *
+	 * \brief	A bucket that was exhausted a lot, as tracked by SketchAlertsManager.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	struct HeavyHitter
+	{
+		/*! \brief	Identifier for the category. */
+		CategoryId Category;
+
+		/*! \brief	Identifier for the bucket. */
+		BucketId Bucket;
+
+		/*! \brief	How many times bucket was exhausted (may be over-counted by up to Error). */
+		uint64_t Alerts;
+
+		/*! \brief	Max over-count of Alerts (alerts of buckets this entry replaced). */
+		uint64_t Error;
+	};
+
+	/*!
+	 * \class	SketchAlertsManager
+	 *
+	 * \brief	An alerts manager with a fixed memory footprint, for unbounded ids space (per-ip, per-entity etc).
+	 * 			Instead of a bucket per id, it keeps a count-min sketch: 'depth' rows of 'width' counters,
+	 * 			and every id is hashed into one counter per row. All ids share the same max tokens and
+	 * 			replenish rate, set at construction.
+	 *
+	 * 			Every counter holds the time its bucket will be full again (like GCRA), so counters decay
+	 * 			without being updated. Consuming takes the least loaded counter of the id, and raises all
+	 * 			of its counters to the new value (conservative update).
+	 *
+	 * 			Error bounds, compared to a TokenBucket per id with the same params (starting full):
+	 * 			- Counters are only ever over-loaded by other ids, so an id that would exhaust its exact
+	 * 			  bucket always alerts here too (no missed alerts, given the same consume times), and Count()
+	 * 			  is never above the exact count.
+	 * 			- An id is falsely exhausted only if, in every row, the other ids sharing its counter add
+	 * 			  enough load. For an id consuming at rate x < replenish rate r, while all ids together
+	 * 			  consume at rate R, the chance that all its counters get more than (r - x) from other ids
+	 * 			  is at most (R / (width * (r - x))) ^ depth.
+	 * 			  For example, width 4096, depth 4 and total traffic of 1000 x r gives ids at half the rate
+	 * 			  a false alert chance of about (0.49) ^ 4 = 6%, while width 65536 makes it about 1e-6.
+	 * 			- Concurrent consumes of ids that share counters are not atomic together, so under contention
+	 * 			  a few extra consumes may pass before the sketch notices an id is exhausted.
+	 *
+	 * 			Exhausted ids are also counted in a small heavy hitters table (space-saving), so the ids
+	 * 			causing most alerts can be reported exactly.
+	 * 			Memory is width * depth * 8 bytes, plus the heavy hitters table.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class SketchAlertsManager
+	{
+	public:
+
+		/*! \brief	Max sketch depth (rows). */
+		static const size_t MaxDepth = 16;
+
+	private:
+
+		// counters, row after row. every counter holds the time (nanoseconds since epoch) its bucket will be full.
+		std::unique_ptr<std::atomic<int64_t>[]> _counters;
+		size_t _width;
+		size_t _depth;
+		size_t _mask;
+
+		// nanoseconds to replenish a single token (if buckets don't replenish, just the scale of a token), and to replenish a whole bucket
+		double _ns_per_token;
+		int64_t _full_ns;
+
+		// false if replenish rate is 0.
+		bool _replenishes;
+
+		// heavy hitters table and mutex to protect it
+		std::vector<HeavyHitter> _heavy_hitters;
+		size_t _heavy_hitters_capacity;
+		std::mutex _heavy_hitters_mutex;
+
+		// time point that counters time is counted from
+		AccurateClock::TimePoint _epoch;
+
+		// get current time in nanoseconds since epoch (if buckets don't replenish, time never moves)
+		inline int64_t Now() const { return _replenishes ? (int64_t)(AccurateClock::DiffSeconds(_epoch, AccurateClock::Now()) * 1000000000.0) : 0; }
+
+		// get the counters of a key (one per row) and return the least loaded value
+		int64_t GetCounters(BucketKey key, std::atomic<int64_t>** counters);
+
+		// count an alert of a key in heavy hitters table, and return its alerts count
+		uint64_t CountHeavyHitter(CategoryId cat_id, BucketId bucket_id);
+
+	public:
+
+		/*! \brief	Enable / disable the alerts manager and consumption counting. */
+		bool Enabled = true;
+
+		/*! \brief	Callback to trigger when a bucket is exhausted. */
+		SketchBucketCallback OnBucketExhausted = nullptr;
+
+		/*!
+		 * \fn	SketchAlertsManager::SketchAlertsManager(size_t width, size_t depth, double max_tokens, double replenish_rate, size_t heavy_hitters = 32);
+		 *
+		 * \brief	Constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	width		  	Counters per row (rounded up to power of 2). More counters = less false alerts.
+		 * \param	depth		  	How many rows (up to MaxDepth). More rows = less false alerts, but slower consume.
+		 * \param	max_tokens	  	Max tokens of every bucket (buckets start full).
+		 * \param	replenish_rate	Replenish rate of every bucket (0 to never replenish).
+		 * \param	heavy_hitters 	How many exhausted buckets to track in the heavy hitters table.
+		 */
+		SketchAlertsManager(size_t width, size_t depth, double max_tokens, double replenish_rate, size_t heavy_hitters = 32);
+
+		// manager owns its counters, so it can't be copied
+		SketchAlertsManager(const SketchAlertsManager&) = delete;
+		SketchAlertsManager& operator=(const SketchAlertsManager&) = delete;
+
+		/*!
+		 * \fn	bool SketchAlertsManager::Consume(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+		 *
+		 * \brief	Consumes from bucket, and return false if was exhausted.
+		 * 			Lock-free, unless bucket is exhausted (then heavy hitters table is locked).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 * \param	amount   	(Optional) The amount to consume.
+		 *
+		 * \return	True if bucket is not empty, false if consumed.
+		 */
+		bool Consume(CategoryId cat_id, BucketId bucket_id, double amount = 1.0);
+
+		/*!
+		 * \fn	bool SketchAlertsManager::Consume(BucketId bucket_id, double amount = 1.0);
+		 *
+		 * \brief	Consumes from bucket in default category, and return false if was exhausted.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket_id	Identifier for the bucket in default category.
+		 * \param	amount   	(Optional) The amount to consume.
+		 *
+		 * \return	True if bucket is not empty, false if consumed.
+		 */
+		bool Consume(BucketId bucket_id, double amount = 1.0);
+
+		/*!
+		 * \fn	double SketchAlertsManager::Count(CategoryId cat_id, BucketId bucket_id);
+		 *
+		 * \brief	Get estimated tokens count of a bucket (never above the exact count).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	cat_id   	Identifier for the category.
+		 * \param	bucket_id	Identifier for the bucket.
+		 *
+		 * \return	Estimated tokens count.
+		 */
+		double Count(CategoryId cat_id, BucketId bucket_id);
+
+		/*!
+		 * \fn	void SketchAlertsManager::GetHeavyHitters(std::vector<HeavyHitter>& out);
+		 *
+		 * \brief	Get the buckets that were exhausted the most, sorted by alerts count.
+		 * 			Any bucket that was exhausted more than (total alerts / heavy hitters capacity) times
+		 * 			is guaranteed to be in the list.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param [out]	out	Output list (cleared first).
+		 */
+		void GetHeavyHitters(std::vector<HeavyHitter>& out);
+
+		/*!
+		 * \fn	void SketchAlertsManager::Clear();
+		 *
+		 * \brief	Reset all buckets to full and clear heavy hitters table.
+		 * 			Note: don't call this while other threads are consuming.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Clear();
+
+		/*!
+		 * \fn	inline size_t SketchAlertsManager::MemoryUsage() const
+		 *
+		 * \brief	Get how many bytes the sketch and heavy hitters table take.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Memory usage, in bytes.
+		 */
+		inline size_t MemoryUsage() const { return _width * _depth * sizeof(int64_t) + _heavy_hitters_capacity * sizeof(HeavyHitter); }
+	};
+}
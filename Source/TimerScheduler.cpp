@@ -0,0 +1,70 @@
+#include "TimerScheduler.h"
+
+namespace BucketAlerts
+{
+	TimerScheduler::TimerScheduler() :
+		_thread(&TimerScheduler::Run, this)
+	{
+	}
+
+	TimerScheduler::~TimerScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			_running = false;
+		}
+		_wakeup.notify_one();
+		_thread.join();
+	}
+
+	void TimerScheduler::Schedule(Clock::time_point when, TimerCallback callback, void* context)
+	{
+		// only wake the thread if new timer is the earliest
+		bool earliest;
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			Timer timer = { when, _sequence++, callback, context };
+			earliest = _timers.empty() || when < _timers.top().When;
+			_timers.push(timer);
+		}
+		if (earliest)
+			_wakeup.notify_one();
+	}
+
+	size_t TimerScheduler::Pending()
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		return _timers.size();
+	}
+
+	void TimerScheduler::Run()
+	{
+		std::unique_lock<std::mutex> lock(_mtx);
+		while (true)
+		{
+			// nothing pending? sleep until scheduled or stopped
+			if (_timers.empty())
+			{
+				if (!_running)
+					break;
+				_wakeup.wait(lock);
+				continue;
+			}
+
+			// earliest timer not due yet? sleep until it is (when stopping, don't wait)
+			Timer timer = _timers.top();
+			if (_running && Clock::now() < timer.When)
+			{
+				_wakeup.wait_until(lock, timer.When);
+				continue;
+			}
+
+			// invoke without the lock, so callbacks can schedule (when stopping, timers that are not due are cancelled)
+			bool cancelled = !_running && Clock::now() < timer.When;
+			_timers.pop();
+			lock.unlock();
+			timer.Callback(timer.Context, cancelled);
+			lock.lock();
+		}
+	}
+}
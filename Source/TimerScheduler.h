@@ -0,0 +1,124 @@
+/*!
+ * \file	Source\TimerScheduler.h.
+ *
+ * \brief	Declares a timer thread that many waiters can share (used to resume coroutines waiting on tokens, see Acquire.h).
+ */
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	TimerScheduler
+	 *
+	 * \brief	A single thread that invokes callbacks at given times.
+	 * 			Pending timers are kept in a heap, and the thread sleeps until the earliest one is due, so any
+	 * 			number of pending timers costs no CPU. Timers that are due at the same time are invoked in the
+	 * 			order they were scheduled. Callbacks run on the scheduler thread, so they should be short.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	class TimerScheduler
+	{
+	public:
+
+		/*! \brief	The clock timers are scheduled by. */
+		typedef std::chrono::steady_clock Clock;
+
+		/*! \brief	Timer callback, with the context it was scheduled with, and if it was cancelled (invoked before its time because the scheduler is destroyed). */
+		typedef void(*TimerCallback)(void* context, bool cancelled);
+
+	private:
+		// a pending timer (sequence keeps timers of the same time in order)
+		struct Timer
+		{
+			Clock::time_point When;
+			uint64_t Sequence;
+			TimerCallback Callback;
+			void* Context;
+		};
+
+		// orders the heap by earliest timer first
+		struct Later
+		{
+			bool operator()(const Timer& a, const Timer& b) const
+			{
+				return a.When > b.When || (a.When == b.When && a.Sequence > b.Sequence);
+			}
+		};
+
+		// pending timers
+		std::priority_queue<Timer, std::vector<Timer>, Later> _timers;
+		uint64_t _sequence = 0;
+
+		// thread and its state
+		bool _running = true;
+		std::mutex _mtx;
+		std::condition_variable _wakeup;
+		std::thread _thread;
+
+		// thread main loop
+		void Run();
+
+	public:
+
+		/*!
+		 * \fn	TimerScheduler::TimerScheduler();
+		 *
+		 * \brief	Constructor. Starts the timers thread.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		TimerScheduler();
+
+		/*!
+		 * \fn	TimerScheduler::~TimerScheduler();
+		 *
+		 * \brief	Destructor. Invokes timers that are still pending right away as cancelled (so no waiter is left hanging), and stops the thread.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		~TimerScheduler();
+
+		// scheduler owns a thread, so it can't be copied
+		TimerScheduler(const TimerScheduler&) = delete;
+		TimerScheduler& operator=(const TimerScheduler&) = delete;
+
+		/*!
+		 * \fn	void TimerScheduler::Schedule(Clock::time_point when, TimerCallback callback, void* context);
+		 *
+		 * \brief	Invoke a callback at a given time (or as soon as possible, if time already passed).
+		 * 			If the scheduler is destroyed before that time, the callback is invoked as cancelled.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	when		When to invoke callback.
+		 * \param	callback	The callback.
+		 * \param	context 	Context to pass to callback.
+		 */
+		void Schedule(Clock::time_point when, TimerCallback callback, void* context);
+
+		/*!
+		 * \fn	size_t TimerScheduler::Pending();
+		 *
+		 * \brief	Get how many timers are waiting to be invoked.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Pending timers count.
+		 */
+		size_t Pending();
+	};
+}
@@ -4,14 +4,22 @@
  * \brief	Declares the token bucket class.
  */
 #pragma once
-#include <mutex>
 #include "Clock.h"
+#include "Policies.h"
 
 
 namespace BucketAlerts
 {
 	// predef
-	class TokenBucket;
+	template <class ClockT = AccurateClock, class ThreadingT = RuntimeThreading, class UpdateT = RuntimeUpdate>
+	class BasicTokenBucket;
+
+	/*!
+	 * \typedef	BasicTokenBucket<AccurateClock> TokenBucket
+	 *
+	 * \brief	The default token bucket, using the accurate clock.
+	 */
+	typedef BasicTokenBucket<AccurateClock> TokenBucket;
 
 	/*!
 	 * \typedef	void(*onBucketExhausted)(const TokenBucket& bucket)
@@ -21,15 +29,32 @@ namespace BucketAlerts
 	typedef void(*BucketCallback)(const TokenBucket& bucket);
 
 	/*!
-	 * \class	TokenBucket
+	 * \class	BasicTokenBucket
 	 *
 	 * \brief	A token bucket.
+	 * 			The clock is a policy (see Clock.h), so you can use a cheaper clock or a virtual one.
+	 * 			Threading and auto-update are policies too (see Policies.h), by default they follow Defs.
 	 *
 	 * \author	Ronen Ness
 	 * \date	3/31/2018
 	 */
-	class TokenBucket
+	template <class ClockT, class ThreadingT, class UpdateT>
+	class BasicTokenBucket
 	{
+	public:
+
+		/*! \brief	The clock this bucket measures time with. */
+		typedef ClockT Clock;
+
+		/*! \brief	The update policy of this bucket (if not auto, time passed to Consume() is ignored). */
+		typedef UpdateT UpdatePolicy;
+
+		/*! \brief	The threading policy of this bucket. */
+		typedef ThreadingT Threading;
+
+		/*! \brief	A callback we can attach to this bucket type to call when exhausted. */
+		typedef void(*Callback)(const BasicTokenBucket& bucket);
+
 	private:
 		// current tokens count.
 		double _tokens;
@@ -47,15 +72,15 @@ namespace BucketAlerts
 		double _total_consumption;
 
 		// last time we had a token update
-		AccurateClock::TimePoint _last_update_time;
+		typename ClockT::TimePoint _last_update_time;
 
-		// mutex
-		std::mutex _mtx;
+		// mutex (does nothing if single threaded)
+		mutable typename ThreadingT::Mutex _mtx;
 
 	public:
 
 		/*! \brief	Optional function to call when bucket runs out of tokens */
-		BucketCallback OnBucketExhausted = nullptr;
+		Callback OnBucketExhausted = nullptr;
 
 		/*!
 		 * \fn	TokenBucket::TokenBucket(double starting, double max, double replenish_rate);
@@ -69,7 +94,7 @@ namespace BucketAlerts
 		 * \param	max			  	Max tokens allowed in bucket.
 		 * \param	replenish_rate	Tokens replenish rate (tokens per second).
 		 */
-		TokenBucket(double starting=0, double max=10, double replenish_rate=1);
+		BasicTokenBucket(double starting=0, double max=10, double replenish_rate=1);
 
 		/*!
 		 * \fn	TokenBucket::TokenBucket(const TokenBucket& other);
@@ -81,7 +106,7 @@ namespace BucketAlerts
 		 *
 		 * \param	other	The other object.
 		 */
-		TokenBucket(const TokenBucket& other);
+		BasicTokenBucket(const BasicTokenBucket& other);
 
 		/*!
 		 * \fn	const TokenBucket& TokenBucket::operator=(const TokenBucket& other);
@@ -95,7 +120,7 @@ namespace BucketAlerts
 		 *
 		 * \return	A shallow copy of this object.
 		 */
-		const TokenBucket& operator=(const TokenBucket& other);
+		const BasicTokenBucket& operator=(const BasicTokenBucket& other);
 
 		/*!
 		 * \fn	bool TokenBucket::Consume(double amount = 1.0) };
@@ -111,6 +136,38 @@ namespace BucketAlerts
 		 */
 		bool Consume(double amount = 1.0);
 
+		/*!
+		 * \fn	bool TokenBucket::Consume(double amount, bool notify);
+		 *
+		 * \brief	Consumes the given amount of tokens, optionally without invoking the callback.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to consume.
+		 * \param	notify	If false, will not invoke the callback when exhausted (caller will do it).
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount, bool notify);
+
+		/*!
+		 * \fn	bool TokenBucket::Consume(double amount, const typename ClockT::TimePoint& now, bool notify);
+		 *
+		 * \brief	Consumes the given amount of tokens, using a time point we already read.
+		 * 			Useful to consume from many buckets with a single clock read.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to consume.
+		 * \param	now   	Current time (only used if auto-update is on).
+		 * \param	notify	If false, will not invoke the callback when exhausted (caller will do it).
+		 *
+		 * \return	True if it got enough tokens to consume, False if hit 0.
+		 */
+		bool Consume(double amount, const typename ClockT::TimePoint& now, bool notify);
+
 		/*!
 		* \fn	bool TokenBucket::Restore(double amount = 1.0) };
 		*
@@ -123,6 +180,53 @@ namespace BucketAlerts
 		*/
 		void Restore(double amount = 1.0);
 
+		/*!
+		 * \fn	double TokenBucket::Take(double max_amount);
+		 *
+		 * \brief	Take up to the given amount of tokens, without failing or invoking the callback.
+		 * 			Used by token leases to reserve a batch of tokens at once.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	max_amount	Max amount of tokens to take.
+		 *
+		 * \return	How many tokens were taken (0 if bucket is empty).
+		 */
+		double Take(double max_amount);
+
+		/*!
+		 * \fn	void TokenBucket::Return(double amount);
+		 *
+		 * \brief	Return tokens that were taken but not used.
+		 * 			Unlike Restore(), this also removes them from the total consumption (only the tokens
+		 * 			that fit in the bucket are returned, so consumption matches the tokens it holds).
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	The amount to return.
+		 */
+		void Return(double amount);
+
+		/*!
+		 * \fn	double TokenBucket::Reserve(double amount, double max_wait);
+		 *
+		 * \brief	Reserve tokens that may not be available yet, and get how long to wait until they are.
+		 * 			Tokens are taken right away, so the bucket may go below zero (a debt that is paid by
+		 * 			replenishing). Waiters are served in the order they reserved, and while there's a debt,
+		 * 			Consume() fails. Never invokes the callback. See Acquire.h for waiting on reservations.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount  	The amount to reserve.
+		 * \param	max_wait	Max seconds caller is willing to wait (if longer, nothing is reserved).
+		 *
+		 * \return	Seconds to wait before using the tokens (0 if available now), or -1 if not reserved.
+		 */
+		double Reserve(double amount, double max_wait);
+
 		/*!
 		 * \fn	bool TokenBucket::Test(double amount = 1.0);
 		 *
@@ -135,7 +239,7 @@ namespace BucketAlerts
 		 *
 		 * \return	True if have enough tokens, false if not.
 		 */
-		inline bool Test(double amount = 1.0) const;
+		bool Test(double amount = 1.0) const;
 
 		/*!
 		 * \fn	inline double TokenBucket::Count() const
@@ -161,6 +265,43 @@ namespace BucketAlerts
 		 */
 		double inline TotalConsumed() const { return _total_consumption; }
 
+		/*!
+		 * \fn	inline double TokenBucket::MaxTokens() const
+		 *
+		 * \brief	Get the max tokens this bucket can hold.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Max tokens.
+		 */
+		inline double MaxTokens() const { return _max_tokens; }
+
+		/*!
+		 * \fn	inline double TokenBucket::ReplenishRate() const
+		 *
+		 * \brief	Get how many tokens are added per second.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Replenish rate.
+		 */
+		inline double ReplenishRate() const { return _replenish_rate; }
+
+		/*!
+		 * \fn	double TokenBucket::Peek() const;
+		 *
+		 * \brief	Get current tokens count, including tokens replenished since last update, without updating the bucket
+		 * 			(unlike Count()). Used to read buckets while they may be replaced. Takes the bucket's mutex, like Consume().
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Current tokens count.
+		 */
+		double Peek() const;
+
 		/*!
 		 * \fn	inline void TokenBucket::Reset()
 		 *
@@ -181,6 +322,267 @@ namespace BucketAlerts
 		* \date	3/31/2018
 		*/
 		void Update();
+
+		/*!
+		 * \fn	void TokenBucket::Update(const typename ClockT::TimePoint& now);
+		 *
+		 * \brief	Updates the tokens, using a time point we already read.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	now	Current time.
+		 */
+		void Update(const typename ClockT::TimePoint& now);
 	};
 
-}
\ No newline at end of file
+	template <class ClockT, class ThreadingT, class UpdateT>
+	BasicTokenBucket<ClockT, ThreadingT, UpdateT>::BasicTokenBucket(double starting, double max, double replenish_rate) :
+		_tokens(starting), _replenish_rate(replenish_rate), _max_tokens(max), _starting_count(starting), _total_consumption(0)
+	{
+		_last_update_time = ClockT::Now();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	BasicTokenBucket<ClockT, ThreadingT, UpdateT>::BasicTokenBucket(const BasicTokenBucket& other) :
+		_tokens(other._tokens), _replenish_rate(other._replenish_rate), _max_tokens(other._max_tokens), _starting_count(other._starting_count), _total_consumption(other._total_consumption)
+	{
+		_last_update_time = ClockT::Now();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	const BasicTokenBucket<ClockT, ThreadingT, UpdateT>& BasicTokenBucket<ClockT, ThreadingT, UpdateT>::operator=(const BasicTokenBucket& other)
+	{
+		_starting_count = other._starting_count;
+		_tokens = other._tokens;
+		_max_tokens = other._max_tokens;
+		_replenish_rate = other._replenish_rate;
+		_last_update_time = other._last_update_time;
+		_total_consumption = other._total_consumption;
+		OnBucketExhausted = other.OnBucketExhausted;
+		return *this;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Update()
+	{
+		Update(ClockT::Now());
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Update(const typename ClockT::TimePoint& curr_update_time)
+	{
+		// lock mutex (last update time is shared state too, so read and write it under the lock)
+		_mtx.lock();
+
+		// calculate time diff in seconds
+		double dt = ClockT::DiffSeconds(_last_update_time, curr_update_time);
+
+		// no time passed (or another thread already updated past us)? nothing to do
+		if (dt <= 0)
+		{
+			_mtx.unlock();
+			return;
+		}
+
+		// update last update time
+		_last_update_time = curr_update_time;
+
+		// add tokens
+		_tokens += dt * _replenish_rate;
+
+		// limit to max
+		if (_tokens > _max_tokens)
+		{
+			_tokens = _max_tokens;
+		}
+
+		// unlock mutex
+		_mtx.unlock();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Restore(double amount)
+	{
+		// lock if needed
+		_mtx.lock();
+
+		// add tokens and make sure didn't pass max
+		_tokens += amount;
+		if (_tokens > _max_tokens)
+			_tokens = _max_tokens;
+
+		// unlock
+		_mtx.unlock();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	double BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Take(double max_amount)
+	{
+		// update tokens before taking
+		if (UpdateT::Auto())
+			Update();
+
+		// take as much as we can
+		_mtx.lock();
+		double ret = _tokens < max_amount ? _tokens : max_amount;
+		if (ret < 0) ret = 0;
+		_tokens -= ret;
+		_total_consumption += ret;
+		_mtx.unlock();
+
+		return ret;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Return(double amount)
+	{
+		_mtx.lock();
+
+		// add tokens (limited to max) and remove only what was actually added from consumption
+		double returned = _max_tokens - _tokens;
+		if (returned > amount)
+			returned = amount;
+		if (returned > 0)
+		{
+			_tokens += returned;
+			_total_consumption -= returned;
+		}
+
+		_mtx.unlock();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	double BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Reserve(double amount, double max_wait)
+	{
+		// update tokens before reserving
+		if (UpdateT::Auto())
+			Update();
+
+		_mtx.lock();
+
+		// time until replenishing covers what's missing (never, if bucket doesn't replenish)
+		double missing = amount - _tokens;
+		double ret = 0;
+		if (missing > 0)
+			ret = _replenish_rate > 0 ? missing / _replenish_rate : -1;
+
+		// reserve, even if it takes tokens below zero
+		if (ret < 0 || ret > max_wait)
+			ret = -1;
+		else
+		{
+			_tokens -= amount;
+			_total_consumption += amount;
+		}
+
+		_mtx.unlock();
+		return ret;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	bool BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Consume(double amount)
+	{
+		return Consume(amount, true);
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	bool BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Consume(double amount, bool notify)
+	{
+		// only read the clock if we need it
+		return Consume(amount, UpdateT::Auto() ? ClockT::Now() : typename ClockT::TimePoint(), notify);
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	bool BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Consume(double amount, const typename ClockT::TimePoint& now, bool notify)
+	{
+		// update tokens before consuming
+		if (UpdateT::Auto())
+			Update(now);
+
+		// lock mutex
+		_mtx.lock();
+
+		// if got enough to consume reduce tokens and return true
+		if (_tokens >= amount)
+		{
+			// decrease tokens
+			_tokens -= amount;
+			_total_consumption += amount;
+
+			// unlock and return
+			_mtx.unlock();
+			return true;
+		}
+		// if don't have enough zero tokens and return false
+		else
+		{
+			// zero tokens and return false (but keep debt of reservations)
+			if (_tokens > 0)
+			{
+				_total_consumption += _tokens;
+				_tokens = 0;
+			}
+
+			// release the lock before calling the callback
+			_mtx.unlock();
+
+			// invoke callback
+			if (notify && OnBucketExhausted)
+			{
+				OnBucketExhausted(*this);
+			}
+
+			// return false
+			return false;
+		}
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	double BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Count()
+	{
+		// update tokens
+		if (UpdateT::Auto())
+			Update();
+
+		// return current balance
+		return _tokens;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	double BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Peek() const
+	{
+		_mtx.lock();
+
+		// add what was replenished since last update (up to max), without storing it
+		double ret = _tokens;
+		if (UpdateT::Auto())
+		{
+			double dt = ClockT::DiffSeconds(_last_update_time, ClockT::Now());
+			if (dt > 0)
+				ret += dt * _replenish_rate;
+			if (ret > _max_tokens)
+				ret = _max_tokens;
+		}
+
+		_mtx.unlock();
+		return ret;
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	void BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Reset()
+	{
+		_mtx.lock();
+		_tokens = _starting_count;
+		_mtx.unlock();
+	}
+
+	template <class ClockT, class ThreadingT, class UpdateT>
+	bool BasicTokenBucket<ClockT, ThreadingT, UpdateT>::Test(double amount) const
+	{
+		return _tokens >= amount;
+	}
+
+	// the default bucket is compiled once, in TokenBucket.cpp
+	extern template class BasicTokenBucket<AccurateClock>;
+}
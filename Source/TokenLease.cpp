@@ -0,0 +1,7 @@
+#include "TokenLease.h"
+
+namespace BucketAlerts
+{
+	// compile the default lease once
+	template class BasicTokenLease<AtomicTokenBucket>;
+}
@@ -0,0 +1,156 @@
+/*!
+ * \file	Source\TokenLease.h.
+ *
+ * \brief	Declares a thread-local lease of tokens from a shared bucket.
+ */
+#pragma once
+#include "AtomicTokenBucket.h"
+
+
+namespace BucketAlerts
+{
+	/*!
+	 * \class	BasicTokenLease
+	 *
+	 * \brief	Reserves tokens from a shared bucket in batches, and consumes them locally.
+	 * 			When a bucket is consumed from many threads at once, every consume bounces the bucket
+	 * 			cache line between cores. Instead, give each thread its own lease (for example a
+	 * 			thread_local or a local in the worker loop): it takes up to 'lease size' tokens from the
+	 * 			bucket at once and only touches the bucket again when they run out.
+	 * 			Unused tokens are returned to the bucket on Flush() or when the lease is destroyed.
+	 * 			When the bucket can't provide enough tokens, the lease returns its credit and consumes from
+	 * 			the bucket directly, so alerts fire just like without a lease.
+	 * 			Accuracy: every lease may hold up to 'lease size' tokens the bucket doesn't see, so the
+	 * 			bucket may alert up to (leases count * lease size) tokens earlier than it would otherwise.
+	 * 			Bucket type must provide Take() and Return() (TokenBucket and AtomicTokenBucket do).
+	 * 			A lease is not thread safe itself, it should only be used by one thread.
+	 *
+	 * \author	Ronen Ness
+	 * \date	10/16/2026
+	 */
+	template <class BucketT>
+	class BasicTokenLease
+	{
+	private:
+		// the shared bucket we lease from
+		BucketT& _bucket;
+
+		// how many tokens to reserve at once
+		double _lease_size;
+
+		// tokens we reserved and didn't use yet
+		double _credit = 0;
+
+	public:
+
+		/*!
+		 * \fn	BasicTokenLease::BasicTokenLease(BucketT& bucket, double lease_size = 8);
+		 *
+		 * \brief	Constructor.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	bucket	  	The shared bucket to lease tokens from (must outlive the lease).
+		 * \param	lease_size	How many tokens to reserve from the bucket at once.
+		 */
+		BasicTokenLease(BucketT& bucket, double lease_size = 8) : _bucket(bucket), _lease_size(lease_size)
+		{
+		}
+
+		/*!
+		 * \fn	BasicTokenLease::~BasicTokenLease();
+		 *
+		 * \brief	Destructor. Returns unused tokens to the bucket.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		~BasicTokenLease()
+		{
+			Flush();
+		}
+
+		// leases hold tokens, so they can't be copied
+		BasicTokenLease(const BasicTokenLease&) = delete;
+		BasicTokenLease& operator=(const BasicTokenLease&) = delete;
+
+		/*!
+		 * \fn	bool BasicTokenLease::Consume(double amount = 1.0);
+		 *
+		 * \brief	Consumes the given amount of tokens, from local credit if possible.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \param	amount	(Optional) The amount to consume.
+		 *
+		 * \return	True if it got enough tokens to consume, False if bucket was exhausted.
+		 */
+		bool Consume(double amount = 1.0);
+
+		/*!
+		 * \fn	void BasicTokenLease::Flush();
+		 *
+		 * \brief	Return unused tokens to the bucket.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 */
+		void Flush();
+
+		/*!
+		 * \fn	inline double BasicTokenLease::Credit() const
+		 *
+		 * \brief	Get how many reserved tokens this lease has left.
+		 *
+		 * \author	Ronen Ness
+		 * \date	10/16/2026
+		 *
+		 * \return	Reserved tokens count.
+		 */
+		inline double Credit() const { return _credit; }
+	};
+
+	/*!
+	 * \typedef	BasicTokenLease<AtomicTokenBucket> TokenLease
+	 *
+	 * \brief	A lease from the default lock-free bucket.
+	 */
+	typedef BasicTokenLease<AtomicTokenBucket> TokenLease;
+
+	template <class BucketT>
+	bool BasicTokenLease<BucketT>::Consume(double amount)
+	{
+		// got enough credit? consume locally
+		if (_credit >= amount)
+		{
+			_credit -= amount;
+			return true;
+		}
+
+		// reserve a new batch (or more, if amount is bigger than a batch)
+		double need = amount - _credit;
+		_credit += _bucket.Take(need > _lease_size ? need : _lease_size);
+		if (_credit >= amount)
+		{
+			_credit -= amount;
+			return true;
+		}
+
+		// bucket is exhausted: give back what we have and consume directly, so the bucket handles the alert
+		Flush();
+		return _bucket.Consume(amount);
+	}
+
+	template <class BucketT>
+	void BasicTokenLease<BucketT>::Flush()
+	{
+		if (_credit > 0)
+			_bucket.Return(_credit);
+		_credit = 0;
+	}
+
+	// the default lease is compiled once, in TokenLease.cpp
+	extern template class BasicTokenLease<AtomicTokenBucket>;
+}
@@ -0,0 +1,1242 @@
+#include "Source/AlertsManager.h"
+#include "Source/AtomicTokenBucket.h"
+#include "Source/LazyTokenBucket.h"
+#include "Source/GcraBucket.h"
+#include "Source/ColumnAlertsManager.h"
+#include "Source/SketchAlertsManager.h"
+#include "Source/MappedAlertsManager.h"
+#include "Source/ClusterSync.h"
+#include "Source/Acquire.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// count heap bytes and allocations, so we can compare memory used by the registries
+static std::atomic<long long> _allocated_bytes(0);
+static std::atomic<long long> _allocations(0);
+
+void* operator new(size_t size)
+{
+	_allocated_bytes += (long long)size;
+	_allocations++;
+	size_t* ptr = (size_t*)std::malloc(size + sizeof(size_t) * 2);
+	if (!ptr) throw std::bad_alloc();
+	ptr[0] = size;
+	return ptr + 2;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (!ptr) return;
+	size_t* real = (size_t*)ptr - 2;
+	_allocated_bytes -= (long long)real[0];
+	_allocations--;
+	std::free(real);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+// over-aligned types (like AtomicTokenBucket) use the aligned versions
+void* operator new(size_t size, std::align_val_t align)
+{
+	_allocated_bytes += (long long)size;
+	_allocations++;
+	size_t alignment = (size_t)align;
+	char* raw = (char*)std::malloc(size + alignment + sizeof(size_t) * 2);
+	if (!raw) throw std::bad_alloc();
+	uintptr_t ptr = ((uintptr_t)raw + sizeof(size_t) * 2 + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	size_t* header = (size_t*)(ptr - sizeof(size_t) * 2);
+	header[0] = size;
+	header[1] = (size_t)raw;
+	return (void*)ptr;
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	if (!ptr) return;
+	size_t* header = (size_t*)((uintptr_t)ptr - sizeof(size_t) * 2);
+	_allocated_bytes -= (long long)header[0];
+	_allocations--;
+	std::free((void*)header[1]);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept
+{
+	operator delete(ptr, align);
+}
+
+// the old nested registry, for comparison
+typedef std::unordered_map<BucketAlerts::CategoryId, std::unordered_map<BucketAlerts::BucketId, BucketAlerts::TokenBucket> > NestedRegistry;
+
+// how many categories to spread buckets between
+#define CATEGORIES_COUNT 16
+
+// how many consume calls to measure per test
+#define CONSUME_CALLS 2000000
+
+// how many times to update / reset the whole registry per test
+#define UPDATE_PASSES 10
+
+// version of the machine-readable output, bump when changing its fields
+#define RESULTS_SCHEMA_VERSION 1
+
+// output formats
+enum class Format { Table, Csv, Json };
+
+// command line options
+struct Options
+{
+	// output format
+	Format OutputFormat = Format::Table;
+
+	// only run benchmarks with this string in their name (empty = run all)
+	std::string Filter;
+
+	// how many times to run every benchmark (we report median and min)
+	int Repetitions = 3;
+
+	// max threads for contended benchmarks
+	unsigned int MaxThreads = 8;
+
+	// fewer calls and smaller registries, for quick checks
+	bool Quick = false;
+
+	// only run correctness checks, without benchmarks
+	bool ChecksOnly = false;
+};
+static Options _options;
+
+// a single benchmark result
+struct Result
+{
+	// benchmark name and its params, as "key=value" pairs separated by ','
+	std::string Name;
+	std::string Params;
+
+	// operations per repetition
+	size_t Ops;
+
+	// median and fastest nanoseconds per operation
+	double NsPerOp;
+	double MinNsPerOp;
+
+	// heap bytes and allocations per bucket (NAN if not measured)
+	double BytesPerBucket;
+	double AllocsPerBucket;
+};
+static std::vector<Result> _results;
+
+// how many consume calls to use
+static size_t consume_calls()
+{
+	return _options.Quick ? CONSUME_CALLS / 10 : CONSUME_CALLS;
+}
+
+// check if a benchmark should run
+static bool selected(const char* name)
+{
+	return _options.Filter.empty() || std::strstr(name, _options.Filter.c_str()) != nullptr;
+}
+
+// run a function and return average nanoseconds per call
+template <class Func>
+double measure(size_t calls, Func func)
+{
+	auto start = std::chrono::steady_clock::now();
+	func();
+	auto end = std::chrono::steady_clock::now();
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / calls;
+}
+
+// print a result as a table row
+static void print_row(const Result& result)
+{
+	std::cout << std::left << std::setw(26) << result.Name << std::setw(70) << result.Params
+		<< std::fixed << std::setprecision(1)
+		<< std::setw(12) << result.NsPerOp << std::setw(12) << result.MinNsPerOp;
+	if (!std::isnan(result.BytesPerBucket))
+		std::cout << std::setw(12) << result.BytesPerBucket << std::setprecision(3) << std::setw(12) << result.AllocsPerBucket;
+	std::cout << std::endl;
+}
+
+// run a benchmark 'repetitions' times and add its result
+template <class Func>
+void run(const char* name, const std::string& params, size_t ops, double bytes, double allocs, Func func)
+{
+	std::vector<double> samples;
+	for (int i = 0; i < _options.Repetitions; ++i)
+		samples.push_back(measure(ops, func));
+	std::sort(samples.begin(), samples.end());
+
+	Result result = { name, params, ops, samples[samples.size() / 2], samples[0], bytes, allocs };
+	_results.push_back(result);
+	if (_options.OutputFormat == Format::Table)
+		print_row(result);
+}
+
+// run a benchmark that doesn't measure memory
+template <class Func>
+void run(const char* name, const std::string& params, size_t ops, Func func)
+{
+	run(name, params, ops, NAN, NAN, func);
+}
+
+// get bucket engine name
+template <class BucketT> const char* engine_name();
+template <> const char* engine_name<BucketAlerts::TokenBucket>() { return "TokenBucket"; }
+template <> const char* engine_name<BucketAlerts::AtomicTokenBucket>() { return "AtomicTokenBucket"; }
+template <> const char* engine_name<BucketAlerts::LazyTokenBucket>() { return "LazyTokenBucket"; }
+template <> const char* engine_name<BucketAlerts::GcraBucket>() { return "GcraBucket"; }
+
+// build params string
+static std::string params(std::initializer_list<std::pair<const char*, std::string> > values)
+{
+	std::string ret;
+	for (auto& value : values)
+	{
+		if (!ret.empty()) ret += ",";
+		ret += std::string(value.first) + "=" + value.second;
+	}
+	return ret;
+}
+
+// get runtime flags as param values
+static std::string flag(bool value) { return value ? "1" : "0"; }
+
+// random bucket ids over a given registry size
+static std::vector<std::pair<BucketAlerts::CategoryId, BucketAlerts::BucketId> > random_ids(size_t size, size_t count)
+{
+	std::mt19937 rand(1234);
+	std::vector<std::pair<BucketAlerts::CategoryId, BucketAlerts::BucketId> > ids(count);
+	for (auto& id : ids)
+	{
+		size_t index = rand() % size;
+		id.first = (BucketAlerts::CategoryId)(index % CATEGORIES_COUNT);
+		id.second = (BucketAlerts::BucketId)(index / CATEGORIES_COUNT);
+	}
+	return ids;
+}
+
+// single thread consume from a bucket
+template <class BucketT>
+void bench_bucket_consume()
+{
+	if (!selected("bucket_consume"))
+		return;
+
+	size_t calls = consume_calls();
+	BucketT bucket(1e9, 1e9, 1e6);
+	run("bucket_consume", params({ { "engine", engine_name<BucketT>() }, { "thread_safe", flag(BucketAlerts::Defs::ThreadSafe) },
+		{ "auto_update", flag(BucketAlerts::Defs::AutoUpdate) } }), calls, (double)sizeof(BucketT), 0, [&]() {
+		for (size_t i = 0; i < calls; ++i)
+			bucket.Consume(1.0);
+	});
+}
+
+// consume random buckets from a manager with a given buckets count
+template <class BucketT>
+void bench_manager_consume(size_t size)
+{
+	if (!selected("manager_consume"))
+		return;
+
+	// build registry
+	long long before = _allocated_bytes;
+	long long before_allocs = _allocations;
+	BucketAlerts::BasicAlertsManager<BucketT>* manager = new BucketAlerts::BasicAlertsManager<BucketT>();
+	for (size_t i = 0; i < size; ++i)
+		manager->CreateBucket((BucketAlerts::CategoryId)(i % CATEGORIES_COUNT), (BucketAlerts::BucketId)(i / CATEGORIES_COUNT), 1e9, 1e9, 1e6, nullptr);
+	double bytes = (double)(_allocated_bytes - before) / size;
+	double allocs = (double)(_allocations - before_allocs) / size;
+
+	auto ids = random_ids(size, consume_calls());
+	run("manager_consume", params({ { "engine", engine_name<BucketT>() }, { "buckets", std::to_string(size) },
+		{ "thread_safe", flag(BucketAlerts::Defs::ThreadSafe) }, { "auto_update", flag(BucketAlerts::Defs::AutoUpdate) } }),
+		ids.size(), bytes, allocs, [&]() {
+		for (auto& id : ids)
+			manager->Consume(id.first, id.second, 1.0);
+	});
+
+	delete manager;
+}
+
+// consume random buckets from the old nested registry, for comparison
+// note: the nested registry never locks on lookup (that's the race the sharded registry fixes),
+// so it has no thread safe mode to compare with.
+void bench_nested_consume(size_t size)
+{
+	if (!selected("nested_consume"))
+		return;
+
+	long long before = _allocated_bytes;
+	long long before_allocs = _allocations;
+	NestedRegistry* nested = new NestedRegistry();
+	for (size_t i = 0; i < size; ++i)
+		(*nested)[(BucketAlerts::CategoryId)(i % CATEGORIES_COUNT)][(BucketAlerts::BucketId)(i / CATEGORIES_COUNT)] = BucketAlerts::TokenBucket(1e9, 1e9, 1e6);
+	double bytes = (double)(_allocated_bytes - before) / size;
+	double allocs = (double)(_allocations - before_allocs) / size;
+
+	auto ids = random_ids(size, consume_calls());
+	run("nested_consume", params({ { "buckets", std::to_string(size) }, { "auto_update", flag(BucketAlerts::Defs::AutoUpdate) } }),
+		ids.size(), bytes, allocs, [&]() {
+		for (auto& id : ids)
+			(*nested)[id.first][id.second].Consume(1.0);
+	});
+
+	delete nested;
+}
+
+// consume a single hot bucket from several threads at once
+template <class BucketT>
+void bench_contended_consume(unsigned int threads_count)
+{
+	if (!selected("contended_consume"))
+		return;
+
+	size_t calls = consume_calls() / threads_count * threads_count;
+	BucketT bucket(1e9, 1e9, 1e6);
+	run("contended_consume", params({ { "engine", engine_name<BucketT>() }, { "threads", std::to_string(threads_count) } }), calls, [&]() {
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < threads_count; ++t)
+		{
+			threads.emplace_back([&]() {
+				for (size_t i = 0; i < calls / threads_count; ++i)
+					bucket.Consume(1.0);
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+	});
+}
+
+// consume a single hot bucket via manager from several threads at once
+void bench_contended_manager_consume(unsigned int threads_count)
+{
+	if (!selected("contended_manager_consume"))
+		return;
+
+	size_t calls = consume_calls() / threads_count * threads_count;
+	BucketAlerts::AlertsManager manager;
+	manager.CreateBucket(0, 0, 1e9, 1e9, 1e6, nullptr);
+	run("contended_manager_consume", params({ { "engine", "TokenBucket" }, { "threads", std::to_string(threads_count) } }), calls, [&]() {
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < threads_count; ++t)
+		{
+			threads.emplace_back([&]() {
+				for (size_t i = 0; i < calls / threads_count; ++i)
+					manager.Consume(0, 0, 1.0);
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+	});
+}
+
+// update and reset a whole registry (reported per bucket)
+template <class ManagerT>
+void bench_update_and_reset(const char* engine, size_t size)
+{
+	if (!selected("manual_update") && !selected("reset_all"))
+		return;
+
+	ManagerT* manager = new ManagerT();
+	for (size_t i = 0; i < size; ++i)
+		manager->CreateBucket((BucketAlerts::CategoryId)(i % CATEGORIES_COUNT), (BucketAlerts::BucketId)(i / CATEGORIES_COUNT), 5, 10, 1, nullptr);
+
+	std::string bench_params = params({ { "engine", engine }, { "buckets", std::to_string(size) } });
+	if (selected("manual_update"))
+	{
+		run("manual_update", bench_params, size * UPDATE_PASSES, [&]() {
+			for (int i = 0; i < UPDATE_PASSES; ++i)
+				manager->ManualUpdate();
+		});
+	}
+	if (selected("reset_all"))
+	{
+		run("reset_all", bench_params, size * UPDATE_PASSES, [&]() {
+			for (int i = 0; i < UPDATE_PASSES; ++i)
+				manager->ResetAll();
+		});
+	}
+
+	delete manager;
+}
+
+// how many exhaustion callbacks were invoked
+static std::atomic<size_t> _callbacks(0);
+
+// exhaustion callback for benchmarks
+static void on_exhausted(const BucketAlerts::TokenBucket&)
+{
+	_callbacks.fetch_add(1, std::memory_order_relaxed);
+}
+
+// consume from exhausted buckets, so every call triggers an alert
+void bench_exhaustion(const char* mode)
+{
+	if (!selected("exhaustion"))
+		return;
+
+	// buckets that never replenish, so every consume exhausts them
+	const size_t size = 1000;
+	BucketAlerts::AlertsDispatcher* dispatcher = nullptr;
+	BucketAlerts::AlertsManager* manager = new BucketAlerts::AlertsManager();
+	for (size_t i = 0; i < size; ++i)
+		manager->CreateBucket((BucketAlerts::CategoryId)(i % CATEGORIES_COUNT), (BucketAlerts::BucketId)(i / CATEGORIES_COUNT), 0, 10, 0, on_exhausted);
+
+	// set alerts mode
+	if (std::strcmp(mode, "dispatcher") == 0)
+	{
+		dispatcher = new BucketAlerts::AlertsDispatcher();
+		manager->Dispatcher = dispatcher;
+	}
+	else if (std::strcmp(mode, "coalesced") == 0)
+	{
+		manager->CoalesceWindow = 1;
+	}
+
+	auto ids = random_ids(size, consume_calls());
+	run("exhaustion", params({ { "mode", mode }, { "buckets", std::to_string(size) } }), ids.size(), [&]() {
+		for (auto& id : ids)
+			manager->Consume(id.first, id.second, 1.0);
+	});
+
+	// dispatcher must outlive the manager
+	delete manager;
+	delete dispatcher;
+}
+
+// report a failed correctness check
+static bool check_failed(const char* name, const std::string& details)
+{
+	std::cerr << "check failed: " << name << " (" << details << ")" << std::endl;
+	return false;
+}
+
+// atomic bucket that was idle long enough for its 32 bit microseconds time to wrap must still refill
+static bool check_atomic_long_idle()
+{
+	typedef BucketAlerts::BasicAtomicTokenBucket<BucketAlerts::VirtualClock> Bucket;
+	for (double idle : { 100.0, 2200.0, 2500.0, 3000.0, 4200.0, 5000.0, 100000.0 })
+	{
+		Bucket bucket(0, 10, 1);
+		BucketAlerts::VirtualClock::Advance(idle);
+		if (!bucket.Consume(5))
+			return check_failed("atomic_long_idle", "consume failed after " + std::to_string(idle) + " seconds idle");
+		BucketAlerts::VirtualClock::Advance(10);
+		if (bucket.Count() < 10 - 1e-6)
+			return check_failed("atomic_long_idle", "didn't refill after " + std::to_string(idle) + " seconds idle");
+
+		// partial refill over a wrapped time
+		Bucket slow(0, 100000, 1);
+		BucketAlerts::VirtualClock::Advance(idle);
+		if (std::abs(slow.Count() - std::min(idle, 100000.0)) > 1e-3)
+			return check_failed("atomic_long_idle", "wrong partial refill after " + std::to_string(idle) + " seconds idle");
+	}
+	return true;
+}
+
+// returning more tokens than fit in the bucket must only remove the restored part from consumption
+template <class BucketT>
+static bool check_return_capped(const char* name)
+{
+	BucketT bucket(10, 10, 1);
+	bucket.Consume(4);
+	bucket.Restore(2);
+	bucket.Return(4);
+	if (std::abs(bucket.Count() - 10) > 1e-3)
+		return check_failed(name, "wrong tokens after return: " + std::to_string(bucket.Count()));
+	if (std::abs(bucket.TotalConsumed() - 2) > 1e-3)
+		return check_failed(name, "wrong total consumed after return: " + std::to_string(bucket.TotalConsumed()));
+	return true;
+}
+
+// gcra bucket must track consumption, honor manual updates and never replenish with rate 0
+static bool check_gcra_bucket()
+{
+	typedef BucketAlerts::BasicGcraBucket<BucketAlerts::VirtualClock, BucketAlerts::ManuallyUpdated> Bucket;
+	Bucket bucket(10, 10, 1);
+	bucket.Consume(4);
+	bucket.Take(2);
+	if (std::abs(bucket.TotalConsumed() - 6) > 1e-3)
+		return check_failed("gcra_bucket", "wrong total consumed: " + std::to_string(bucket.TotalConsumed()));
+	BucketAlerts::VirtualClock::Advance(3);
+	if (std::abs(bucket.Count() - 4) > 1e-3)
+		return check_failed("gcra_bucket", "replenished without update: " + std::to_string(bucket.Count()));
+	bucket.Update();
+	if (std::abs(bucket.Count() - 7) > 1e-3)
+		return check_failed("gcra_bucket", "didn't replenish on update: " + std::to_string(bucket.Count()));
+
+	Bucket fixed(5, 10, 0);
+	fixed.Consume(2);
+	BucketAlerts::VirtualClock::Advance(100);
+	fixed.Update();
+	if (std::abs(fixed.Count() - 3) > 1e-3 || fixed.Reserve(5, 1000) != -1)
+		return check_failed("gcra_bucket", "bucket with replenish rate 0 replenished: " + std::to_string(fixed.Count()));
+	return true;
+}
+
+// snapshot must export every bucket engine, including consumption
+template <class BucketT>
+static bool check_snapshot(const char* name)
+{
+	BucketAlerts::BasicAlertsManager<BucketT> manager;
+	manager.CreateBucket(1, (BucketAlerts::BucketId)1, 10, 10, 1, nullptr);
+	manager.Consume(1, (BucketAlerts::BucketId)1, 3);
+	BucketAlerts::BucketSnapshot snapshot[2];
+	if (manager.Snapshot(snapshot, 2) != 1)
+		return check_failed(name, "wrong buckets count");
+	if (std::abs(snapshot[0].TotalConsumed - 3) > 1e-3 || std::abs(snapshot[0].Tokens - 7) > 1e-2)
+		return check_failed(name, "wrong bucket state: " + std::to_string(snapshot[0].Tokens));
+	return true;
+}
+
+// buckets that are consumed all the time must never be evicted as idle
+static bool check_busy_not_evicted()
+{
+	BucketAlerts::BasicAlertsManager<BucketAlerts::BasicTokenBucket<BucketAlerts::VirtualClock>> manager;
+	manager.IdleTimeout = 10;
+	manager.SetCategoryTemplate(1, 10, 10, 100, nullptr);
+	auto handle = manager.Resolve(1, (BucketAlerts::BucketId)1);
+	for (int i = 0; i < 30; ++i)
+	{
+		BucketAlerts::VirtualClock::Advance(1);
+		manager.Consume(1, (BucketAlerts::BucketId)1);
+	}
+	BucketAlerts::VirtualClock::Advance(1);
+	manager.EvictIdle();
+	if (!handle.Valid())
+		return check_failed("busy_not_evicted", "evicted a bucket that was just consumed");
+
+	BucketAlerts::VirtualClock::Advance(11);
+	manager.EvictIdle();
+	if (handle.Valid())
+		return check_failed("busy_not_evicted", "didn't evict an idle bucket");
+	return true;
+}
+
+// creating a bucket that already exists must replace it with a new bucket, and invalidate handles to the old one
+static bool check_recreate_bucket()
+{
+	BucketAlerts::AlertsManager manager;
+	auto old_handle = manager.CreateBucket(1, (BucketAlerts::BucketId)1, 10, 10, 0, nullptr);
+	old_handle.Consume(4);
+	auto new_handle = manager.CreateBucket(1, (BucketAlerts::BucketId)1, 3, 5, 0, nullptr);
+	if (old_handle.Valid() || !new_handle.Valid())
+		return check_failed("recreate_bucket", "handles to replaced bucket are still valid");
+	if (manager.BucketsCount() != 1 || std::abs(manager.GetBucket(1, 1).Count() - 3) > 1e-3 || manager.GetBucket(1, 1).TotalConsumed() != 0)
+		return check_failed("recreate_bucket", "bucket not replaced: " + std::to_string(manager.GetBucket(1, 1).Count()));
+	return true;
+}
+
+// consumes rejected by a category or global limit must not count as consumed by the levels below it
+static bool check_limit_rollback()
+{
+	typedef BucketAlerts::BasicAlertsManager<BucketAlerts::BasicTokenBucket<BucketAlerts::VirtualClock>> Manager;
+	Manager manager;
+	manager.CreateBucket(1, (BucketAlerts::BucketId)1, 10, 10, 1, nullptr);
+	manager.SetCategoryLimit(1, 2, 2, 1, nullptr);
+	manager.Consume(1, (BucketAlerts::BucketId)1, 1);
+	manager.Consume(1, (BucketAlerts::BucketId)1, 1);
+	if (manager.Consume(1, (BucketAlerts::BucketId)1, 1) || std::abs(manager.GetBucket(1, 1).TotalConsumed() - 2) > 1e-3)
+		return check_failed("limit_rollback", "category limit rejection counted as consumed: " + std::to_string(manager.GetBucket(1, 1).TotalConsumed()));
+
+	Manager global;
+	global.CreateBucket(1, (BucketAlerts::BucketId)1, 10, 10, 1, nullptr);
+	global.SetCategoryLimit(1, 10, 10, 1, nullptr);
+	global.SetGlobalLimit(3, 3, 1, nullptr);
+	global.Consume(1, (BucketAlerts::BucketId)1, 3);
+	if (global.Consume(1, (BucketAlerts::BucketId)1, 1) || std::abs(global.GetBucket(1, 1).TotalConsumed() - 3) > 1e-3)
+		return check_failed("limit_rollback", "global limit rejection counted as consumed: " + std::to_string(global.GetBucket(1, 1).TotalConsumed()));
+	return true;
+}
+
+// dispatcher must invoke events in the order they were posted, and drop (or invoke inline) events when full
+static bool check_dispatcher()
+{
+	typedef BucketAlerts::AlertsDispatcher Dispatcher;
+	for (Dispatcher::OverflowPolicy policy : { Dispatcher::OverflowPolicy::Drop, Dispatcher::OverflowPolicy::InvokeInline })
+	{
+		// first event blocks the dispatcher thread (and holds its cell) until released, so the queue fills up
+		std::atomic<bool> released(false);
+		std::vector<BucketAlerts::BucketId> invoked;
+		std::vector<BucketAlerts::BucketId> inlined;
+		std::thread::id caller = std::this_thread::get_id();
+		bool pushed[5];
+		{
+			Dispatcher dispatcher(4, policy);
+			pushed[0] = dispatcher.Post([&released](BucketAlerts::CategoryId, BucketAlerts::BucketId, double) {
+				while (!released.load()) std::this_thread::yield();
+			}, 1, 0, 1);
+			BucketAlerts::AlertHandler record = [&invoked, &inlined, caller](BucketAlerts::CategoryId, BucketAlerts::BucketId bucket_id, double) {
+				(std::this_thread::get_id() == caller ? inlined : invoked).push_back(bucket_id);
+			};
+			for (BucketAlerts::BucketId i = 1; i < 5; ++i)
+				pushed[i] = dispatcher.Post(record, 1, i, 1);
+
+			// queue holds 4 events, so the last one overflows
+			bool drop = policy == Dispatcher::OverflowPolicy::Drop;
+			if (!pushed[0] || !pushed[1] || !pushed[2] || !pushed[3] || pushed[4] != !drop || dispatcher.Dropped() != (drop ? 1u : 0u))
+				return check_failed("dispatcher", "wrong overflow handling, dropped " + std::to_string(dispatcher.Dropped()));
+			if (inlined != (drop ? std::vector<BucketAlerts::BucketId>() : std::vector<BucketAlerts::BucketId> { 4 }))
+				return check_failed("dispatcher", "overflowing event not invoked inline");
+			released.store(true);
+		}
+
+		// destroying the dispatcher drains the queue
+		if (invoked != std::vector<BucketAlerts::BucketId> { 1, 2, 3 })
+			return check_failed("dispatcher", "events not invoked in order");
+	}
+	return true;
+}
+
+// alerts delivered to OnAlert by the coalescing check
+static std::vector<BucketAlerts::AlertInfo> _coalesced_alerts;
+
+// repeating alerts must be suppressed during their window, and counted in the next delivered alert (or summary)
+static bool check_coalescing()
+{
+	typedef BucketAlerts::BasicAlertsManager<BucketAlerts::BasicTokenBucket<BucketAlerts::VirtualClock>> Manager;
+	Manager::AlertCallback on_alert = [](const BucketAlerts::AlertInfo& info) { _coalesced_alerts.push_back(info); };
+
+	// bucket window (buckets are always empty, so every consume alerts)
+	_coalesced_alerts.clear();
+	Manager manager;
+	manager.CoalesceWindow = 10;
+	manager.OnAlert = on_alert;
+	manager.CreateBucket(1, (BucketAlerts::BucketId)1, 0, 1, 0, nullptr);
+	for (int i = 0; i < 3; ++i)
+		manager.Consume(1, (BucketAlerts::BucketId)1);
+	if (_coalesced_alerts.size() != 1 || _coalesced_alerts[0].Suppressed != 0)
+		return check_failed("coalescing", "alerts during window were not suppressed");
+	BucketAlerts::VirtualClock::Advance(11);
+	manager.Consume(1, (BucketAlerts::BucketId)1);
+	if (_coalesced_alerts.size() != 2 || _coalesced_alerts[1].Suppressed != 2)
+		return check_failed("coalescing", "alert after window didn't carry suppressed alerts");
+	manager.Consume(1, (BucketAlerts::BucketId)1);
+	manager.Flush();
+	if (_coalesced_alerts.size() != 3 || _coalesced_alerts[2].Suppressed != 1 || _coalesced_alerts[2].Bucket != 1)
+		return check_failed("coalescing", "flush didn't deliver bucket summary");
+
+	// category window (alerts of other buckets in category are suppressed too)
+	_coalesced_alerts.clear();
+	Manager category;
+	category.CategoryCoalesceWindow = 10;
+	category.OnAlert = on_alert;
+	category.CreateBucket(1, (BucketAlerts::BucketId)1, 0, 1, 0, nullptr);
+	category.CreateBucket(1, (BucketAlerts::BucketId)2, 0, 1, 0, nullptr);
+	category.Consume(1, (BucketAlerts::BucketId)1);
+	category.Consume(1, (BucketAlerts::BucketId)2);
+	category.Flush();
+	if (_coalesced_alerts.size() != 2 || _coalesced_alerts[0].Bucket != 1 || !_coalesced_alerts[1].CategoryLevel || _coalesced_alerts[1].Suppressed != 1)
+		return check_failed("coalescing", "category window didn't suppress other buckets alerts");
+	return true;
+}
+
+// levels of alerts delivered to OnAlert by the limits check
+static std::vector<BucketAlerts::AlertLevel> _limit_alerts;
+
+// category and global limits must reject consumes above them (alerting at their level) without charging the
+// bucket, leave other categories alone, and replenish like buckets (also when updated manually)
+template <class UpdateT>
+static bool check_limits(const char* name)
+{
+	typedef BucketAlerts::BasicAlertsManager<BucketAlerts::BasicTokenBucket<BucketAlerts::VirtualClock, BucketAlerts::RuntimeThreading, UpdateT>,
+		BucketAlerts::RuntimeThreading, BucketAlerts::ZeroOnExhaust> Manager;
+	bool auto_update = UpdateT::Auto();
+	_limit_alerts.clear();
+	Manager manager;
+	manager.OnAlert = [](const BucketAlerts::AlertInfo& info) { _limit_alerts.push_back(info.Level); };
+	manager.CreateBucket(1, (BucketAlerts::BucketId)1, 10, 10, 1, nullptr);
+	manager.CreateBucket(1, (BucketAlerts::BucketId)2, 10, 10, 1, nullptr);
+	manager.CreateBucket(2, (BucketAlerts::BucketId)1, 10, 10, 1, nullptr);
+	manager.SetCategoryLimit(1, 3, 3, 1, nullptr);
+
+	// category limit is shared by the category buckets
+	bool ok = manager.Consume(1, (BucketAlerts::BucketId)1, 2) && manager.Consume(1, (BucketAlerts::BucketId)2, 1);
+	if (!ok || manager.Consume(1, (BucketAlerts::BucketId)2, 1) || _limit_alerts != std::vector<BucketAlerts::AlertLevel> { BucketAlerts::AlertLevel::Category })
+		return check_failed(name, "category limit didn't reject consume above it");
+	if (std::abs(manager.GetBucket(1, 2).Count() - 9) > 1e-3)
+		return check_failed(name, "rejected consume charged the bucket: " + std::to_string(manager.GetBucket(1, 2).Count()));
+	if (!manager.Consume(2, (BucketAlerts::BucketId)1, 5))
+		return check_failed(name, "category limit rejected consume of another category");
+
+	// limit replenishes with time (or only when updated, if buckets are updated manually)
+	BucketAlerts::VirtualClock::Advance(1);
+	if (manager.Consume(1, (BucketAlerts::BucketId)1, 1) != auto_update)
+		return check_failed(name, auto_update ? "category limit didn't replenish" : "category limit replenished without update");
+	if (!auto_update)
+	{
+		manager.ManualUpdate();
+		if (!manager.Consume(1, (BucketAlerts::BucketId)1, 1))
+			return check_failed(name, "category limit didn't replenish on update");
+	}
+
+	// global limit covers all categories, and alerts at its own level
+	_limit_alerts.clear();
+	manager.SetGlobalLimit(2, 2, 0, nullptr);
+	ok = manager.Consume(2, (BucketAlerts::BucketId)1, 1) && manager.Consume(2, (BucketAlerts::BucketId)1, 1);
+	if (!ok || manager.Consume(2, (BucketAlerts::BucketId)1, 1) || _limit_alerts != std::vector<BucketAlerts::AlertLevel> { BucketAlerts::AlertLevel::Global })
+		return check_failed(name, "global limit didn't reject consume above it");
+	manager.RemoveGlobalLimit();
+	if (!manager.Consume(2, (BucketAlerts::BucketId)1, 1))
+		return check_failed(name, "removed global limit still rejects");
+	return true;
+}
+
+// batched consumes must match consuming one by one (creating missing buckets from templates), and callbacks
+// must see exhausted buckets before they are reset
+static bool check_consume_many()
+{
+	typedef BucketAlerts::BasicAlertsManager<BucketAlerts::BasicTokenBucket<BucketAlerts::VirtualClock>,
+		BucketAlerts::RuntimeThreading, BucketAlerts::ZeroOnExhaust> Manager;
+	Manager batched, single;
+	for (Manager* manager : { &batched, &single })
+	{
+		manager->SetCategoryTemplate(2, 3, 3, 0, nullptr);
+		for (BucketAlerts::BucketId i = 0; i < 50; ++i)
+			manager->CreateBucket(1, i, 5, 5, 0, nullptr);
+	}
+	std::vector<BucketAlerts::ConsumeRecord> records;
+	std::mt19937 random(7);
+	for (size_t i = 0; i < 1000; ++i)
+		records.push_back(BucketAlerts::ConsumeRecord { (BucketAlerts::CategoryId)(1 + random() % 2), (BucketAlerts::BucketId)(random() % 60), 1.0 });
+	bool results[1000];
+	batched.ConsumeMany(records.data(), records.size(), results);
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		if (single.Consume(records[i].Category, records[i].Bucket, records[i].Amount) != results[i])
+			return check_failed("consume_many", "batch result differs from single consume at record " + std::to_string(i));
+	}
+	if (batched.BucketsCount() != single.BucketsCount())
+		return check_failed("consume_many", "batch didn't create missing buckets from templates");
+
+	// reset policy: callback sees the bucket still empty, and it's reset after
+	BucketAlerts::BasicAlertsManager<BucketAlerts::BasicTokenBucket<BucketAlerts::VirtualClock>, BucketAlerts::RuntimeThreading, BucketAlerts::ResetOnExhaust> reset;
+	double seen = -1;
+	reset.CreateBucket(1, (BucketAlerts::BucketId)1, 5, 5, 0, [&reset, &seen](BucketAlerts::CategoryId cat_id, BucketAlerts::BucketId bucket_id, double) {
+		seen = reset.GetBucket(cat_id, bucket_id).Count();
+	});
+	BucketAlerts::ConsumeRecord exhaust[2] = { { 1, 1, 5 }, { 1, 1, 1 } };
+	bool exhaust_results[2];
+	reset.ConsumeMany(exhaust, 2, exhaust_results);
+	if (!exhaust_results[0] || exhaust_results[1] || std::abs(seen) > 1e-3 || std::abs(reset.GetBucket(1, 1).Count() - 5) > 1e-3)
+		return check_failed("consume_many", "callback saw bucket after reset: " + std::to_string(seen));
+	return true;
+}
+
+// mapped buckets must resume from their file, and records claimed by a process that died must be reused
+static bool check_mapped_resume()
+{
+	const char* path = "benchmark_check.map";
+	std::remove(path);
+	bool ok = true;
+	{
+		BucketAlerts::MappedAlertsManager manager;
+		if (!manager.Open(path, 64) || manager.Resumed())
+			return check_failed("mapped_resume", "failed to create buckets file");
+		manager.CreateBucket(1, (BucketAlerts::BucketId)1, 10, 10, 0.001);
+		manager.Consume(1, (BucketAlerts::BucketId)1, 4);
+		manager.Close();
+
+		// reopen: tokens are resumed, and declaring the bucket again keeps them
+		if (!manager.Open(path, 64) || !manager.Resumed())
+			ok = check_failed("mapped_resume", "didn't resume buckets file");
+		manager.CreateBucket(1, (BucketAlerts::BucketId)1, 10, 10, 0.001);
+		if (ok && std::abs(manager.Count(1, 1) - 6) > 0.1)
+			ok = check_failed("mapped_resume", "wrong tokens after resume: " + std::to_string(manager.Count(1, 1)));
+
+		// claim the record a new bucket would use, as a process that no longer exists
+		BucketAlerts::MappedFile file;
+		bool created;
+		if (ok && file.Open(path, 0, created))
+		{
+			BucketAlerts::MappedAlertsManager::FileHeader* header = (BucketAlerts::MappedAlertsManager::FileHeader*)file.Data();
+			BucketAlerts::MappedAlertsManager::Record* records = (BucketAlerts::MappedAlertsManager::Record*)(header + 1);
+			size_t mask = (size_t)header->Capacity - 1;
+			size_t index = (size_t)BucketAlerts::HashBucketKey(BucketAlerts::MakeBucketKey(5, 5)) & mask;
+			while (records[index].State.load() != 0)
+				index = (index + 1) & mask;
+			const uint64_t dead_process = 0x7ffffffe;
+			records[index].State.store((dead_process << 32) | (uint64_t)BucketAlerts::MappedAlertsManager::Status::Claimed);
+
+			// creating the bucket reuses that record, without counting it twice
+			if (!manager.CreateBucket(5, (BucketAlerts::BucketId)5, 3, 3, 1) || records[index].Key != BucketAlerts::MakeBucketKey(5, 5) ||
+				(records[index].State.load() & 0xffffffff) != (uint64_t)BucketAlerts::MappedAlertsManager::Status::Ready)
+				ok = check_failed("mapped_resume", "record of a dead process was not reused");
+			else if (manager.BucketsCount() != 2 || std::abs(manager.Count(5, 5) - 3) > 1e-3)
+				ok = check_failed("mapped_resume", "wrong state after reusing record, buckets " + std::to_string(manager.BucketsCount()));
+		}
+		else if (ok)
+		{
+			ok = check_failed("mapped_resume", "failed to map buckets file");
+		}
+	}
+	std::remove(path);
+	return ok;
+}
+
+// configs must survive text -> binary -> memory round-trips, and bad configs must be rejected and left empty
+static bool check_config()
+{
+	BucketAlerts::BucketsConfig config;
+	if (!config.ParseText("# comment\n1 2 3 4 5 on_exhausted\n\n  2 7 0 10 0.5  \n"))
+		return check_failed("config", "failed to parse text: " + config.Error);
+	if (config.Buckets.size() != 2 || config.CallbackNames != std::vector<std::string> { "on_exhausted" } ||
+		config.Buckets[0].Category != 1 || config.Buckets[0].Bucket != 2 || config.Buckets[0].StartingTokens != 3 ||
+		config.Buckets[0].MaxTokens != 4 || config.Buckets[0].ReplenishRate != 5 || config.Buckets[0].Callback != 0 ||
+		config.Buckets[1].ReplenishRate != 0.5 || config.Buckets[1].Callback != BucketAlerts::BucketsConfig::NoCallback)
+		return check_failed("config", "wrong definitions parsed from text");
+
+	// binary round-trip
+	std::vector<char> binary;
+	config.ToBinary(binary);
+	BucketAlerts::BucketsConfig loaded;
+	if (!loaded.ParseBinary(binary.data(), binary.size()) || loaded.CallbackNames != config.CallbackNames ||
+		loaded.Buckets.size() != config.Buckets.size() ||
+		std::memcmp(loaded.Buckets.data(), config.Buckets.data(), config.Buckets.size() * sizeof(BucketAlerts::BucketDefinition)) != 0)
+		return check_failed("config", "binary round-trip changed definitions: " + loaded.Error);
+
+	// create buckets from it (and nothing if a callback is missing)
+	BucketAlerts::AlertsManager manager;
+	BucketAlerts::CallbacksRegistry<BucketAlerts::AlertsManager::Callback> callbacks;
+	std::string missing;
+	if (manager.CreateBuckets(loaded, callbacks, &missing) || missing != "on_exhausted" || manager.BucketsCount() != 0)
+		return check_failed("config", "created buckets with a missing callback");
+	callbacks.Register("on_exhausted", on_exhausted);
+	if (!manager.CreateBuckets(loaded, callbacks) || manager.BucketsCount() != 2 || manager.GetBucket(1, 2).OnBucketExhausted != on_exhausted)
+		return check_failed("config", "failed to create buckets from config");
+
+	// bad configs (loading into a config that has definitions, to see they're not kept)
+	std::vector<std::pair<std::string, std::vector<char>>> bad_binaries;
+	bad_binaries.push_back({ "truncated", std::vector<char>(binary.begin(), binary.end() - 1) });
+	bad_binaries.push_back({ "checksum", binary });
+	bad_binaries.back().second.back() ^= 1;
+	bad_binaries.push_back({ "names count", binary });
+	uint32_t names_count = 0xFFFFFFFFu;
+	std::memcpy(&bad_binaries.back().second[20], &names_count, sizeof(names_count));
+	for (const auto& bad : bad_binaries)
+	{
+		BucketAlerts::BucketsConfig rejected = config;
+		if (rejected.ParseBinary(bad.second.data(), bad.second.size()) || !rejected.Buckets.empty() || rejected.Error.empty())
+			return check_failed("config", "accepted bad binary config (" + bad.first + ")");
+	}
+	BucketAlerts::BucketsConfig rejected = config;
+	if (rejected.ParseText("1 2 3 4 5\n1 2 3\n") || !rejected.Buckets.empty() || rejected.Error.empty())
+		return check_failed("config", "accepted bad text config");
+	return true;
+}
+
+// cluster nodes must take what their peers consumed, create buckets that only peers used, and not echo deltas back
+static bool check_cluster_sync()
+{
+	BucketAlerts::AlertsManager first, second;
+	for (BucketAlerts::AlertsManager* manager : { &first, &second })
+	{
+		manager->CreateBucket(1, (BucketAlerts::BucketId)1, 10, 10, 0, nullptr);
+		manager->SetCategoryTemplate(2, 10, 10, 0, nullptr);
+	}
+	BucketAlerts::LoopbackHub hub;
+	BucketAlerts::LoopbackTransport first_transport(hub), second_transport(hub);
+	BucketAlerts::ClusterSync first_sync(first, first_transport, 1, 0), second_sync(second, second_transport, 2, 0);
+
+	// both nodes consume, then exchange (second node gets first node deltas, and first node gets second node deltas)
+	first.Consume(1, (BucketAlerts::BucketId)1, 3);
+	first.Consume(2, (BucketAlerts::BucketId)5, 4);
+	second.Consume(1, (BucketAlerts::BucketId)1, 2);
+	first_sync.Exchange();
+	second_sync.Exchange();
+	first_sync.Exchange();
+	if (std::abs(first.GetBucket(1, 1).Count() - 5) > 1e-3 || std::abs(second.GetBucket(1, 1).Count() - 5) > 1e-3)
+		return check_failed("cluster_sync", "nodes didn't take peer consumption: " + std::to_string(first.GetBucket(1, 1).Count()) +
+			", " + std::to_string(second.GetBucket(1, 1).Count()));
+	if (std::abs(second.GetBucket(2, 5).Count() - 6) > 1e-3)
+		return check_failed("cluster_sync", "bucket used only by peer not synced");
+
+	// nothing new consumed: taken deltas must not be sent back
+	uint64_t sent = first_sync.DeltasSent() + second_sync.DeltasSent();
+	first_sync.Exchange();
+	second_sync.Exchange();
+	if (first_sync.DeltasSent() + second_sync.DeltasSent() != sent || std::abs(first.GetBucket(1, 1).Count() - 5) > 1e-3)
+		return check_failed("cluster_sync", "deltas taken from peers were sent back");
+	return true;
+}
+
+// timer callback of the acquire check: counts cancelled and due invocations
+static void on_check_timer(void* context, bool cancelled)
+{
+	((std::atomic<int>*)context)[cancelled ? 1 : 0]++;
+}
+
+#ifdef BUCKET_ALERTS_COROUTINES
+// coroutine that runs until its first suspension right away, and is never awaited (enough for the acquire check)
+struct CheckTask
+{
+	struct promise_type
+	{
+		CheckTask get_return_object() { return {}; }
+		std::suspend_never initial_suspend() { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+// acquire a token from a coroutine, and store the result (1 = acquired, 0 = failed)
+static CheckTask acquire_async(BucketAlerts::TimerScheduler& scheduler, BucketAlerts::TokenBucket& bucket, int& result)
+{
+	result = (co_await BucketAlerts::AcquireAsync(scheduler, bucket, 1.0)) ? 1 : 0;
+}
+#endif
+
+// acquire must wait for tokens until its deadline, and waiters must fail (and return their tokens) when the
+// scheduler is destroyed. waits are in real time, so this uses short waits and loose bounds.
+static bool check_acquire()
+{
+	typedef BucketAlerts::TimerScheduler::Clock Clock;
+	BucketAlerts::TokenBucket bucket(1, 1, 100);
+	if (!BucketAlerts::Acquire(bucket))
+		return check_failed("acquire", "failed to acquire available token");
+
+	// next token is 10ms away: a closer deadline fails right away without reserving, a later one waits for it
+	Clock::time_point start = Clock::now();
+	if (BucketAlerts::Acquire(bucket, 1.0, start + std::chrono::microseconds(100)))
+		return check_failed("acquire", "acquired before deadline that's too soon");
+	if (!BucketAlerts::Acquire(bucket, 1.0, start + std::chrono::seconds(10)))
+		return check_failed("acquire", "failed to acquire before deadline");
+	double waited = std::chrono::duration<double>(Clock::now() - start).count();
+	if (waited < 0.005 || waited > 5)
+		return check_failed("acquire", "wrong wait for token: " + std::to_string(waited));
+
+	// destroying scheduler invokes timers that are not due yet as cancelled
+	std::atomic<int> invoked[2] = { { 0 }, { 0 } };
+	{
+		BucketAlerts::TimerScheduler scheduler;
+		scheduler.Schedule(Clock::now(), &on_check_timer, invoked);
+		while (scheduler.Pending() > 0 || invoked[0].load() == 0)
+			std::this_thread::yield();
+		scheduler.Schedule(Clock::now() + std::chrono::hours(1), &on_check_timer, invoked);
+	}
+	if (invoked[0].load() != 1 || invoked[1].load() != 1)
+		return check_failed("acquire", "timers not invoked (or cancelled) as expected");
+
+#ifdef BUCKET_ALERTS_COROUTINES
+	// coroutine waiting on a scheduler that is destroyed resumes as failed, and its reserved token is returned
+	BucketAlerts::TokenBucket slow(0, 1, 0.001);
+	int result = -1;
+	{
+		BucketAlerts::TimerScheduler scheduler;
+		acquire_async(scheduler, slow, result);
+		if (result != -1)
+			return check_failed("acquire", "coroutine didn't wait for token");
+	}
+	if (result != 0 || slow.TotalConsumed() > 1e-6 || slow.Count() < -1e-3)
+		return check_failed("acquire", "cancelled coroutine acquired token, or didn't return it");
+#endif
+	return true;
+}
+
+// sketch manager must stay within its documented error bounds.
+// replenish rate is 0 so time doesn't affect results, and then the documented false alert bound of an id
+// with b tokens left, while other ids consumed L tokens in total, is (L / (width * b)) ^ depth.
+static bool check_sketch_accuracy()
+{
+	const size_t width = 2048, depth = 4, heavy_capacity = 16;
+	const int light_ids = 2000, light_consumes = 30, heavy_ids = 5, heavy_consumes = 300;
+	const double max_tokens = 100;
+	BucketAlerts::SketchAlertsManager sketch(width, depth, max_tokens, 0, heavy_capacity);
+
+	// heavy ids are 1..heavy_ids, light ids follow. consume round robin, and count alerts per id.
+	std::vector<uint64_t> alerts(heavy_ids + light_ids + 1, 0);
+	uint64_t total_alerts = 0;
+	int false_alerted = 0;
+	for (int round = 0; round < heavy_consumes; ++round)
+	{
+		for (int id = 1; id <= heavy_ids + (round < light_consumes ? light_ids : 0); ++id)
+		{
+			if (sketch.Consume(1, (BucketAlerts::BucketId)id))
+			{
+				// no missed alerts: exact bucket would be exhausted here
+				if (round >= max_tokens)
+					return check_failed("sketch_accuracy", "missed an alert of id " + std::to_string(id));
+				continue;
+			}
+			if (id > heavy_ids && alerts[id] == 0)
+				false_alerted++;
+			alerts[id]++;
+			total_alerts++;
+		}
+	}
+
+	// count is never above the exact count
+	for (int id = heavy_ids + 1; id <= heavy_ids + light_ids; ++id)
+	{
+		if (sketch.Count(1, (BucketAlerts::BucketId)id) > max_tokens - light_consumes + 1e-6)
+			return check_failed("sketch_accuracy", "count above exact count of id " + std::to_string(id));
+	}
+
+	// false alerts of light ids are within bound
+	double others = (double)heavy_ids * heavy_consumes + (double)light_ids * light_consumes;
+	double bound = std::pow(others / (width * (max_tokens - light_consumes)), (double)depth);
+	double rate = (double)false_alerted / light_ids;
+	if (rate > bound)
+		return check_failed("sketch_accuracy", "false alerts rate " + std::to_string(rate) + " above bound " + std::to_string(bound));
+
+	// heavy hitters: every id exhausted more than total / capacity times is listed, and counts are within their error
+	std::vector<BucketAlerts::HeavyHitter> heavy_hitters;
+	sketch.GetHeavyHitters(heavy_hitters);
+	for (int id = 1; id <= heavy_ids + light_ids; ++id)
+	{
+		if (alerts[id] <= total_alerts / heavy_capacity)
+			continue;
+		auto found = std::find_if(heavy_hitters.begin(), heavy_hitters.end(),
+			[id](const BucketAlerts::HeavyHitter& entry) { return entry.Bucket == (BucketAlerts::BucketId)id; });
+		if (found == heavy_hitters.end())
+			return check_failed("sketch_accuracy", "heavy hitter " + std::to_string(id) + " not reported");
+	}
+	for (const BucketAlerts::HeavyHitter& entry : heavy_hitters)
+	{
+		uint64_t exact = alerts[(size_t)entry.Bucket];
+		if (entry.Alerts < exact || entry.Alerts - entry.Error > exact)
+			return check_failed("sketch_accuracy", "heavy hitter " + std::to_string(entry.Bucket) + " count out of its error");
+	}
+	return true;
+}
+
+// run all correctness checks. return false if any failed.
+static bool run_checks()
+{
+	bool ok = true;
+	ok = check_atomic_long_idle() && ok;
+	ok = check_return_capped<BucketAlerts::BasicTokenBucket<BucketAlerts::VirtualClock>>("token_return_capped") && ok;
+	ok = check_return_capped<BucketAlerts::BasicAtomicTokenBucket<BucketAlerts::VirtualClock>>("atomic_return_capped") && ok;
+	ok = check_return_capped<BucketAlerts::BasicGcraBucket<BucketAlerts::VirtualClock>>("gcra_return_capped") && ok;
+	ok = check_gcra_bucket() && ok;
+	ok = check_snapshot<BucketAlerts::TokenBucket>("token_snapshot") && ok;
+	ok = check_snapshot<BucketAlerts::GcraBucket>("gcra_snapshot") && ok;
+	ok = check_busy_not_evicted() && ok;
+	ok = check_recreate_bucket() && ok;
+	ok = check_sketch_accuracy() && ok;
+	ok = check_limit_rollback() && ok;
+	ok = check_dispatcher() && ok;
+	ok = check_coalescing() && ok;
+	ok = check_limits<BucketAlerts::AutoUpdated>("limits") && ok;
+	ok = check_limits<BucketAlerts::ManuallyUpdated>("manual_limits") && ok;
+	ok = check_consume_many() && ok;
+	ok = check_mapped_resume() && ok;
+	ok = check_config() && ok;
+	ok = check_cluster_sync() && ok;
+	ok = check_acquire() && ok;
+	return ok;
+}
+
+// escape a string for json (we only have simple names, but just in case)
+static std::string json_string(const std::string& value)
+{
+	std::string ret = "\"";
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\') ret += '\\';
+		ret += c;
+	}
+	return ret + "\"";
+}
+
+// format a number for json / csv (empty if not measured)
+static std::string number(double value, const char* empty)
+{
+	if (std::isnan(value))
+		return empty;
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(3) << value;
+	return stream.str();
+}
+
+// print all results as csv
+static void print_csv()
+{
+	std::cout << "name,params,ops,ns_per_op,min_ns_per_op,bytes_per_bucket,allocs_per_bucket" << std::endl;
+	for (auto& result : _results)
+	{
+		std::cout << result.Name << ",\"" << result.Params << "\"," << result.Ops << ","
+			<< number(result.NsPerOp, "") << "," << number(result.MinNsPerOp, "") << ","
+			<< number(result.BytesPerBucket, "") << "," << number(result.AllocsPerBucket, "") << std::endl;
+	}
+}
+
+// print all results as json
+static void print_json()
+{
+	std::cout << "{" << std::endl;
+	std::cout << "  \"schema\": " << RESULTS_SCHEMA_VERSION << "," << std::endl;
+#if defined(__VERSION__)
+	std::cout << "  \"compiler\": " << json_string(__VERSION__) << "," << std::endl;
+#elif defined(_MSC_FULL_VER)
+	std::cout << "  \"compiler\": \"msvc " << _MSC_FULL_VER << "\"," << std::endl;
+#endif
+	std::cout << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << "," << std::endl;
+	std::cout << "  \"repetitions\": " << _options.Repetitions << "," << std::endl;
+	std::cout << "  \"quick\": " << (_options.Quick ? "true" : "false") << "," << std::endl;
+	std::cout << "  \"results\": [" << std::endl;
+	for (size_t i = 0; i < _results.size(); ++i)
+	{
+		const Result& result = _results[i];
+		std::cout << "    { \"name\": " << json_string(result.Name) << ", \"params\": {";
+		std::string param;
+		std::istringstream stream(result.Params);
+		bool first = true;
+		while (std::getline(stream, param, ','))
+		{
+			size_t eq = param.find('=');
+			std::cout << (first ? " " : ", ") << json_string(param.substr(0, eq)) << ": " << json_string(param.substr(eq + 1));
+			first = false;
+		}
+		std::cout << " }, \"ops\": " << result.Ops
+			<< ", \"ns_per_op\": " << number(result.NsPerOp, "null") << ", \"min_ns_per_op\": " << number(result.MinNsPerOp, "null")
+			<< ", \"bytes_per_bucket\": " << number(result.BytesPerBucket, "null") << ", \"allocs_per_bucket\": " << number(result.AllocsPerBucket, "null")
+			<< " }" << (i + 1 < _results.size() ? "," : "") << std::endl;
+	}
+	std::cout << "  ]" << std::endl << "}" << std::endl;
+}
+
+// print usage
+static void print_usage()
+{
+	std::cout << "usage: benchmark [--csv | --json] [--filter <name>] [--repetitions <n>] [--threads <n>] [--quick] [--check]" << std::endl
+		<< "  --csv, --json      machine-readable output (printed when all benchmarks are done)" << std::endl
+		<< "  --filter <name>    only run benchmarks with this string in their name" << std::endl
+		<< "  --repetitions <n>  run every benchmark n times and report median and min (default: 3)" << std::endl
+		<< "  --threads <n>      max threads for contended benchmarks (default: 8)" << std::endl
+		<< "  --quick            fewer calls and smaller registries" << std::endl
+		<< "  --check            only run correctness checks (they always run before benchmarks)" << std::endl;
+}
+
+// parse command line. return false if invalid.
+static bool parse_args(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg == "--csv") _options.OutputFormat = Format::Csv;
+		else if (arg == "--json") _options.OutputFormat = Format::Json;
+		else if (arg == "--quick") _options.Quick = true;
+		else if (arg == "--check") _options.ChecksOnly = true;
+		else if (arg == "--filter" && has_value) _options.Filter = argv[++i];
+		else if (arg == "--repetitions" && has_value) _options.Repetitions = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--threads" && has_value) _options.MaxThreads = (unsigned int)std::max(1, std::atoi(argv[++i]));
+		else return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (!parse_args(argc, argv))
+	{
+		print_usage();
+		return 1;
+	}
+
+	// benchmark numbers mean nothing if the buckets are wrong
+	if (!run_checks())
+		return 1;
+	if (_options.ChecksOnly)
+	{
+		std::cout << "all checks passed" << std::endl;
+		return 0;
+	}
+
+	if (_options.OutputFormat == Format::Table)
+	{
+		std::cout << std::left << std::setw(26) << "benchmark" << std::setw(70) << "params"
+			<< std::setw(12) << "ns/op" << std::setw(12) << "min ns/op"
+			<< std::setw(12) << "bytes/bkt" << std::setw(12) << "allocs/bkt" << std::endl;
+	}
+
+	// single thread bucket consume (with auto-update, as that's where engines differ)
+	BucketAlerts::Defs::AutoUpdate = true;
+	for (bool thread_safe : { false, true })
+	{
+		BucketAlerts::Defs::ThreadSafe = thread_safe;
+		bench_bucket_consume<BucketAlerts::TokenBucket>();
+	}
+	bench_bucket_consume<BucketAlerts::AtomicTokenBucket>();
+	bench_bucket_consume<BucketAlerts::LazyTokenBucket>();
+	bench_bucket_consume<BucketAlerts::GcraBucket>();
+
+	// registry lookup + consume over different sizes (without auto-update, so we measure the lookup)
+	std::vector<size_t> sizes = { 1, 1000, 100000 };
+	if (!_options.Quick)
+		sizes.push_back(1000000);
+	BucketAlerts::Defs::AutoUpdate = false;
+	for (bool thread_safe : { false, true })
+	{
+		BucketAlerts::Defs::ThreadSafe = thread_safe;
+		for (size_t size : sizes)
+			bench_manager_consume<BucketAlerts::TokenBucket>(size);
+	}
+	for (size_t size : sizes)
+		bench_nested_consume(size);
+
+	// bucket engines in a manager (with auto-update)
+	BucketAlerts::Defs::AutoUpdate = true;
+	BucketAlerts::Defs::ThreadSafe = true;
+	bench_manager_consume<BucketAlerts::TokenBucket>(100000);
+	bench_manager_consume<BucketAlerts::AtomicTokenBucket>(100000);
+	bench_manager_consume<BucketAlerts::GcraBucket>(100000);
+
+	// a single hot bucket consumed from several threads
+	std::vector<unsigned int> threads_counts;
+	for (unsigned int threads = 1; threads < _options.MaxThreads; threads *= 2)
+		threads_counts.push_back(threads);
+	threads_counts.push_back(_options.MaxThreads);
+	for (unsigned int threads : threads_counts)
+	{
+		bench_contended_consume<BucketAlerts::TokenBucket>(threads);
+		bench_contended_consume<BucketAlerts::AtomicTokenBucket>(threads);
+		bench_contended_consume<BucketAlerts::GcraBucket>(threads);
+		bench_contended_manager_consume(threads);
+	}
+
+	// updating and resetting large registries
+	BucketAlerts::Defs::AutoUpdate = false;
+	std::vector<size_t> update_sizes = { 100000 };
+	if (!_options.Quick)
+		update_sizes.push_back(1000000);
+	for (size_t size : update_sizes)
+	{
+		bench_update_and_reset<BucketAlerts::AlertsManager>("TokenBucket", size);
+		bench_update_and_reset<BucketAlerts::ColumnAlertsManager>("ColumnAlertsManager", size);
+	}
+
+	// callback-heavy exhaustion: every consume alerts
+	BucketAlerts::Defs::AutoUpdate = true;
+	bench_exhaustion("inline");
+	bench_exhaustion("coalesced");
+	bench_exhaustion("dispatcher");
+
+	if (_options.OutputFormat == Format::Csv)
+		print_csv();
+	else if (_options.OutputFormat == Format::Json)
+		print_json();
+
+	return 0;
+}